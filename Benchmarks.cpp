@@ -0,0 +1,1171 @@
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <locale>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "TBenchmark.h"
+#include "TBase64.h"
+#include "TConfigFile.h"
+#include "TDateTime.h"
+#include "THistogram.h"
+#include "TMultiFit.h"
+#include "TProfiler.h"
+#include "TQuantileSketch.h"
+#include "TStats.h"
+#include "TTokenizer.h"
+#include "TUnicode.h"
+#include "Friends.h"
+
+//---------------------------------------------------------------------------
+// Benchmarks of the hot paths of the library. Build it with all the sources and run it as
+// "Benchmarks [--large] [--filter=TEXT] [--json=FILE] [--csv=FILE]" (see TBenchmark::Main).
+// The benchmarks named *_Baseline run the implementations that the library replaced, on the
+// same data as the ones they're compared with. By default the data sets are small enough for
+// the whole suite to run in a few minutes; --large uses the sizes of the production workloads
+// (100M samples for Moda, 10M points for the polynomial fits, 1 GB of text for Split and a
+// 50 MB configuration file), which is best combined with --filter and --repetitions.
+//---------------------------------------------------------------------------
+
+static bool Large = false;  /*!< True to use the production sizes of the data sets (--large). */
+
+/*!
+ * \brief Normal random samples.
+ * \param Count Number of samples.
+ * \return Samples with mean 100 and standard deviation 15.
+ */
+static std::vector<double> NormalSamples(std::size_t Count)
+{
+	std::mt19937_64 generator(42);
+	std::normal_distribution<double> normal(100, 15);
+	std::vector<double> values(Count);
+	for(std::size_t i = 0; i < values.size(); i++) values[i] = normal(generator);
+	return values;
+}
+
+/*!
+ * \brief Random samples shared by the benchmarks (created at the first use).
+ * \return Reference to 100000 normal values.
+ */
+static const std::vector<double> &GetSamples()
+{
+	static const std::vector<double> samples = NormalSamples(100000);
+	return samples;
+}
+
+/*!
+ * \brief Series of the percentile and CDF comparisons (created at the first use).
+ * \return Reference to 1M normal values (10M with --large).
+ */
+static const std::vector<double> &GetSeries()
+{
+	static const std::vector<double> series = NormalSamples(Large ? 10000000 : 1000000);
+	return series;
+}
+
+/*!
+ * \brief Samples of the mode comparisons (created at the first use).
+ * \return Reference to 1M normal values (100M with --large).
+ */
+static const std::vector<double> &GetManySamples()
+{
+	static const std::vector<double> samples = NormalSamples(Large ? 100000000 : 1000000);
+	return samples;
+}
+
+/*!
+ * \brief Text shared by the benchmarks: CSV-like lines of words and numbers (created at the first use).
+ * \return Reference to about 1 MB of text.
+ */
+static const std::string &GetText()
+{
+	static const std::string text = []()
+	{
+		std::mt19937 generator(42);
+		std::string value;
+		char number[32];
+		while(value.size() < (1U << 20))
+		{
+			value += "  Lorem ipsum,Dolor Sit,AMET  ";
+			std::snprintf(number, sizeof(number), "%u", (unsigned int)generator());
+			value += number;
+			value += ",consectetur adipiscing\n";
+		}
+		return value;
+	}();
+	return text;
+}
+
+/*!
+ * \brief Text of the Split comparisons: copies of GetText() (created at the first use).
+ * \return Reference to 16 MB of text (1 GB with --large).
+ */
+static const std::string &GetLargeText()
+{
+	static const std::string text = []()
+	{
+		const std::string &block = GetText();
+		std::size_t size = Large ? (std::size_t(1) << 30) : (std::size_t(16) << 20);
+		std::string value;
+		value.reserve(size + block.size());
+		while(value.size() < size) value += block;
+		return value;
+	}();
+	return text;
+}
+
+/*!
+ * \brief Number of parameters of the benchmark configuration file.
+ * \return 20000 parameters (about 1.7M, or 50 MB, with --large).
+ */
+static unsigned int GetConfigParameters()
+{
+	return Large ? 1700000 : 20000;
+}
+
+/*!
+ * \brief Configuration file shared by the TConfigFile benchmarks (written at the first use in the temporary directory).
+ * \return Path of a file with GetConfigParameters() parameters in sections of 1000.
+ */
+static const std::string &GetConfigFile()
+{
+	static const std::string path = []()
+	{
+		std::string name = (std::filesystem::temp_directory_path() / "TBenchmark.cfg").string();
+		std::string text = "# benchmark file\n";
+		char line[128];
+		for(unsigned int i = 0; i < GetConfigParameters(); i++)
+		{
+			if(i % 1000 == 0)
+			{
+				std::snprintf(line, sizeof(line), "[Section%u]\n", i / 1000);
+				text += line;
+			}
+			std::snprintf(line, sizeof(line), "Parameter%u = %u.%03u\n", i, i * 7, i % 1000);
+			text += line;
+		}
+		std::fstream file;
+		file.open(name.c_str(), std::fstream::out | std::fstream::binary);
+		file << text;
+		file.close();
+		return name;
+	}();
+	return path;
+}
+
+//---------------------------------------------------------------------------
+// Baselines: the implementations replaced by the library, as they were, to measure the gains.
+
+/*!
+ * \brief Percentile by copying and sorting the samples (the Percentil replaced by introselect).
+ * \param Samples Samples.
+ * \param P Probability, from 0 to 1 (exclusive).
+ * \return Value of the percentile.
+ */
+static double BaselinePercentil(const std::vector<double> &Samples, double P)
+{
+	std::vector<double> sorted(Samples);
+	std::sort(sorted.begin(), sorted.end());
+	return sorted[(std::size_t)std::floor(P * sorted.size())];
+}
+
+/*!
+ * \brief Inverse CDF by sorting a copy of the samples once (the computation replaced by THistogram).
+ * \param Samples Samples.
+ * \param P Probabilities, from 0 to 1 (exclusive).
+ * \param Values Where the abscissas of the probabilities are returned.
+ */
+static void BaselineCdf(const std::vector<double> &Samples, const std::vector<double> &P, std::vector<double> &Values)
+{
+	std::vector<double> sorted(Samples);
+	std::sort(sorted.begin(), sorted.end());
+	Values.resize(P.size());
+	for(std::size_t i = 0; i < P.size(); i++) Values[i] = sorted[(std::size_t)std::floor(P[i] * sorted.size())];
+}
+
+/*!
+ * \brief Mode by sorting a copy of the samples: middle of the shortest interval with sqrt(n) samples.
+ * \param Samples Samples.
+ * \return Estimate of the mode.
+ */
+static double BaselineModa(const std::vector<double> &Samples)
+{
+	std::vector<double> sorted(Samples);
+	std::sort(sorted.begin(), sorted.end());
+	std::size_t k = std::max<std::size_t>(2, (std::size_t)std::sqrt((double)sorted.size())), best = 0;
+	for(std::size_t i = 1; i + k <= sorted.size(); i++)
+	{
+		if(sorted[i + k - 1] - sorted[i] < sorted[best + k - 1] - sorted[best]) best = i;
+	}
+	return (sorted[best] + sorted[best + k - 1]) / 2;
+}
+
+/*!
+ * \brief Polynomial fit with the power sums of std::pow and Gauss elimination without pivoting (the AjustePolinomioMMQ replaced).
+ * \param Xi Values of the independent variable.
+ * \param Yi Values of the dependent variable.
+ * \param Coefficients Where the Order + 1 coefficients are returned.
+ * \param Order Order of the polynomial.
+ * \return False if the sizes don't match.
+ *
+ * The original leaked the matrix, which is freed here so long runs don't grow.
+ */
+static bool BaselineAjustePolinomioMMQ(const std::vector<double> &Xi, const std::vector<double> &Yi, double *Coefficients, int Order)
+{
+	if(Xi.size() != Yi.size()) return false;
+	int n = (int)Xi.size(), m = std::min(Order, n - 1);
+	std::vector<std::vector<double> > matrix(m + 2, std::vector<double>(m + 3, 0.0));
+	for(int k = 0; k <= m; k++)
+	{
+		double b = 0;
+		for(int i = 0; i < n; i++) b += (k == 0) ? Yi[i] : Yi[i] * std::pow(Xi[i], (double)k);
+		for(int j = 0; j <= m; j++)
+		{
+			double a = 0;
+			for(int i = 0; i < n; i++) a += ((k + j) == 0) ? 1.0 : std::pow(Xi[i], (k + j));
+			matrix[k][j] = a;
+		}
+		matrix[k][m + 1] = b;
+	}
+	for(int i = 0; i < m; i++)
+	{
+		for(int j = i + 1; j <= m; j++)
+		{
+			double factor = matrix[j][i] / matrix[i][i];
+			for(int k = i; k <= m + 1; k++) matrix[j][k] -= matrix[i][k] * factor;
+		}
+	}
+	Coefficients[m] = matrix[m][m + 1] / matrix[m][m];
+	for(int i = m - 1; i >= 0; i--)
+	{
+		double sum = 0;
+		for(int j = i + 1; j <= m; j++) sum += matrix[i][j] * Coefficients[j];
+		Coefficients[i] = (matrix[i][m + 1] - sum) / matrix[i][i];
+	}
+	return true;
+}
+
+/*!
+ * \brief Upper case conversion by toupper on a copy (the UCase replaced).
+ * \param Text Text to be converted.
+ * \return Converted copy of the text.
+ */
+static std::string BaselineUCase(const char *Text)
+{
+	std::string text = Text;
+	for(unsigned int i = 0; i < text.size(); i++) text[i] = toupper(text[i]);
+	return text;
+}
+
+/*!
+ * \brief Space removal by repeated find and erase (the RemoverEspacos replaced, quadratic).
+ * \param Text Text whose spaces are removed.
+ * \return Copy of the text without spaces.
+ */
+static std::string BaselineRemoverEspacos(const char *Text)
+{
+	std::string text = Text;
+	std::size_t found = text.find(' ');
+	while(found != std::string::npos)
+	{
+		text.erase(found, 1);
+		found = text.find(' ');
+	}
+	return text;
+}
+
+/*!
+ * \brief Split through a std::stringstream into new strings (the Split replaced by TTokenizer).
+ * \param Text Text to be split.
+ * \param Delimiter Delimiter of the fields.
+ * \param Fields Where the fields are returned.
+ * \return Reference to the fields.
+ */
+static std::vector<std::string> &BaselineSplit(const std::string &Text, char Delimiter, std::vector<std::string> &Fields)
+{
+	Fields.clear();
+	std::stringstream stream(Text);
+	std::string item;
+	while(std::getline(stream, item, Delimiter)) Fields.push_back(item);
+	return Fields;
+}
+
+/*!
+ * \brief Narrow a wide string through a std::ostringstream and its ctype facet (the Narrow replaced).
+ * \param Text Wide text.
+ * \return Narrow text (characters that don't fit are '\0').
+ */
+static std::string BaselineNarrow(const std::wstring &Text)
+{
+	std::ostringstream stream;
+	const std::ctype<char> &facet = std::use_facet<std::ctype<char> >(stream.getloc());
+	for(std::size_t i = 0; i < Text.size(); i++) stream << facet.narrow(Text[i], 0);
+	return stream.str();
+}
+
+static const std::string BaselineBase64Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";  /*!< Alphabet of the Base64 baselines. */
+
+/*!
+ * \brief Base64 encoding appending one character at a time (the Base64_Encode replaced by TBase64).
+ * \param Bytes Bytes to be encoded.
+ * \param Len Number of bytes.
+ * \return Encoded text.
+ */
+static std::string BaselineBase64_Encode(const char *Bytes, unsigned int Len)
+{
+	std::string output;
+	int i = 0;
+	unsigned char group3[3], group4[4];
+	while(Len--)
+	{
+		group3[i++] = *(Bytes++);
+		if(i == 3)
+		{
+			group4[0] = (group3[0] & 0xfc) >> 2;
+			group4[1] = ((group3[0] & 0x03) << 4) + ((group3[1] & 0xf0) >> 4);
+			group4[2] = ((group3[1] & 0x0f) << 2) + ((group3[2] & 0xc0) >> 6);
+			group4[3] = group3[2] & 0x3f;
+			for(i = 0; i < 4; i++) output += BaselineBase64Chars[group4[i]];
+			i = 0;
+		}
+	}
+	if(i)
+	{
+		for(int j = i; j < 3; j++) group3[j] = '\0';
+		group4[0] = (group3[0] & 0xfc) >> 2;
+		group4[1] = ((group3[0] & 0x03) << 4) + ((group3[1] & 0xf0) >> 4);
+		group4[2] = ((group3[1] & 0x0f) << 2) + ((group3[2] & 0xc0) >> 6);
+		for(int j = 0; j < i + 1; j++) output += BaselineBase64Chars[group4[j]];
+		while(i++ < 3) output += '=';
+	}
+	return output;
+}
+
+/*!
+ * \brief Base64 decoding with a linear search of each character in the alphabet (the Base64_Decode replaced by TBase64).
+ * \param Text Encoded text.
+ * \return Decoded bytes.
+ */
+static std::string BaselineBase64_Decode(const std::string &Text)
+{
+	std::size_t len = Text.size(), in = 0;
+	int i = 0;
+	unsigned char group4[4];
+	std::string output;
+	while(len-- && Text[in] != '=' && (isalnum((unsigned char)Text[in]) || Text[in] == '+' || Text[in] == '/'))
+	{
+		group4[i++] = (unsigned char)Text[in++];
+		if(i == 4)
+		{
+			for(i = 0; i < 4; i++) group4[i] = (unsigned char)BaselineBase64Chars.find((char)group4[i]);
+			output += (char)((group4[0] << 2) + ((group4[1] & 0x30) >> 4));
+			output += (char)(((group4[1] & 0xf) << 4) + ((group4[2] & 0x3c) >> 2));
+			output += (char)(((group4[2] & 0x3) << 6) + group4[3]);
+			i = 0;
+		}
+	}
+	if(i)
+	{
+		for(int j = 0; j < i; j++) group4[j] = (unsigned char)BaselineBase64Chars.find((char)group4[j]);
+		for(int j = i; j < 4; j++) group4[j] = 0;
+		if(i > 1) output += (char)((group4[0] << 2) + ((group4[1] & 0x30) >> 4));
+		if(i > 2) output += (char)(((group4[1] & 0xf) << 4) + ((group4[2] & 0x3c) >> 2));
+	}
+	return output;
+}
+
+/*!
+ * \brief Remove spaces, tabs and line breaks from both ends of a copy of a text (the Trim of the TConfigFile replaced).
+ * \param Text Text to be trimmed.
+ * \return Trimmed copy.
+ */
+static std::string BaselineTrim(const char *Text)
+{
+	std::string text = Text;
+	const char *delimiters = " \t\r\n";
+	text.erase(0, text.find_first_not_of(delimiters));
+	text.erase(text.find_last_not_of(delimiters) + 1);
+	return text;
+}
+
+/*!
+ * \brief Read a configuration file line by line into a multimap (the TConfigFile::ReadFile replaced).
+ * \param FileName Name of the file.
+ * \param Parameters Where the parameters and their values are returned.
+ * \return False if the file couldn't be opened.
+ */
+static bool BaselineReadFile(const char *FileName, std::multimap<std::string,std::string> &Parameters)
+{
+	std::fstream file;
+	file.open(FileName, std::fstream::in);
+	if(!file.is_open()) return false;
+	Parameters.clear();
+	while(!file.eof())
+	{
+		std::string line;
+		getline(file, line);
+		line = BaselineTrim(line.c_str());
+		if(line.empty() || line.substr(0, 1) == "#") continue;
+		std::string::size_type pos = line.find("=");
+		if(pos == std::string::npos) continue;
+		Parameters.insert(std::pair<std::string,std::string>(BaselineTrim(line.substr(0, pos).c_str()), BaselineTrim(line.substr(pos + 1).c_str())));
+	}
+	file.close();
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// Friends: statistics
+
+TBENCHMARK(Friends_Percentil)
+{
+	const std::vector<double> &samples = GetSamples();
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(Percentil(samples, 0.9));
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Friends_Percentis)
+{
+	const std::vector<double> &samples = GetSamples();
+	std::vector<double> p = {0.05, 0.25, 0.5, 0.75, 0.95}, values;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		Percentis(samples, p, values);
+		TBenchmark::DoNotOptimize(values.data());
+	}
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Friends_Histograma)
+{
+	const std::vector<double> &samples = GetSamples();
+	std::vector<double> frequencies;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		Histograma(samples, frequencies);
+		TBenchmark::DoNotOptimize(frequencies.data());
+	}
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Friends_AbcissaFreqAcumulada)
+{
+	const std::vector<double> &samples = GetSamples();
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(AbcissaFreqAcumulada(samples, 0.9));
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Friends_Moda)
+{
+	const std::vector<double> &samples = GetSamples();
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(Moda(samples));
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Friends_ModaDiscreta)
+{
+	const std::vector<double> &samples = GetSamples();
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(ModaDiscreta(samples, 0.5));
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Friends_AjustePolinomioMMQ)
+{
+	const std::vector<double> &samples = GetSamples();
+	std::vector<double> x(1000), y(samples.begin(), samples.begin() + 1000);
+	for(std::size_t i = 0; i < x.size(); i++) x[i] = (double)i / 100;
+	double coefficients[4];
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		AjustePolinomioMMQ(x, y, coefficients, 3);
+		TBenchmark::DoNotOptimize(coefficients);
+	}
+	State.Items = (double)x.size();
+}
+
+TBENCHMARK(Friends_ArredondaValores)
+{
+	const std::vector<double> &samples = GetSamples();
+	std::vector<double> values;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		values = samples;
+		ArredondaValores(values, 3);
+		TBenchmark::DoNotOptimize(values.data());
+	}
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(TStats_Add)
+{
+	const std::vector<double> &samples = GetSamples();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		TStats stats;
+		stats.Add(samples);
+		TBenchmark::DoNotOptimize(stats);
+	}
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(TQuantileSketch_Add)
+{
+	const std::vector<double> &samples = GetSamples();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		TQuantileSketch sketch;
+		sketch.Add(samples);
+		TBenchmark::DoNotOptimize(sketch.Quantile(0.9));
+	}
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(THistogram_Add)
+{
+	const std::vector<double> &samples = GetSamples();
+	THistogram histogram;
+	histogram.SetLinear(0, 200, 100);
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		histogram.Add(samples);
+		TBenchmark::ClobberMemory();
+	}
+	State.Items = (double)samples.size();
+}
+
+//---------------------------------------------------------------------------
+// Statistics against their baselines (run a group with --filter=Quantiles_, Cdf_, Moda_ or AjustePolinomioMMQ_)
+
+/*!
+ * \brief Probabilities of the percentile and CDF comparisons (the ones of the dashboards).
+ * \return Reference to p50, p90, p99 and p99.9.
+ */
+static const std::vector<double> &GetDashboardP()
+{
+	static const std::vector<double> p = {0.5, 0.9, 0.99, 0.999};
+	return p;
+}
+
+TBENCHMARK(Quantiles_Percentis)
+{
+	const std::vector<double> &series = GetSeries();
+	std::vector<double> values;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		Percentis(series, GetDashboardP(), values);
+		TBenchmark::DoNotOptimize(values.data());
+	}
+	State.Items = (double)series.size();
+}
+
+TBENCHMARK(Quantiles_TQuantileSketch)
+{
+	const std::vector<double> &series = GetSeries();
+	std::vector<double> values;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		TQuantileSketch sketch;
+		sketch.Add(series);
+		sketch.Quantiles(GetDashboardP(), values);
+		TBenchmark::DoNotOptimize(values.data());
+	}
+	State.Items = (double)series.size();
+}
+
+TBENCHMARK(Quantiles_Percentil_Baseline)
+{
+	const std::vector<double> &series = GetSeries();
+	const std::vector<double> &p = GetDashboardP();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		for(std::size_t k = 0; k < p.size(); k++) TBenchmark::DoNotOptimize(BaselinePercentil(series, p[k]));
+	}
+	State.Items = (double)series.size();
+}
+
+TBENCHMARK(Cdf_THistogram)
+{
+	const std::vector<double> &series = GetSeries();
+	const std::vector<double> &p = GetDashboardP();
+	THistogram histogram;
+	histogram.SetLinear(0, 200, 4096);
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		histogram.Clear();
+		histogram.Add(series);
+		for(std::size_t k = 0; k < p.size(); k++) TBenchmark::DoNotOptimize(histogram.InverseCumulative(p[k]));
+	}
+	State.Items = (double)series.size();
+}
+
+TBENCHMARK(Cdf_AbcissaFreqAcumulada)
+{
+	const std::vector<double> &series = GetSeries();
+	const std::vector<double> &p = GetDashboardP();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		for(std::size_t k = 0; k < p.size(); k++) TBenchmark::DoNotOptimize(AbcissaFreqAcumulada(series, p[k]));
+	}
+	State.Items = (double)series.size();
+}
+
+TBENCHMARK(Cdf_Sort_Baseline)
+{
+	const std::vector<double> &series = GetSeries();
+	std::vector<double> values;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		BaselineCdf(series, GetDashboardP(), values);
+		TBenchmark::DoNotOptimize(values.data());
+	}
+	State.Items = (double)series.size();
+}
+
+TBENCHMARK(Moda_Kde)
+{
+	const std::vector<double> &samples = GetManySamples();
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(Moda(samples));
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Moda_Discreta)
+{
+	const std::vector<double> &samples = GetManySamples();
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(ModaDiscreta(samples, 0.5));
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Moda_Sort_Baseline)
+{
+	const std::vector<double> &samples = GetManySamples();
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(BaselineModa(samples));
+	State.Items = (double)samples.size();
+}
+
+/*!
+ * \brief Points of the polynomial fit comparisons: a noisy curve over [-1, 1] (created at the first use).
+ * \param X Where the reference to the abscissas is returned.
+ * \param Y Where the reference to the ordinates is returned.
+ *
+ * There are 100000 points (10M with --large).
+ */
+static void GetPolynomialPoints(const std::vector<double> *&X, const std::vector<double> *&Y)
+{
+	static std::vector<double> x, y;
+	if(y.empty())
+	{
+		std::mt19937_64 generator(42);
+		std::normal_distribution<double> normal(0, 0.1);
+		x.resize(Large ? 10000000 : 100000);
+		y.resize(x.size());
+		for(std::size_t i = 0; i < x.size(); i++)
+		{
+			x[i] = 2.0 * i / (x.size() - 1) - 1;
+			y[i] = std::sin(3 * x[i]) + normal(generator);
+		}
+	}
+	X = &x;
+	Y = &y;
+}
+
+/*!
+ * \brief Fit a polynomial of a given order to the comparison points.
+ * \param State State of the benchmark.
+ */
+template <int Order> static void AjustePolinomio(TBenchmark::TState &State)
+{
+	const std::vector<double> *x, *y;
+	GetPolynomialPoints(x, y);
+	double coefficients[Order + 1];
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		AjustePolinomioMMQ(*x, *y, coefficients, Order);
+		TBenchmark::DoNotOptimize(coefficients);
+	}
+	State.Items = (double)x->size();
+}
+
+/*!
+ * \brief Fit a polynomial of a given order to the comparison points with the baseline.
+ * \param State State of the benchmark.
+ */
+template <int Order> static void AjustePolinomioBaseline(TBenchmark::TState &State)
+{
+	const std::vector<double> *x, *y;
+	GetPolynomialPoints(x, y);
+	double coefficients[Order + 1];
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		BaselineAjustePolinomioMMQ(*x, *y, coefficients, Order);
+		TBenchmark::DoNotOptimize(coefficients);
+	}
+	State.Items = (double)x->size();
+}
+
+/*!
+ * \brief Register the polynomial fit and its baseline for an order.
+ */
+#define POLYNOMIAL_BENCHMARKS(Order) \
+	static TBenchmark::TRegistration AjustePolinomio##Order##Registration("AjustePolinomioMMQ_" #Order, AjustePolinomio<Order>); \
+	static TBenchmark::TRegistration AjustePolinomioBaseline##Order##Registration("AjustePolinomioMMQ_" #Order "_Baseline", AjustePolinomioBaseline<Order>)
+
+POLYNOMIAL_BENCHMARKS(1);
+POLYNOMIAL_BENCHMARKS(2);
+POLYNOMIAL_BENCHMARKS(3);
+POLYNOMIAL_BENCHMARKS(4);
+POLYNOMIAL_BENCHMARKS(5);
+POLYNOMIAL_BENCHMARKS(6);
+POLYNOMIAL_BENCHMARKS(7);
+POLYNOMIAL_BENCHMARKS(8);
+POLYNOMIAL_BENCHMARKS(9);
+POLYNOMIAL_BENCHMARKS(10);
+
+//---------------------------------------------------------------------------
+// Friends: strings
+
+TBENCHMARK(Friends_UCase)
+{
+	const std::string &text = GetText();
+	std::string output(text.size(), '\0');
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		UCase(text, &output[0]);
+		TBenchmark::ClobberMemory();
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_UCase_Baseline)
+{
+	const std::string &text = GetText();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = BaselineUCase(text.c_str());
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_Trim)
+{
+	std::string text;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		text = "   \t some words with spaces around them \r\n ";
+		Trim(text);
+		TBenchmark::DoNotOptimize(text.data());
+	}
+}
+
+TBENCHMARK(Friends_RemoverEspacos)
+{
+	const std::string &text = GetText();
+	std::string output(text.size(), '\0');
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(RemoverEspacos(text, &output[0]));
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_RemoverEspacos_Baseline)
+{
+	// the baseline is quadratic, so it runs on the first 64 KB only (compare the throughput)
+	static const std::string text = GetText().substr(0, 65536);
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = BaselineRemoverEspacos(text.c_str());
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_Replace)
+{
+	const std::string &text = GetText();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = Replace(std::string_view(text), "Dolor", "Color");
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_Split)
+{
+	const std::string &text = GetText();
+	std::vector<std::string_view> fields;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		Split(std::string_view(text), ',', fields);
+		TBenchmark::DoNotOptimize(fields.data());
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(TTokenizer_Split)
+{
+	const std::string &text = GetText();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		TTokenizer tokenizer(text, '\n');
+		std::vector<std::string_view> lines;
+		TBenchmark::DoNotOptimize(tokenizer.Split(lines));
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Split_Friends)
+{
+	const std::string &text = GetLargeText();
+	std::vector<std::string_view> fields;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string_view rest(text);
+		for(std::size_t end = rest.find('\n'); end != std::string_view::npos; end = rest.find('\n'))
+		{
+			Split(rest.substr(0, end), ',', fields);
+			TBenchmark::DoNotOptimize(fields.data());
+			rest.remove_prefix(end + 1);
+		}
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Split_TTokenizer)
+{
+	const std::string &text = GetLargeText();
+	std::string_view field;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		TTokenizer tokenizer(text, ",\n");
+		while(tokenizer.Next(field)) TBenchmark::DoNotOptimize(field.data());
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Split_Stringstream_Baseline)
+{
+	const std::string &text = GetLargeText();
+	std::vector<std::string> fields;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string_view rest(text);
+		for(std::size_t end = rest.find('\n'); end != std::string_view::npos; end = rest.find('\n'))
+		{
+			BaselineSplit(std::string(rest.substr(0, end)), ',', fields);
+			TBenchmark::DoNotOptimize(fields.data());
+			rest.remove_prefix(end + 1);
+		}
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_NumerosCEPEL)
+{
+	const std::vector<double> &samples = GetSamples();
+	std::string output;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		NumerosCEPEL(samples, 10, output, 4);
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Items = (double)samples.size();
+}
+
+TBENCHMARK(Friends_Base64_Encode)
+{
+	const std::string &text = GetText();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = Base64_Encode(text.data(), (unsigned int)text.size());
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_Base64_Decode)
+{
+	const std::string &text = GetText();
+	static const std::string encoded = Base64_Encode(text.data(), (unsigned int)text.size());
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = Base64_Decode(encoded);
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Bytes = (double)encoded.size();
+}
+
+TBENCHMARK(Friends_Base64_Encode_Baseline)
+{
+	const std::string &text = GetText();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = BaselineBase64_Encode(text.data(), (unsigned int)text.size());
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_Base64_Decode_Baseline)
+{
+	const std::string &text = GetText();
+	static const std::string encoded = Base64_Encode(text.data(), (unsigned int)text.size());
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = BaselineBase64_Decode(encoded);
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Bytes = (double)encoded.size();
+}
+
+TBENCHMARK(Friends_Widen)
+{
+	const std::string &text = GetText();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::wstring output = Widen(text);
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Bytes = (double)text.size();
+}
+
+TBENCHMARK(Friends_Narrow)
+{
+	static const std::wstring text = Widen(GetText());
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = Narrow(text, true);
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Items = (double)text.size();
+}
+
+TBENCHMARK(Friends_Narrow_Ascii)
+{
+	static const std::wstring text = Widen(GetText());
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = Narrow(text);
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Items = (double)text.size();
+}
+
+TBENCHMARK(Friends_Narrow_Baseline)
+{
+	static const std::wstring text = Widen(GetText());
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string output = BaselineNarrow(text);
+		TBenchmark::DoNotOptimize(output.data());
+	}
+	State.Items = (double)text.size();
+}
+
+//---------------------------------------------------------------------------
+// TDateTime
+
+TBENCHMARK(TDateTime_Set)
+{
+	TDateTime date;
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(date.Set("2015-07-21 13:45:10"));
+}
+
+TBENCHMARK(TDateTime_Get)
+{
+	TDateTime date;
+	date.Set(2015, 7, 21, 13, 45, 10);
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::string text = date.Get("YY-mm-dd hh:ii:ss");
+		TBenchmark::DoNotOptimize(text.data());
+	}
+}
+
+TBENCHMARK(TDateTime_Add)
+{
+	TDateTime date;
+	date.Set(2015, 7, 21, 13, 45, 10);
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		date.Add(1, TDateTime::dtDay);
+		TBenchmark::DoNotOptimize(date.Get(TDateTime::dtMonth));
+	}
+}
+
+//---------------------------------------------------------------------------
+// TMultiFit
+
+/*!
+ * \brief Fit a linear model with 10000 points and 8 variables.
+ * \param State State of the benchmark.
+ * \param Method Method of the fit.
+ */
+static void MultiFit(TBenchmark::TState &State, TMultiFit::EFitMethod Method)
+{
+	static std::vector<std::vector<double> > x;
+	static std::vector<double> y;
+	if(y.empty())
+	{
+		std::mt19937_64 generator(42);
+		std::normal_distribution<double> normal(0, 1);
+		x.assign(10000, std::vector<double>(8));
+		y.resize(10000);
+		for(std::size_t j = 0; j < y.size(); j++)
+		{
+			y[j] = normal(generator);
+			for(std::size_t k = 0; k < x[j].size(); k++)
+			{
+				x[j][k] = normal(generator);
+				y[j] += (double)(k % 3) * x[j][k];
+			}
+		}
+	}
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		// setting the values again drops the cached normal equations, so the whole fit is measured
+		TMultiFit fit;
+		if(!fit.SetValues(x, y) || !fit.SetMethod(Method, 0.01, 0.5)) return;
+		TBenchmark::DoNotOptimize(fit.Reduce());
+	}
+	State.Items = (double)y.size();
+}
+
+TBENCHMARK(TMultiFit_LeastSquares)
+{
+	MultiFit(State, TMultiFit::fmLeastSquares);
+}
+
+TBENCHMARK(TMultiFit_Ridge)
+{
+	MultiFit(State, TMultiFit::fmRidge);
+}
+
+TBENCHMARK(TMultiFit_ElasticNet)
+{
+	MultiFit(State, TMultiFit::fmElasticNet);
+}
+
+//---------------------------------------------------------------------------
+// TConfigFile
+
+TBENCHMARK(TConfigFile_ReadFile)
+{
+	const std::string &path = GetConfigFile();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		// a new object parses everything, while rereading the same one would skip unchanged files
+		TConfigFile config;
+		TBenchmark::DoNotOptimize(config.ReadFile(path.c_str()));
+	}
+	State.Items = GetConfigParameters();
+}
+
+TBENCHMARK(TConfigFile_ReadFile_Baseline)
+{
+	const std::string &path = GetConfigFile();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		std::multimap<std::string,std::string> parameters;
+		TBenchmark::DoNotOptimize(BaselineReadFile(path.c_str(), parameters));
+	}
+	State.Items = GetConfigParameters();
+}
+
+TBENCHMARK(TConfigFile_ReadFileUnchanged)
+{
+	const std::string &path = GetConfigFile();
+	static TConfigFile config;
+	for(std::size_t i = 0; i < State.Iterations; i++) TBenchmark::DoNotOptimize(config.ReadFile(path.c_str()));
+	State.Items = GetConfigParameters();
+}
+
+TBENCHMARK(TConfigFile_ReadCache)
+{
+	const std::string &path = GetConfigFile();
+	static const std::string cache = [&path]()
+	{
+		TConfigFile config;
+		config.ReadFile(path.c_str());
+		config.WriteCache((path + ".img").c_str());
+		return path + ".img";
+	}();
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		TConfigFile config;
+		TBenchmark::DoNotOptimize(config.ReadCache(cache.c_str(), path.c_str()));
+	}
+	State.Items = GetConfigParameters();
+}
+
+/*!
+ * \brief Configuration read from the benchmark file (read at the first use).
+ * \return Reference to the configuration.
+ */
+static TConfigFile &GetConfig()
+{
+	static TConfigFile config = []()
+	{
+		TConfigFile value;
+		value.ReadFile(GetConfigFile().c_str());
+		return value;
+	}();
+	return config;
+}
+
+TBENCHMARK(TConfigFile_GetValue)
+{
+	const TConfigFile &config = GetConfig();
+	static std::vector<std::string> keys;
+	for(std::size_t k = keys.size(); k < 1000; k++) keys.push_back("Section" + std::to_string(k % 20) + ".Parameter" + std::to_string((k % 20) * 1000 + k * 7 % 1000));
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		for(std::size_t k = 0; k < keys.size(); k++) TBenchmark::DoNotOptimize(config.GetValue(keys[k]));
+	}
+	State.Items = (double)keys.size();
+}
+
+TBENCHMARK(TConfigFile_GetDouble)
+{
+	TConfigFile &config = GetConfig();
+	static const TConfigFile::THandle handle = config.GetHandle("Section3.Parameter3141");
+	double value = 0;
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		config.GetDouble(handle, value);
+		TBenchmark::DoNotOptimize(value);
+	}
+}
+
+//---------------------------------------------------------------------------
+// TProfiler
+
+TBENCHMARK(TProfiler_Scope)
+{
+	static const TProfiler::TSite site("Benchmark");
+	for(std::size_t i = 0; i < State.Iterations; i++)
+	{
+		TProfiler::TScope scope(site);
+		TBenchmark::ClobberMemory();
+	}
+}
+
+//---------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+	// --large is an option of this program, and the others go to the harness
+	int count = 0;
+	for(int i = 0; i < argc; i++)
+	{
+		if(i > 0 && std::string(argv[i]) == "--large") Large = true;
+		else argv[count++] = argv[i];
+	}
+	return TBenchmark::Main(count, argv);
+}
@@ -1,11 +1,36 @@
 #include <cstdlib>
 #include <fstream>
-#include <sstream>
 #include <ctype.h>
 #include <vector>
 #include <algorithm>
 #include <cmath>
-#include <locale>
+#include <cstring>
+#include <charconv>
+#include <thread>
+#include <string_view>
+#include <unordered_map>
+
+// kernels vetoriais, selecionados na compilao (com verso escalar sempre disponvel)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRIENDS_AVX2
+#define FRIENDS_SSSE3
+#define FRIENDS_SSE2
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define FRIENDS_SSSE3
+#define FRIENDS_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRIENDS_SSE2
+#endif
+
+#include "TBase64.h"
+#include "TCombinations.h"
+#include "THistogram.h"
+#include "TStats.h"
+#include "TTokenizer.h"
+#include "TUnicode.h"
 
 //-----------------------------------------------------------------------------
 
@@ -43,109 +68,679 @@ bool platform_is_little_endian(void)
 	return bint.c[0] != 1;
 }
 
-// comentar
+/*!
+ * \brief Calcular a mdia de um vetor de valores.
+ * \param Valores Vetor com os valores.
+ * \return Mdia dos valores, ou zero se o vetor estiver vazio.
+ */
+double Media(const std::vector<double> &Valores)
+{
+	return TStats(Valores).GetMean();
+}
+
+/*!
+ * \brief Calcular o desvio padro amostral de um vetor de valores (em uma nica passada).
+ * \param Valores Vetor com os valores.
+ * \return Desvio padro dos valores, ou zero se houver menos de dois valores.
+ */
 double DesvioPadrao(const std::vector<double> &Valores)
 {
-    double media = Media(Valores);
-    double n = 1E-9;
-    double s = 0;
-    for(std::vector<double>::const_iterator i = Valores.begin(); i != Valores.end(); i++)
-    {
-        s += std::pow(*i - media,2.0);
-        n += 1.0;
-    }
-    if(n < 1.0) return 0;
-    return std::sqrt(s / (n - 1.0));
+	return TStats(Valores).GetStdDev();
 }
 
 /*!
- * \brief Ajustar um polinmio por MMQ para um dado conjunto de pontos.
- * \param  Xi            Vetor constante dos valores da varivel independente da aproximao.
- * \param  Yi            Vetor constante dos valores da varivel dependente (deve ser pareado com a varivel independente).
- * \param  Coeficientes  Referncia para o vetor na memria (ser alocado dinamicamente) que conter os coeficientes do polinmio calculado.
- * \param  OrdemMax      Ordem mxima do polinmio de aproximao.
- * \return  Verdadeiro se conseguir calcular os polinmios, falso caso no consiga (aps avaliar dados de entrada, tais como vetores vazios).
+ * \brief Obter o nmero de threads para processar N valores (cada parte com, pelo menos, 64K valores).
+ * \param Threads  Nmero de threads solicitado (zero usa o nmero de threads do hardware).
+ * \param N        Nmero de valores.
+ * \return Nmero de threads (pelo menos 1).
  */
-bool AjustePolinomioMMQ(const std::vector<double> &Xi, const std::vector<double> &Yi, double *Coeficientes, int OrdemMax)
+static unsigned int NumeroThreads(unsigned int Threads, size_t N)
 {
-	if(Xi.size() != Yi.size())  return false;
-	int n = Xi.size();
-	// determinar ordem m do polinmio (lembrar que n >= m+1)
-	int m = Min<int> (OrdemMax,n-1);
-	// alocar matriz para localizao de coeficientes
-	double ** matriz = (double**)std::malloc((m+2) * sizeof(double*));
-	for(int i = 0; i <= (m+1); i++)
+	if(Threads == 0)  Threads = std::thread::hardware_concurrency();
+	size_t maximo = N / 65536;
+	if(Threads > maximo)  Threads = (unsigned int)maximo;
+	return (Threads == 0) ? 1 : Threads;
+}
+
+/*!
+ * \brief Executar uma tarefa sobre partes contguas de N valores, cada parte em uma thread.
+ * \param N       Nmero de valores.
+ * \param Partes  Nmero de partes (a parte 0  executada na thread atual).
+ * \param Funcao  Tarefa, chamada com o ndice da parte e o intervalo [Inicio, Fim) dos valores.
+ */
+template <class Tarefa> static void ParaleloPorPartes(size_t N, unsigned int Partes, Tarefa Funcao)
+{
+	std::vector<std::thread> threads;
+	for(unsigned int p = 1; p < Partes; p++)  threads.push_back(std::thread(Funcao, p, N*p/Partes, N*(p+1)/Partes));
+	Funcao(0, (size_t)0, N/Partes);
+	for(size_t i = 0; i < threads.size(); i++)  threads[i].join();
+}
+
+/*!
+ * \brief Classe (ou trecho sem contagem) da distribuio de Moda, em unidades dos valores.
+ */
+struct TClasseModa
+{
+	double Inicio;    /*!< Limite inferior. */
+	double Fim;       /*!< Limite superior. */
+	double Contagem;  /*!< Nmero de amostras. */
+};
+
+/*!
+ * \brief Obter o valor abaixo do qual est uma frao das amostras, interpolando dentro da classe.
+ * \param Classes  Classes em ordem crescente (as extremas podem ter limites infinitos).
+ * \param Total    Nmero de amostras nas classes.
+ * \param P        Frao, de 0.0 a 1.0.
+ * \return Valor correspondente (o limite finito, se cair em uma classe extrema).
+ */
+static double QuantilModa(const std::vector<TClasseModa> &Classes, double Total, double P)
+{
+	double alvo = P * Total, acumulado = 0;
+	for(size_t i = 0; i < Classes.size(); i++)
+	{
+		const TClasseModa &c = Classes[i];
+		if(c.Contagem <= 0 || acumulado + c.Contagem < alvo)
+		{
+			acumulado += c.Contagem;
+			continue;
+		}
+		if(std::isinf(c.Inicio))  return c.Fim;
+		if(std::isinf(c.Fim))  return c.Inicio;
+		return c.Inicio + (alvo - acumulado) / c.Contagem * (c.Fim - c.Inicio);
+	}
+	return Classes.empty() ? 0 : Classes.back().Inicio;
+}
+
+/*!
+ * \brief Estimar a moda de dados contnuos pelo pico da densidade (KDE discretizado).
+ *
+ * Uma nica passada, dividida entre threads e mesclada, conta as distncias |x - r| / s em
+ * histogramas logartmicos (estilo HDR, THistogram), um para cada lado de r; a referncia r e a
+ * escala s so a mediana e a amplitude interquartil de 1024 amostras espaadas. As classes so
+ * mais finas perto da massa dos dados (largura relativa de 1/256 da distncia a r), e valores
+ * distantes (outliers) s ocupam classes largas ou os contadores de estouro, sem engrossar a
+ * resoluo perto do pico. Os quantis das classes do a largura de banda de Silverman, com a
+ * escala robusta IQR/1.34, e a faixa de avaliao (quantis 0.05% a 99.95% das classes finitas,
+ * sem os estouros). As classes so redistribudas em uma grade uniforme com 4 pontos por largura
+ * de banda, suavizadas por um ncleo gaussiano, e o pico  refinado por interpolao parablica
+ * entre os pontos vizinhos. Se a faixa precisar de mais de 2^20 pontos (outliers distantes, mas
+ * dentro dos histogramas), a grade  refeita em volta do pico da grade grossa at chegar 
+ * resoluo de 4 pontos por banda.
+ *
+ * \param Valores  Vetor com as amostras (valores NaN so ignorados).
+ * \param Threads  Nmero de threads (zero usa o nmero de threads do hardware).
+ * \return Moda estimada, ou zero se no houver amostras.
+ */
+double Moda(const std::vector<double> &Valores, unsigned int Threads)
+{
+	size_t n = Valores.size();
+	if(n == 0) return 0;
+	// referncia e escala de uma amostra espaada (no  uma passada sobre os dados)
+	std::vector<double> amostra;
+	for(size_t k = 0, m = Min<size_t>(n, 1024); k < m; k++)
 	{
-		matriz[i] = (double*)std::malloc((m+3) * sizeof(double));
-		for(int j = 0; j <= (m+2); j++)  matriz[i][j] = 0.0;
+		double v = Valores[k * (n / m)];
+		if(v == v && !std::isinf(v))  amostra.push_back(v);
 	}
-	// montar matriz de Gauss do sistema linear do MMQ polinomial
-	for(int k = 0; k <= m; k++)
+	if(amostra.empty()) return 0;
+	std::sort(amostra.begin(), amostra.end());
+	double referencia = amostra[amostra.size() / 2];
+	double escala = amostra[amostra.size() * 3 / 4] - amostra[amostra.size() / 4];
+	if(!(escala > 0))  escala = amostra.back() - amostra.front();
+	if(!(escala > 0))  escala = (referencia != 0) ? std::fabs(referencia) : 1.0;
+	// passada nica: distncias relativas de 2^-24 a 2^24 escalas, com 2^8 classes por oitava
+	const double menor = std::ldexp(1.0, -24), maior = std::ldexp(1.0, 24);
+	unsigned int partes = NumeroThreads(Threads, n);
+	std::vector<THistogram> positivos(partes), negativos(partes);
+	ParaleloPorPartes(n, partes, [&](unsigned int p, size_t inicio, size_t fim)
 	{
-		double b = 0;
-		double *A = (double*)std::malloc((m+1) * sizeof(double));
-		for(int i = 0; i <= m; i++) A[i] = 0.0;
-		for(int i = 0; i < n; i++)
+		THistogram &pos = positivos[p], &neg = negativos[p];
+		pos.SetLogarithmic(menor, maior, 8);
+		neg.SetLogarithmic(menor, maior, 8);
+		const size_t bloco = 256;
+		double acima[bloco], abaixo[bloco];
+		double inverso = 1.0 / escala;
+		for(size_t b = inicio; b < fim; b += bloco)
 		{
-			b += (k == 0) ? Yi[i] : Yi[i] * std::pow(Xi[i],(double)k);
-        }
-		for(int j = 0; j <= m; j++)
+			size_t m = Min<size_t>(fim - b, bloco), na = 0, nb = 0;
+			for(size_t i = 0; i < m; i++)  // separa os lados sem desvios (NaN no entra em nenhum)
+			{
+				double d = (Valores[b + i] - referencia) * inverso;
+				acima[na] = d;
+				abaixo[nb] = -d;
+				na += (d >= 0);
+				nb += (d < 0);
+			}
+			pos.Add(acima, na);
+			neg.Add(abaixo, nb);
+		}
+	});
+	for(unsigned int p = 1; p < partes; p++)
+	{
+		positivos[0].Merge(positivos[p]);
+		negativos[0].Merge(negativos[p]);
+	}
+	const THistogram &pos = positivos[0], &neg = negativos[0];
+	// classes em ordem crescente de valor: estouro abaixo, lado negativo, centro, lado positivo e estouro acima
+	std::vector<TClasseModa> classes;
+	classes.reserve(2 * pos.GetBins() + 3);
+	TClasseModa c;
+	c.Inicio = -INFINITY;
+	c.Fim = referencia - escala * neg.GetBinUpper(neg.GetBins() - 1);
+	c.Contagem = (double)neg.GetOverflow();
+	classes.push_back(c);
+	for(unsigned int k = neg.GetBins(); k-- > 0; )
+	{
+		c.Inicio = referencia - escala * neg.GetBinUpper(k);
+		c.Fim = referencia - escala * neg.GetBinLower(k);
+		c.Contagem = (double)neg.GetCount(k);
+		classes.push_back(c);
+	}
+	c.Inicio = referencia - escala * pos.GetBinLower(0);
+	c.Fim = referencia + escala * pos.GetBinLower(0);
+	c.Contagem = (double)(neg.GetUnderflow() + pos.GetUnderflow());
+	classes.push_back(c);
+	for(unsigned int k = 0; k < pos.GetBins(); k++)
+	{
+		c.Inicio = referencia + escala * pos.GetBinLower(k);
+		c.Fim = referencia + escala * pos.GetBinUpper(k);
+		c.Contagem = (double)pos.GetCount(k);
+		classes.push_back(c);
+	}
+	c.Inicio = referencia + escala * pos.GetBinUpper(pos.GetBins() - 1);
+	c.Fim = INFINITY;
+	c.Contagem = (double)pos.GetOverflow();
+	classes.push_back(c);
+	double total = (double)(pos.GetTotal() + neg.GetTotal());
+	if(total == 0) return 0;
+	// largura de banda de Silverman com escala robusta; mais da metade em uma classe  a prpria moda
+	double iqr = QuantilModa(classes, total, 0.75) - QuantilModa(classes, total, 0.25);
+	if(!(iqr > 0))
+	{
+		size_t cheia = 0;
+		for(size_t i = 1; i < classes.size(); i++)  if(classes[i].Contagem > classes[cheia].Contagem) cheia = i;
+		const TClasseModa &m = classes[cheia];
+		return std::isinf(m.Inicio) ? m.Fim : (std::isinf(m.Fim) ? m.Inicio : 0.5 * (m.Inicio + m.Fim));
+	}
+	double banda = 1.06 * (iqr / 1.34) * std::pow(total, -0.2);
+	// faixa da massa central, com quantis apenas das classes finitas (os estouros ficam de fora)
+	double abaixo = classes.front().Contagem, finitas = total - abaixo - classes.back().Contagem;
+	double inicio = QuantilModa(classes, total, (abaixo + 0.0005 * finitas) / total) - 4.0 * banda;
+	double fim = QuantilModa(classes, total, (abaixo + 0.9995 * finitas) / total) + 4.0 * banda;
+	// grade uniforme com 4 pontos por largura de banda (no mximo 2^20); se a faixa for larga
+	// demais (muitos outliers dentro dos histogramas), a grade grossa s localiza o pico e  refeita
+	// em volta dele, at que a largura dos pontos chegue a um quarto da banda
+	for(;;)
+	{
+		double necessarios = std::ceil((fim - inicio) / (banda / 4.0));
+		int pontos = Max<int>((int)Min<double>(necessarios, 1 << 20), 3);
+		double largura = (fim - inicio) / pontos;
+		std::vector<double> f(pontos, 0.0);
+		for(size_t i = 0; i < classes.size(); i++)  // massa de cada classe repartida pela sobreposio
 		{
-			A[j] = 0.0;
-			for(int i = 0; i < n; i++)
+			const TClasseModa &classe = classes[i];
+			if(classe.Contagem <= 0 || std::isinf(classe.Inicio) || std::isinf(classe.Fim) || classe.Fim <= inicio || classe.Inicio >= fim) continue;
+			double altura = classe.Contagem / (classe.Fim - classe.Inicio);
+			double a = Max<double>(classe.Inicio, inicio), b = Min<double>(classe.Fim, fim);
+			int j = Min<int>((int)((a - inicio) / largura), pontos - 1), jf = Min<int>((int)((b - inicio) / largura), pontos - 1);
+			for(; j <= jf; j++)
 			{
-				A[j] += ((k+j) == 0) ? 1.0 : std::pow(Xi[i],(k+j));
-        	}
-        }
-        for(int i = 0; i <= m; i++)
-        {
-        	matriz[k][i] = A[i];
-        }
-        matriz[k][m+1] = b;
-        std::free(A);
-	}
-	// triangularizar por reduo de Gauss a matriz do sistema linear
-	for(int i = 0; i < m; i++)
-	{
-		for(int j = (i+1); j <= m; j++)
+				double ca = Max<double>(a, inicio + j * largura), cb = Min<double>(b, inicio + (j + 1) * largura);
+				if(cb > ca)  f[j] += altura * (cb - ca);
+			}
+		}
+		// suavizao gaussiana, com a largura de banda em nmero de pontos
+		double sigma = banda / largura;
+		int raio = Min<int>((int)std::ceil(4.0 * sigma), pontos);
+		std::vector<double> densidade(f);
+		if(sigma > 0.5)
 		{
-			double fator = matriz[j][i] / matriz[i][i];
-			for(int k = i; k <= (m+1); k++)
+			std::vector<double> nucleo(raio + 1);
+			for(int k = 0; k <= raio; k++)  nucleo[k] = std::exp(-0.5 * (k / sigma) * (k / sigma));
+			for(int i = 0; i < pontos; i++)
 			{
-				matriz[j][k] = matriz[j][k] - matriz[i][k] * fator;
+				double soma = 0;
+				int a = Max<int>(i - raio, 0), b = Min<int>(i + raio, pontos - 1);
+				for(int j = a; j <= b; j++)  soma += f[j] * nucleo[(j > i) ? j - i : i - j];
+				densidade[i] = soma;
 			}
 		}
+		int pico = std::max_element(densidade.begin(), densidade.end()) - densidade.begin();
+		double deslocamento = 0;
+		if(pico > 0 && pico < pontos - 1)
+		{
+			double a = densidade[pico-1], b = densidade[pico], d = densidade[pico+1];
+			double curvatura = a - 2.0 * b + d;
+			if(curvatura < 0)  deslocamento = 0.5 * (a - d) / curvatura;
+		}
+		if(necessarios <= (1 << 20))  return inicio + (pico + 0.5 + deslocamento) * largura;
+		double centro = inicio + (pico + 0.5) * largura;
+		inicio = centro - 2.0 * largura - 4.0 * banda;
+		fim = centro + 2.0 * largura + 4.0 * banda;
 	}
-	// obter solues da reduo de Gauss (o vetor j deve estar alocado para, pelo menos, OrdemMax+1)
-	Coeficientes[m] = matriz[m][m+1] / matriz[m][m];
-	for(int i = (m-1); i >= 0; i--)
+}
+
+/*!
+ * \brief Obter a moda exata de dados discretos (ou discretizados) por contagem em tabela hash.
+ *
+ * Cada thread conta uma parte contgua dos dados em sua prpria tabela, e as tabelas so mescladas
+ * ao final. Em caso de empate, retorna o menor valor.
+ *
+ * \param Valores    Vetor com as amostras (valores NaN so ignorados).
+ * \param Resolucao  Se positiva, os valores so arredondados para mltiplos dela antes da contagem; se zero, os valores so comparados exatamente.
+ * \param Threads    Nmero de threads (zero usa o nmero de threads do hardware).
+ * \return Valor mais frequente, ou zero se no houver amostras.
+ */
+double ModaDiscreta(const std::vector<double> &Valores, double Resolucao, unsigned int Threads)
+{
+	size_t n = Valores.size();
+	unsigned int partes = NumeroThreads(Threads, n);
+	std::vector<std::unordered_map<long long,unsigned long long> > tabelas(partes);
+	// a chave  o mltiplo da resoluo, ou os bits do prprio valor
+	ParaleloPorPartes(n, partes, [&](unsigned int p, size_t inicio, size_t fim)
+	{
+		std::unordered_map<long long,unsigned long long> &tabela = tabelas[p];
+		for(size_t i = inicio; i < fim; i++)
+		{
+			double v = Valores[i];
+			if(v != v) continue;
+			long long chave;
+			if(Resolucao > 0)  chave = std::llround(v / Resolucao);
+			else
+			{
+				v += 0.0;  // -0.0 e 0.0 na mesma chave
+				std::memcpy(&chave, &v, sizeof(chave));
+			}
+			tabela[chave]++;
+		}
+	});
+	for(unsigned int p = 1; p < partes; p++)
 	{
-		double soma = 0.0;
-		for(int j = (i+1); j <= m; j++)  soma += matriz[i][j] * Coeficientes[j];
-		Coeficientes[i] = (1.0/matriz[i][i])*(matriz[i][m+1] - soma);
+		for(std::unordered_map<long long,unsigned long long>::const_iterator it = tabelas[p].begin(); it != tabelas[p].end(); it++)
+		{
+			tabelas[0][it->first] += it->second;
+		}
+	}
+	bool achou = false;
+	double moda = 0;
+	unsigned long long maximo = 0;
+	for(std::unordered_map<long long,unsigned long long>::const_iterator it = tabelas[0].begin(); it != tabelas[0].end(); it++)
+	{
+		double v;
+		if(Resolucao > 0)  v = it->first * Resolucao;
+		else  std::memcpy(&v, &it->first, sizeof(v));
+		if(!achou || it->second > maximo || (it->second == maximo && v < moda))
+		{
+			moda = v;
+			maximo = it->second;
+			achou = true;
+		}
+	}
+	return moda;
+}
+
+/*!
+ * \brief Calcular o histograma de um conjunto de amostras, com classes de mesma largura entre o mnimo e o mximo.
+ * \param Amostras      Vetor com as amostras.
+ * \param Frequencias   Vetor que receber a frequncia de cada classe; se no estiver vazio, seu tamanho define o nmero de classes, seno  usada a regra de Sturges.
+ * \param FreqRelativa  Verdadeiro para frequncias relativas (soma 1), falso para contagens absolutas.
+ */
+void Histograma(const std::vector<double> &Amostras, std::vector<double> &Frequencias, bool FreqRelativa)
+{
+	unsigned int classes = Frequencias.size();
+	if(classes == 0)  classes = (unsigned int)std::ceil(std::log((double)Amostras.size() + 1.0) / std::log(2.0)) + 1;
+	Frequencias.assign(classes, 0.0);
+	if(Amostras.empty()) return;
+	TStats stats(Amostras);
+	double minimo = stats.GetMin(), maximo = stats.GetMax();
+	THistogram histograma;
+	// o mximo entra na ltima classe (o intervalo das classes  aberto  direita)
+	double folga = (maximo > minimo) ? (maximo - minimo) * 1E-12 : 0.5;
+	if(!histograma.SetLinear(minimo - ((maximo > minimo) ? 0.0 : folga), maximo + folga, classes)) return;
+	histograma.Add(Amostras);
+	histograma.GetFrequencies(Frequencias, FreqRelativa);
+}
+
+/*!
+ * \brief Obter a abcissa na qual a frequncia acumulada de um trecho de memria atinge um dado valor (copiando as amostras uma nica vez).
+ * \param Amostras  Ponteiro para as amostras (no necessariamente ordenadas).
+ * \param N         Nmero de amostras.
+ * \param P         Frequncia acumulada, de 0.0 a 1.0.
+ * \return Abcissa correspondente, ou zero se no houver amostras.
+ */
+static double AbcissaSelecao(const double *Amostras, size_t N, const double P)
+{
+	if(N == 0) return 0;
+	double h = Min<double>(Max<double>(P, 0.0), 1.0) * (N - 1);
+	size_t k = (size_t)std::floor(h);
+	std::vector<double> vetor(Amostras, Amostras + N);
+	std::nth_element(vetor.begin(), vetor.begin() + k, vetor.end());
+	double valor = vetor[k];
+	if(k + 1 < vetor.size() && h > k)
+	{
+		// a prxima amostra ordenada  o mnimo do trecho  direita
+		double proximo = *std::min_element(vetor.begin() + k + 1, vetor.end());
+		valor += (h - k) * (proximo - valor);
+	}
+	return valor;
+}
+
+/*!
+ * \brief Obter a abcissa na qual a frequncia acumulada das amostras atinge um dado valor (inversa da distribuio emprica).
+ * \param Vetor   Vetor com as amostras (no necessariamente ordenadas).
+ * \param P       Frequncia acumulada, de 0.0 a 1.0.
+ * \return Abcissa correspondente, ou zero se no houver amostras.
+ */
+double AbcissaFreqAcumulada(const std::vector<double> &Vetor, const double P)
+{
+	return AbcissaSelecao(Vetor.data(), Vetor.size(), P);
+}
+
+/*!
+ * \brief Obter a abcissa na qual a frequncia acumulada das amostras atinge um dado valor (inversa da distribuio emprica).
+ *
+ * Usa seleo (nth_element), em O(n), com interpolao linear entre as duas amostras vizinhas.
+ * Para consultas repetidas sobre grandes volumes, ver THistogram::InverseCumulative.
+ *
+ * \param Vetor   Ponteiro para as amostras (no necessariamente ordenadas).
+ * \param NPonto  Nmero de amostras.
+ * \param P       Frequncia acumulada, de 0.0 a 1.0.
+ * \return Abcissa correspondente, ou zero se no houver amostras.
+ */
+double AbcissaFreqAcumulada(double* Vetor, const unsigned int NPonto, const double P)
+{
+	return AbcissaSelecao(Vetor, NPonto, P);
+}
+
+/*!
+ * \brief Fatorar uma matriz quadrada por QR de Householder com pivoteamento de colunas (AP = QR).
+ * \param A     Matriz q x q armazenada por linhas; ao final, contm R no tringulo superior e os refletores abaixo da diagonal.
+ * \param q     Dimenso da matriz.
+ * \param Tau   Vetor que receber os fatores dos refletores de Householder.
+ * \param Perm  Vetor que receber a permutao das colunas.
+ * \return Posto numrico da matriz (as colunas alm do posto so consideradas dependentes).
+ */
+static int FatorarQRPivotado(std::vector<double> &A, int q, std::vector<double> &Tau, std::vector<int> &Perm)
+{
+	Tau.assign(q, 0.0);
+	Perm.resize(q);
+	std::vector<double> norma(q, 0.0);
+	for(int j = 0; j < q; j++)
+	{
+		Perm[j] = j;
+		for(int i = 0; i < q; i++) norma[j] += A[i*q+j] * A[i*q+j];
+	}
+	double rmax = 0;
+	int posto = 0;
+	for(int k = 0; k < q; k++)
+	{
+		// piv: coluna restante de maior norma
+		int p = k;
+		for(int j = k+1; j < q; j++)  if(norma[j] > norma[p]) p = j;
+		if(p != k)
+		{
+			for(int i = 0; i < q; i++)  std::swap(A[i*q+k], A[i*q+p]);
+			std::swap(norma[k], norma[p]);
+			std::swap(Perm[k], Perm[p]);
+		}
+		double s = std::sqrt(norma[k]);
+		if(k == 0) rmax = s;
+		if(s == 0 || s <= 1E-13 * q * rmax) break;  // colunas restantes dependentes
+		// refletor H = I - tau*v*v', com v = [1, A[k+1..q-1][k]]
+		double alfa = (A[k*q+k] > 0) ? -s : s;
+		double v0 = A[k*q+k] - alfa;
+		for(int i = k+1; i < q; i++)  A[i*q+k] /= v0;
+		Tau[k] = -v0 / alfa;
+		A[k*q+k] = alfa;
+		for(int j = k+1; j < q; j++)
+		{
+			double d = A[k*q+j];
+			for(int i = k+1; i < q; i++)  d += A[i*q+k] * A[i*q+j];
+			d *= Tau[k];
+			A[k*q+j] -= d;
+			norma[j] = 0;
+			for(int i = k+1; i < q; i++)
+			{
+				A[i*q+j] -= d * A[i*q+k];
+				norma[j] += A[i*q+j] * A[i*q+j];
+			}
+		}
+		posto++;
+	}
+	return posto;
+}
+
+/*!
+ * \brief Resolver um sistema linear j fatorado por FatorarQRPivotado (soluo bsica, com as componentes dependentes nulas).
+ * \param A      Matriz fatorada.
+ * \param q      Dimenso da matriz.
+ * \param Tau    Fatores dos refletores de Householder.
+ * \param Perm   Permutao das colunas.
+ * \param Posto  Posto numrico da matriz.
+ * \param b      Vetor dos termos independentes (cpia, pois ser transformado).
+ * \param x      Vetor que receber a soluo (q elementos).
+ */
+static void ResolverQRPivotado(const std::vector<double> &A, int q, const std::vector<double> &Tau, const std::vector<int> &Perm, int Posto, std::vector<double> b, double *x)
+{
+	// b = Q'b
+	for(int k = 0; k < Posto; k++)
+	{
+		double d = b[k];
+		for(int i = k+1; i < q; i++)  d += A[i*q+k] * b[i];
+		d *= Tau[k];
+		b[k] -= d;
+		for(int i = k+1; i < q; i++)  b[i] -= d * A[i*q+k];
+	}
+	// retrosubstituio em R
+	std::vector<double> z(q, 0.0);
+	for(int i = Posto-1; i >= 0; i--)
+	{
+		double soma = b[i];
+		for(int j = i+1; j < Posto; j++)  soma -= A[i*q+j] * z[j];
+		z[i] = soma / A[i*q+i];
+	}
+	for(int j = 0; j < q; j++)  x[Perm[j]] = z[j];
+}
+
+/*!
+ * \brief Ajustar polinmios por MMQ para vrias sries com as mesmas abcissas.
+ *
+ * As abcissas so mapeadas para [-1,1] e o ajuste  feito na base de polinmios de Chebyshev,
+ * que  bem condicionada mesmo para ordens altas. Os momentos necessrios (somatrios de T_k(t)
+ * e de y*T_k(t)) so acumulados em uma nica passada pelos dados, pela recorrncia
+ * T_{k+1} = 2t*T_k - T_{k-1}, sem nenhuma chamada a pow(). Como T_i*T_j = (T_{i+j} + T_{|i-j|})/2,
+ * a matriz normal sai diretamente dos momentos, e  fatorada uma nica vez por QR com pivoteamento
+ * para todas as sries. Ao final, os coeficientes so convertidos para a base de potncias de x.
+ *
+ * \param  Xi            Vetor dos valores da varivel independente.
+ * \param  Series        Ponteiros para os vetores da varivel dependente (pareados com Xi).
+ * \param  Coeficientes  Ponteiros para os vetores de sada (cada um com, pelo menos, OrdemMax+1 elementos).
+ * \param  OrdemMax      Ordem mxima do polinmio de aproximao.
+ * \return Verdadeiro se conseguir calcular os polinmios, falso caso os dados de entrada sejam invlidos.
+ */
+static bool AjustePolinomioChebyshev(const std::vector<double> &Xi, const std::vector<const std::vector<double>*> &Series, const std::vector<double*> &Coeficientes, int OrdemMax)
+{
+	int n = Xi.size();
+	int ns = Series.size();
+	if(n == 0 || OrdemMax < 0) return false;
+	for(int s = 0; s < ns; s++)  if((int)Series[s]->size() != n) return false;
+	// determinar ordem m do polinmio (lembrar que n >= m+1)
+	int m = Min<int> (OrdemMax,n-1);
+	int q = m+1;
+	// mapear abcissas para [-1,1]
+	double xmin = Xi[0], xmax = Xi[0];
+	for(int i = 1; i < n; i++)
+	{
+		xmin = Min<double>(xmin, Xi[i]);
+		xmax = Max<double>(xmax, Xi[i]);
+	}
+	double centro = 0.5 * (xmax + xmin);
+	double escala = (xmax > xmin) ? 2.0 / (xmax - xmin) : 1.0;
+	// momentos de Chebyshev em uma nica passada
+	std::vector<double> mom(2*m+1, 0.0);
+	std::vector<double> momy(ns*q, 0.0);
+	std::vector<double> tk(2*m+1);
+	for(int i = 0; i < n; i++)
+	{
+		double t = escala * (Xi[i] - centro);
+		tk[0] = 1.0;
+		if(m > 0) tk[1] = t;
+		for(int k = 2; k <= 2*m; k++)  tk[k] = 2.0 * t * tk[k-1] - tk[k-2];
+		for(int k = 0; k <= 2*m; k++)  mom[k] += tk[k];
+		for(int s = 0; s < ns; s++)
+		{
+			double y = (*Series[s])[i];
+			double *my = &momy[s*q];
+			for(int k = 0; k < q; k++)  my[k] += y * tk[k];
+		}
+	}
+	// matriz normal na base de Chebyshev, fatorada uma vez para todas as sries
+	std::vector<double> matriz(q*q);
+	for(int i = 0; i < q; i++)
+	{
+		for(int j = 0; j < q; j++)  matriz[i*q+j] = 0.5 * (mom[i+j] + mom[(i > j) ? i-j : j-i]);
+	}
+	std::vector<double> tau;
+	std::vector<int> perm;
+	int posto = FatorarQRPivotado(matriz, q, tau, perm);
+	// coeficientes de potncias de t de cada T_k (triangular inferior, q x q)
+	std::vector<double> cheb(q*q, 0.0);
+	cheb[0] = 1.0;
+	if(m > 0) cheb[q+1] = 1.0;
+	for(int k = 2; k < q; k++)
+	{
+		for(int j = 0; j <= k; j++)
+		{
+			cheb[k*q+j] = ((j > 0) ? 2.0 * cheb[(k-1)*q+j-1] : 0.0) - cheb[(k-2)*q+j];
+		}
+	}
+	std::vector<double> c(q), at(q), ax(q);
+	for(int s = 0; s < ns; s++)
+	{
+		ResolverQRPivotado(matriz, q, tau, perm, posto, std::vector<double>(momy.begin() + s*q, momy.begin() + (s+1)*q), &c[0]);
+		// converter para potncias de t
+		for(int j = 0; j < q; j++)
+		{
+			at[j] = 0.0;
+			for(int k = j; k < q; k++)  at[j] += c[k] * cheb[k*q+j];
+		}
+		// converter para potncias de x por Horner, com t = escala*x - escala*centro
+		std::fill(ax.begin(), ax.end(), 0.0);
+		for(int j = m; j >= 0; j--)
+		{
+			for(int k = m; k > 0; k--)  ax[k] = ax[k] * (-escala * centro) + ax[k-1] * escala;
+			ax[0] = ax[0] * (-escala * centro) + at[j];
+		}
+		double *coef = Coeficientes[s];
+		for(int k = 0; k <= OrdemMax; k++)  coef[k] = (k <= m) ? ax[k] : 0.0;
 	}
-	// se chegou aqui, conseguir realizar o processo
 	return true;
 }
 
+/*!
+ * \brief Ajustar um polinmio por MMQ para um dado conjunto de pontos.
+ * \param  Xi            Vetor constante dos valores da varivel independente da aproximao.
+ * \param  Yi            Vetor constante dos valores da varivel dependente (deve ser pareado com a varivel independente).
+ * \param  Coeficientes  Vetor j alocado com, pelo menos, OrdemMax+1 elementos, que conter os coeficientes do polinmio calculado (os de ordem acima de n-1 sero nulos).
+ * \param  OrdemMax      Ordem mxima do polinmio de aproximao.
+ * \return  Verdadeiro se conseguir calcular os polinmios, falso caso no consiga (aps avaliar dados de entrada, tais como vetores vazios).
+ */
+bool AjustePolinomioMMQ(const std::vector<double> &Xi, const std::vector<double> &Yi, double *Coeficientes, int OrdemMax)
+{
+	std::vector<const std::vector<double>*> series(1, &Yi);
+	std::vector<double*> coeficientes(1, Coeficientes);
+	return AjustePolinomioChebyshev(Xi, series, coeficientes, OrdemMax);
+}
+
+/*!
+ * \brief Ajustar polinmios por MMQ para vrias sries de mesmo tamanho, com as mesmas abcissas.
+ *
+ * Os momentos das abcissas e a fatorao do sistema so calculados uma nica vez para todas as sries.
+ *
+ * \param  Xi            Vetor constante dos valores da varivel independente da aproximao.
+ * \param  Yi            Matriz com uma srie da varivel dependente por linha (cada uma pareada com Xi).
+ * \param  Coeficientes  Matriz que receber os coeficientes (OrdemMax+1) do polinmio de cada srie.
+ * \param  OrdemMax      Ordem mxima do polinmio de aproximao.
+ * \return  Verdadeiro se conseguir calcular os polinmios, falso caso no consiga (aps avaliar dados de entrada, tais como vetores vazios).
+ */
+bool AjustePolinomioMMQ(const std::vector<double> &Xi, const std::vector<std::vector<double> > &Yi, std::vector<std::vector<double> > &Coeficientes, int OrdemMax)
+{
+	if(OrdemMax < 0) return false;
+	Coeficientes.assign(Yi.size(), std::vector<double>(OrdemMax+1, 0.0));
+	std::vector<const std::vector<double>*> series;
+	std::vector<double*> coeficientes;
+	for(unsigned int s = 0; s < Yi.size(); s++)
+	{
+		series.push_back(&Yi[s]);
+		coeficientes.push_back(&Coeficientes[s][0]);
+	}
+	return AjustePolinomioChebyshev(Xi, series, coeficientes, OrdemMax);
+}
+
+/*!
+ * \brief Obter a posio (base 0) do percentil P em um vetor ordenado de NPonto elementos.
+ * \param NPonto Nmero de elementos.
+ * \param P Percentil, de 0.0 a 1.0 (valores fora do intervalo so saturados).
+ * \return Posio do elemento correspondente ao percentil.
+ */
+static size_t PosicaoPercentil(size_t NPonto, double P)
+{
+	if(!(P > 0)) return 0;
+	size_t k = (size_t)std::floor(P * NPonto);
+	return (k >= NPonto) ? NPonto - 1 : k;
+}
+
 /*!
  * \brief Calcula o percentil P para variaveis discretas.
+ *
+ * Usa seleo (introselect, via nth_element) em vez de ordenar a cpia inteira, em O(n).
+ *
  * \param  Vetor double com valores no necessriamente ordenados
  * \param P double, percentil a ser calculado numero de 0.0 a 1.0
- * \return Retorna o valor do percentil desejado, ou seja o valor menor ou igual a probabilidade P.
+ * \return Retorna o valor do percentil desejado, ou seja o valor menor ou igual a probabilidade P (zero se o vetor estiver vazio).
  */
 double Percentil(const std::vector<double> &Amostras, const double P)
 {
-	double valor;
-	long k;
 	size_t NPonto = Amostras.size(); // Contagem inicia de 0
-	//  Cria um vetor para armazenar o vetor ordenado.
+	if(NPonto == 0) return 0;
+	//  Cria um vetor para a seleo ( parcialmente reordenado).
 	std::vector<double> vetorordenado(Amostras);
-	k = (long)std::floor(P * NPonto);
-	//  Ordena Vetor
-	std::sort(vetorordenado.begin(),vetorordenado.end());
-	valor = vetorordenado[k];
-	return valor;
+	size_t k = PosicaoPercentil(NPonto, P);
+	std::nth_element(vetorordenado.begin(), vetorordenado.begin() + k, vetorordenado.end());
+	return vetorordenado[k];
+}
+
+/*!
+ * \brief Calcula vrios percentis de um mesmo vetor, com uma nica cpia dos dados.
+ *
+ * As posies so selecionadas em ordem crescente, e cada seleo (nth_element)  feita apenas
+ * no trecho  direita da anterior, que j est particionado.
+ *
+ * \param Amostras Vetor com valores no necessariamente ordenados.
+ * \param P        Percentis a serem calculados (de 0.0 a 1.0, em qualquer ordem).
+ * \param Valores  Vetor que receber o valor de cada percentil, na mesma ordem de P (zeros se Amostras estiver vazio).
+ */
+void Percentis(const std::vector<double> &Amostras, const std::vector<double> &P, std::vector<double> &Valores)
+{
+	Valores.assign(P.size(), 0.0);
+	size_t NPonto = Amostras.size();
+	if(NPonto == 0 || P.empty()) return;
+	std::vector<double> vetor(Amostras);
+	// ordenar as consultas pela posio
+	std::vector<std::pair<size_t,size_t> > consultas;
+	for(size_t i = 0; i < P.size(); i++)  consultas.push_back(std::make_pair(PosicaoPercentil(NPonto, P[i]), i));
+	std::sort(consultas.begin(), consultas.end());
+	std::vector<double>::iterator inicio = vetor.begin();
+	for(size_t i = 0; i < consultas.size(); i++)
+	{
+		std::vector<double>::iterator alvo = vetor.begin() + consultas[i].first;
+		if(alvo >= inicio)
+		{
+			std::nth_element(inicio, alvo, vetor.end());
+			inicio = alvo + 1;
+		}
+		Valores[consultas[i].second] = *alvo;
+	}
 }
 
 /*!
@@ -157,27 +752,13 @@ double Percentil(const std::vector<double> &Amostras, const double P)
 void Binomio(int ValorMax, int NumCasas, std::vector<std::vector<int> > &Combinacoes)
 {
     Combinacoes.clear();
-    std::vector<int> permutacao(NumCasas,1);
-    bool done;
+    // para percorrer sem armazenar (ou em paralelo), ver TCombinations
+    TCombinations gerador(ValorMax, NumCasas);
+    if(gerador.GetCount() > 0) Combinacoes.reserve(gerador.GetCount());
     do
     {
-        Combinacoes.push_back(permutacao);
-        // incremental sempre pelo ltimo dgito, fazer rolagem quando este chegar no mximo
-        done = true;  // a princpio, j chegamos na combinao (n,n,n,...)
-        for(int i = (NumCasas-1); i >= 0; i--)
-        {
-            if(permutacao[i]++ > ValorMax)
-            {
-                permutacao[i] = 1;
-                continue;  // reiniciou o ltimo, partiu para o anterior
-            }
-            else
-            {
-                done = false;  // ainda h o que incrementar, nem todos os dgitos causaram rolagem
-                break;
-            }
-        }
-    } while(!done);
+        Combinacoes.push_back(gerador.Get());
+    } while(gerador.Next());
 }
 
 /*!
@@ -188,46 +769,206 @@ void Binomio(int ValorMax, int NumCasas, std::vector<std::vector<int> > &Combina
 double TendenciaLinear(const std::vector<double> &Valores)
 {
     if(Valores.size() == 0) return 0;
-    double mx = 0, my = 0;
-    double soma1 = 0, soma2 = 0;
-    double m = 0, b = 0;
-    double k = 1;
-    for(std::vector<double>::const_reverse_iterator i = Valores.rbegin(); i != Valores.rend(); i++)
-    {
-        double y = *i;
-        my += y;
-        mx += k;
-        k += 1.0;
-    }
-    mx /= (double)Valores.size();
-    my /= (double)Valores.size();
-    k = 1;
-    for(std::vector<double>::const_reverse_iterator i = Valores.rbegin(); i != Valores.rend(); i++)
-    {
-        double y = *i;
-        soma1 += (k - mx) * (y - my);
-        soma2 += std::pow(k - mx,2.0);
-        k += 1.0;
-    }
-    m = soma1 / soma2;
-    b = my - m * mx;
-    return (m + b);
+    // valor da reta de tendncia na posio do ltimo elemento
+    TStats stats(Valores);
+    return stats.GetIntercept() + stats.GetSlope() * (stats.GetCount() - 1.0);
 }
 
+/*!
+ * \brief Calcular a mdia dos ltimos valores de uma srie (para a srie inteira de mdias mveis, ver TRollingWindow).
+ * \param Valores Vetor com os valores da srie numrica.
+ * \param Largura Nmero de valores (a partir do ltimo) considerados na mdia.
+ * \return Mdia dos ltimos Largura valores (ou de todos, se houver menos), ou zero se no houver valores.
+ */
 double MediaMovel(const std::vector<double> &Valores, int Largura)
 {
     std::vector<double>::const_reverse_iterator it = Valores.rbegin();
-    double soma = 0, n = 1E-8;
-    for(int i = 0; i < Largura; i++)
-    {
-        if(it == Valores.rend()) break;
-        soma += *it;
-        n += 1.0;
-        it++;
-    }
-    return(soma/n);
+    double soma = 0;
+    int n = 0;
+    for(; n < Largura && it != Valores.rend(); n++, it++)  soma += *it;
+    return (n > 0) ? soma/n : 0.0;
+}
+
+
+/*!
+ * \brief Converter a caixa dos caracteres ASCII de um intervalo (invertendo o bit 0x20), de Entrada para Saida.
+ *
+ * Processa 32 (AVX2) ou 16 (SSE2) bytes por vez quando disponvel, e o restante sem desvios.
+ * Caracteres fora do intervalo (inclusive os no-ASCII) so copiados sem alterao.
+ *
+ * \param Entrada  Texto de entrada.
+ * \param Saida    Buffer de sada com, pelo menos, Tamanho bytes (pode ser o prprio Entrada).
+ * \param Tamanho  Nmero de bytes.
+ * \param Inicio   Primeiro caractere do intervalo convertido ('a' ou 'A').
+ * \param Fim      ltimo caractere do intervalo convertido ('z' ou 'Z').
+ */
+static void ConverterCaixa(const char *Entrada, char *Saida, size_t Tamanho, char Inicio, char Fim)
+{
+	size_t i = 0;
+#if defined(FRIENDS_AVX2)
+	const __m256i a32 = _mm256_set1_epi8(Inicio - 1), z32 = _mm256_set1_epi8(Fim + 1), bit32 = _mm256_set1_epi8(0x20);
+	for(; i + 32 <= Tamanho; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)(Entrada + i));
+		__m256i m = _mm256_and_si256(_mm256_cmpgt_epi8(v, a32), _mm256_cmpgt_epi8(z32, v));
+		_mm256_storeu_si256((__m256i*)(Saida + i), _mm256_xor_si256(v, _mm256_and_si256(m, bit32)));
+	}
+#endif
+#if defined(FRIENDS_SSE2)
+	const __m128i a16 = _mm_set1_epi8(Inicio - 1), z16 = _mm_set1_epi8(Fim + 1), bit16 = _mm_set1_epi8(0x20);
+	for(; i + 16 <= Tamanho; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(Entrada + i));
+		__m128i m = _mm_and_si128(_mm_cmpgt_epi8(v, a16), _mm_cmpgt_epi8(z16, v));
+		_mm_storeu_si128((__m128i*)(Saida + i), _mm_xor_si128(v, _mm_and_si128(m, bit16)));
+	}
+#endif
+	const unsigned char faixa = (unsigned char)(Fim - Inicio);
+	for(; i < Tamanho; i++)
+	{
+		unsigned char c = Entrada[i];
+		Saida[i] = (char)(c ^ (((unsigned char)(c - Inicio) <= faixa) << 5));
+	}
+}
+
+#if defined(FRIENDS_SSSE3)
+/*!
+ * \brief Tabela de compactao de 8 bytes: para cada mscara de bytes removidos, os ndices dos bytes mantidos ( esquerda) e quantos so.
+ */
+struct TTabelaCompactacao
+{
+	unsigned char Indices[256][8];  /*!< ndices dos bytes mantidos, em ordem (o restante  zero). */
+	unsigned char Mantidos[256];    /*!< Nmero de bytes mantidos. */
+	constexpr TTabelaCompactacao() : Indices(), Mantidos()
+	{
+		for(int m = 0; m < 256; m++)
+		{
+			int n = 0;
+			for(int k = 0; k < 8; k++)  if(!(m & (1 << k))) Indices[m][n++] = (unsigned char)k;
+			Mantidos[m] = (unsigned char)n;
+		}
+	}
+};
+static constexpr TTabelaCompactacao TabelaCompactacao;
+#endif
+
+/*!
+ * \brief Copiar um texto de Entrada para Saida sem um dado caractere (compactao).
+ *
+ * Com SSSE3, cada bloco de 16 bytes  compactado por pshufb: a mscara do caractere em cada metade
+ * de 8 bytes indexa uma tabela de 256 embaralhamentos, e as duas metades so gravadas uma aps a
+ * outra; blocos sem o caractere so copiados inteiros. Com AVX2, a deteco e a cpia inteira so
+ * feitas em 32 bytes, e os demais blocos so compactados em duas partes de 16 bytes. Sem SSSE3
+ * (s SSE2), apenas os blocos sem o caractere so acelerados. O restante, e a cauda,  copiado
+ * sem desvios, avanando a sada apenas quando o caractere  mantido.
+ *
+ * \param Entrada    Texto de entrada.
+ * \param Saida      Buffer de sada com, pelo menos, Tamanho bytes (pode ser o prprio Entrada).
+ * \param Tamanho    Nmero de bytes da entrada.
+ * \param Caractere  Caractere a ser removido.
+ * \return Nmero de bytes escritos na sada.
+ */
+static size_t RemoverCaractere(const char *Entrada, char *Saida, size_t Tamanho, char Caractere)
+{
+	size_t i = 0, j = 0;
+	// as gravaes comeam em j <= i e terminam no bloco lido, sem alcanar bytes ainda no lidos
+#if defined(FRIENDS_SSSE3)
+	const __m128i oito = _mm_set_epi64x(0x0808080808080808LL, 0);
+#endif
+#if defined(FRIENDS_AVX2)
+	const __m256i alvo32 = _mm256_set1_epi8(Caractere);
+	for(; i + 32 <= Tamanho; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)(Entrada + i));
+		unsigned int m = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, alvo32));
+		if(m == 0)
+		{
+			_mm256_storeu_si256((__m256i*)(Saida + j), v);
+			j += 32;
+			continue;
+		}
+		for(int h = 0; h < 2; h++, m >>= 16)  // cada metade de 16 bytes como no caso SSSE3
+		{
+			__m128i metade = h ? _mm256_extracti128_si256(v, 1) : _mm256_castsi256_si128(v);
+			unsigned int m0 = m & 0xFF, m1 = (m >> 8) & 0xFF;
+			__m128i indices = _mm_add_epi8(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)TabelaCompactacao.Indices[m0]), _mm_loadl_epi64((const __m128i*)TabelaCompactacao.Indices[m1])), oito);
+			__m128i c = _mm_shuffle_epi8(metade, indices);
+			_mm_storel_epi64((__m128i*)(Saida + j), c);
+			j += TabelaCompactacao.Mantidos[m0];
+			_mm_storel_epi64((__m128i*)(Saida + j), _mm_srli_si128(c, 8));
+			j += TabelaCompactacao.Mantidos[m1];
+		}
+	}
+#endif
+#if defined(FRIENDS_SSSE3)
+	const __m128i alvo = _mm_set1_epi8(Caractere);
+	for(; i + 16 <= Tamanho; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(Entrada + i));
+		unsigned int m = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, alvo));
+		if(m == 0)
+		{
+			_mm_storeu_si128((__m128i*)(Saida + j), v);
+			j += 16;
+			continue;
+		}
+		unsigned int m0 = m & 0xFF, m1 = m >> 8;
+		__m128i indices = _mm_add_epi8(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)TabelaCompactacao.Indices[m0]), _mm_loadl_epi64((const __m128i*)TabelaCompactacao.Indices[m1])), oito);
+		__m128i c = _mm_shuffle_epi8(v, indices);
+		_mm_storel_epi64((__m128i*)(Saida + j), c);
+		j += TabelaCompactacao.Mantidos[m0];
+		_mm_storel_epi64((__m128i*)(Saida + j), _mm_srli_si128(c, 8));
+		j += TabelaCompactacao.Mantidos[m1];
+	}
+#elif defined(FRIENDS_SSE2)
+	const __m128i alvo = _mm_set1_epi8(Caractere);
+	char bloco[16];
+	for(; i + 16 <= Tamanho; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(Entrada + i));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(v, alvo)) == 0)
+		{
+			_mm_storeu_si128((__m128i*)(Saida + j), v);
+			j += 16;
+			continue;
+		}
+		_mm_storeu_si128((__m128i*)bloco, v);
+		for(int k = 0; k < 16; k++)
+		{
+			Saida[j] = bloco[k];
+			j += (bloco[k] != Caractere);
+		}
+	}
+#endif
+	for(; i < Tamanho; i++)
+	{
+		char c = Entrada[i];
+		Saida[j] = c;
+		j += (c != Caractere);
+	}
+	return j;
+}
+
+/*!
+ * \brief Remover todos os espaos de uma string, no prprio objeto (sem alocao).
+ * \param  Texto String da qual os espaos sero removidos.
+ */
+void RemoverEspacos(std::string &Texto)
+{
+	if(Texto.empty()) return;
+	Texto.resize(RemoverCaractere(&Texto[0], &Texto[0], Texto.size(), ' '));
 }
 
+/*!
+ * \brief Copiar um texto sem os espaos para um buffer do chamador (sem alocao).
+ * \param  Entrada  Texto de entrada.
+ * \param  Saida    Buffer de sada com, pelo menos, Entrada.size() bytes.
+ * \return Nmero de bytes escritos na sada.
+ */
+size_t RemoverEspacos(std::string_view Entrada, char *Saida)
+{
+	return RemoverCaractere(Entrada.data(), Saida, Entrada.size(), ' ');
+}
 
 /*!
  * \brief Remover todos os espaos de uma expresso string.
@@ -237,42 +978,139 @@ double MediaMovel(const std::vector<double> &Valores, int Largura)
 std::string RemoverEspacos (const char* Expressao)
 {
 	std::string texto = Expressao;
-	size_t found = texto.find(' ');
-	while (found != std::string::npos)
-	{
-		texto.erase(found,1);
-		found = texto.find(' ');
-	}
+	RemoverEspacos(texto);
 	return texto;
 }
 
 /*!
- * \brief Converte os caracteres de uma string em maisculas.
+ * \brief Obter o trecho de um texto sem os caracteres de espaamento (espao, \t, \r e \n) das duas pontas, sem cpia.
+ * \param  Texto  Texto a ser aparado.
+ * \return Viso do trecho aparado dentro do prprio texto.
+ */
+std::string_view TrimView(std::string_view Texto)
+{
+	size_t inicio = 0, fim = Texto.size();
+	while(inicio < fim && (Texto[inicio] == ' ' || Texto[inicio] == '\t' || Texto[inicio] == '\r' || Texto[inicio] == '\n'))  inicio++;
+	while(fim > inicio && (Texto[fim-1] == ' ' || Texto[fim-1] == '\t' || Texto[fim-1] == '\r' || Texto[fim-1] == '\n'))  fim--;
+	return Texto.substr(inicio, fim - inicio);
+}
+
+/*!
+ * \brief Remover os caracteres de espaamento (espao, \t, \r e \n) das duas pontas de uma expresso.
+ * \param  Expressao  Expresso a ser aparada.
+ * \return Cpia da expresso aparada (uma nica cpia).
+ */
+std::string Trim(const char* Expressao)
+{
+	return std::string(TrimView(Expressao));
+}
+
+/*!
+ * \brief Remover os caracteres de espaamento das duas pontas de uma string, no prprio objeto (sem alocao).
+ * \param  Texto  String a ser aparada.
+ */
+void Trim(std::string &Texto)
+{
+	std::string_view aparado = TrimView(Texto);
+	size_t inicio = aparado.data() - Texto.data();
+	Texto.erase(inicio + aparado.size());
+	Texto.erase(0, inicio);
+}
+
+/*!
+ * \brief Converte os caracteres ASCII de uma string em maisculas, no prprio objeto (sem alocao).
+ * \param  Texto  A string a ser convertida.
+ */
+void UCase(std::string &Texto)
+{
+	if(!Texto.empty())  ConverterCaixa(&Texto[0], &Texto[0], Texto.size(), 'a', 'z');
+}
+
+/*!
+ * \brief Converte os caracteres ASCII de um texto em maisculas, escrevendo em um buffer do chamador (sem alocao).
+ * \param  Entrada  Texto a ser convertido.
+ * \param  Saida    Buffer de sada com, pelo menos, Entrada.size() bytes.
+ */
+void UCase(std::string_view Entrada, char *Saida)
+{
+	ConverterCaixa(Entrada.data(), Saida, Entrada.size(), 'a', 'z');
+}
+
+/*!
+ * \brief Converte os caracteres de uma string em maisculas (apenas ASCII, independente do locale).
  * \param  Expressao  A string a ser convertida em maisculas.
  * \return Retorna a string Valor com seus caracteres em masculo.
  */
 std::string UCase(const char* Expressao)
 {
 	std::string texto = Expressao;
-	for (unsigned int i = 0;i < texto.size();i++)
-	{
-		texto[i] = toupper(texto[i]);
-	}
+	UCase(texto);
 	return texto;
 }
 
 /*!
- * \brief Converte os caracteres de uma string em minsculas.
+ * \brief Converte os caracteres ASCII de uma string em minsculas, no prprio objeto (sem alocao).
+ * \param  Texto  A string a ser convertida.
+ */
+void LCase(std::string &Texto)
+{
+	if(!Texto.empty())  ConverterCaixa(&Texto[0], &Texto[0], Texto.size(), 'A', 'Z');
+}
+
+/*!
+ * \brief Converte os caracteres ASCII de um texto em minsculas, escrevendo em um buffer do chamador (sem alocao).
+ * \param  Entrada  Texto a ser convertido.
+ * \param  Saida    Buffer de sada com, pelo menos, Entrada.size() bytes.
+ */
+void LCase(std::string_view Entrada, char *Saida)
+{
+	ConverterCaixa(Entrada.data(), Saida, Entrada.size(), 'A', 'Z');
+}
+
+/*!
+ * \brief Converte os caracteres de uma string em minsculas (apenas ASCII, independente do locale).
  * \param  Expressao  A string a ser convertida em minsculas.
  * \return Retorna a string Valor com seus caracteres em minsculo.
  */
 std::string LCase(const char* Expressao)
 {
 	std::string texto = Expressao;
-	for (unsigned int i = 0;i < texto.size();i++)
+	LCase(texto);
+	return texto;
+}
+
+/*!
+ * \brief Replace occurrences of a substring (needle) in a text string (haystack), in a single forward pass.
+ *
+ * The matches are located first (non-overlapping, from left to right, never inside replaced text),
+ * so the output is allocated once with its exact size and built with block copies.
+ *
+ * \param  Haystack  Text string that will be searched for the substring.
+ * \param  Needle    Substring that will be searched (if empty, nothing is replaced).
+ * \param  Replace   Expression that will be placed in the position of the needle.
+ * \return  A copy of the text string with the needles replaced by the replacement text.
+ */
+std::string Replace(std::string_view Haystack, std::string_view Needle, std::string_view Replace)
+{
+	if(Needle.empty() || Needle == Replace) return std::string(Haystack);
+	std::vector<size_t> matches;
+	for(size_t pos = Haystack.find(Needle); pos != std::string_view::npos; pos = Haystack.find(Needle, pos + Needle.size()))
+	{
+		matches.push_back(pos);
+	}
+	if(matches.empty()) return std::string(Haystack);
+	std::string texto(Haystack.size() - matches.size() * Needle.size() + matches.size() * Replace.size(), '\0');
+	char *out = &texto[0];
+	size_t begin = 0;
+	for(size_t i = 0; i < matches.size(); i++)
 	{
-		texto[i] = tolower(texto[i]);
+		std::memcpy(out, Haystack.data() + begin, matches[i] - begin);
+		out += matches[i] - begin;
+		if(!Replace.empty()) std::memcpy(out, Replace.data(), Replace.size());
+		out += Replace.size();
+		begin = matches[i] + Needle.size();
 	}
+	std::memcpy(out, Haystack.data() + begin, Haystack.size() - begin);
 	return texto;
 }
 
@@ -285,21 +1123,86 @@ std::string LCase(const char* Expressao)
  */
 std::string Replace(const char* Haystack, const char* Needle, const char* Replace)
 {
-	std::string texto = Haystack;
-	std::string search = Needle;
-	std::string replace = Replace;
-	if(search != replace)
+	return ::Replace(std::string_view(Haystack), std::string_view(Needle), std::string_view(Replace));
+}
+
+/*!
+ * \brief Apply a whole replacement table to a text string in a single scan.
+ *
+ * A table of 256 entries lists, for each first byte, the patterns that start with it (longest
+ * first). The scan skips bytes that don't start any pattern with a table lookup, and at a candidate
+ * position the longest matching pattern wins (ties keep the order of the table). Scanning resumes
+ * after the match, so replaced text is never scanned again.
+ *
+ * \param  Haystack  Text string that will be normalized.
+ * \param  Table     Pairs of pattern and replacement (empty patterns are ignored).
+ * \return  A copy of the text string with all patterns replaced.
+ */
+std::string Replace(std::string_view Haystack, const std::vector<std::pair<std::string,std::string> > &Table)
+{
+	// candidatos por primeiro byte, do maior para o menor
+	std::vector<size_t> order;
+	for(size_t i = 0; i < Table.size(); i++)  if(!Table[i].first.empty()) order.push_back(i);
+	std::stable_sort(order.begin(), order.end(), [&Table](size_t a, size_t b) { return Table[a].first.size() > Table[b].first.size(); });
+	std::vector<std::vector<size_t> > candidates(256);
+	bool first[256] = {false};
+	for(size_t i = 0; i < order.size(); i++)
 	{
-		std::string::size_type pos = 0;
-		while( (pos = texto.find(search, pos)) != std::string::npos )
+		unsigned char c = Table[order[i]].first[0];
+		candidates[c].push_back(order[i]);
+		first[c] = true;
+	}
+	std::string texto;
+	texto.reserve(Haystack.size());
+	const char *data = Haystack.data();
+	size_t n = Haystack.size();
+	size_t begin = 0, pos = 0;
+	while(pos < n)
+	{
+		while(pos < n && !first[(unsigned char)data[pos]]) pos++;
+		if(pos == n) break;
+		const std::vector<size_t> &list = candidates[(unsigned char)data[pos]];
+		size_t found = Table.size();
+		for(size_t k = 0; k < list.size(); k++)
+		{
+			const std::string &pattern = Table[list[k]].first;
+			if(pattern.size() <= n - pos && std::memcmp(data + pos, pattern.data(), pattern.size()) == 0)
+			{
+				found = list[k];
+				break;
+			}
+		}
+		if(found == Table.size())
 		{
-			texto.replace(pos, search.size(), replace);
 			pos++;
+			continue;
 		}
+		texto.append(data + begin, pos - begin);
+		texto.append(Table[found].second);
+		pos += Table[found].first.size();
+		begin = pos;
 	}
+	texto.append(data + begin, n - begin);
 	return texto;
 }
 
+/*!
+ * \brief Dividir uma string em partes separadas por um dado caracter delimitador.
+ * \param Texto        A string da qual se deseja obter substrings.
+ * \param Delimitador  Caracter que separa as substrings dentro da string.
+ * \param Elementos    Um vetor que ir conter as strings encontradas na string dada separadas pelo delimitador dado.
+ * \return Retorna uma auto-referncia do objeto com as substrings, para aninhamento.
+ *
+ * As substrings so fatias do texto original (sem cpias), ento o texto deve existir enquanto elas forem usadas.
+ */
+std::vector<std::string_view> &Split(std::string_view Texto, char Delimitador, std::vector<std::string_view> &Elementos)
+{
+    TTokenizer::Split(Texto, Delimitador, Elementos);
+    // mesmo comportamento do getline: um delimitador no final no gera uma substring vazia
+    if(!Elementos.empty() && Elementos.back().empty()) Elementos.pop_back();
+    return Elementos;
+}
+
 /*!
  * \brief Dividir uma string em partes separadas por um dado caracter delimitador.
  * \param Texto        A string da qual se deseja obter substrings.
@@ -310,9 +1213,10 @@ std::string Replace(const char* Haystack, const char* Needle, const char* Replac
 std::vector<std::string> &Split(const std::string &Texto, char Delimitador, std::vector<std::string> &Elementos)
 {
     Elementos.clear();
-    std::stringstream ss(Texto);
-    std::string item;
-    while(std::getline(ss, item, Delimitador))  Elementos.push_back(item);
+    TTokenizer tokenizer(Texto, Delimitador);
+    std::string_view item;
+    while(tokenizer.Next(item))  Elementos.emplace_back(item);
+    if(!Elementos.empty() && Elementos.back().empty()) Elementos.pop_back();
     return Elementos;
 }
 
@@ -324,29 +1228,119 @@ std::vector<std::string> &Split(const std::string &Texto, char Delimitador, std:
 * da string original. Funo substitui o uso do t_str(). Com essa funo voce converte
 * o wstring (UNICODE) para o string padro.
 *
+* Por padro, cada caractere  reduzido ao seu byte menos significativo (como na verso
+* original, que usava o ctype::narrow), o que preserva o Latin-1. Com Utf8 verdadeiro, o
+* texto  convertido para UTF-8 (UTF-16 no Windows, UTF-32 nos demais), com U+FFFD no
+* lugar dos caracteres invlidos.
+*
 * \param Entrada string em UNICODE.
+* \param Utf8    Verdadeiro para converter para UTF-8, falso para manter um byte por caractere.
 * \return Retorna uma string padro std.
 */
-std::string Narrow(const std::wstring& Entrada)
+std::string Narrow(const std::wstring& Entrada, bool Utf8)
+{
+	std::string saida;
+	if(Utf8)
+	{
+		TUnicode::ToUtf8(Entrada, saida, true);
+		return saida;
+	}
+	saida.resize(Entrada.size());
+	if(!saida.empty()) TUnicode::NarrowBytes(Entrada.data(), Entrada.size(), &saida[0]);
+	return saida;
+}
+
+/*!
+* \brief Converte uma string em UTF-8 para UNICODE (operao inversa do Narrow com UTF-8).
+* \param Entrada string em UTF-8.
+* \return Retorna uma string em UNICODE, com U+FFFD no lugar das sequncias invlidas.
+*/
+std::wstring Widen(const std::string& Entrada)
+{
+	std::wstring saida;
+	TUnicode::ToWide(Entrada, saida, true);
+	return saida;
+}
+
+/*!
+ * \brief Escrever um nmero alinhado  direita em um campo de tamanho fixo, sem alocaes.
+ * \param  Valor     Nmero que se deseja formatar.
+ * \param  Tamanho   Tamanho do campo.
+ * \param  Precisao  Nmero de algarismos significativos (como no "%g"), ou zero para a menor representao exata.
+ * \param  Saida     Ponteiro para o campo, com pelo menos Tamanho caracteres (no  colocado o terminador nulo).
+ * \return  Retorna verdadeiro se o nmero coube no campo, e falso se o campo foi preenchido com "*".
+ *
+ * Se o nmero no couber com a preciso pedida, so tentadas a menor representao exata e depois
+ * precises menores, at que caiba no campo.
+ */
+static bool FormatarCEPEL(double Valor, int Tamanho, int Precisao, char *Saida)
 {
-	std::ostringstream stm;
-	const std::ctype<char>& ctfacet = std::use_facet< std::ctype<char> >( stm.getloc() );
-	for( std::size_t i=0 ; i< Entrada.size() ; ++i )  stm << ctfacet.narrow( Entrada[i], 0 ) ;
-	return stm.str() ;
+	char buf[64];
+	char *fim = NULL;
+	if(Precisao > 0) fim = std::to_chars(buf, buf + sizeof(buf), Valor, std::chars_format::general, Precisao).ptr;
+	if(fim == NULL || fim - buf > Tamanho) fim = std::to_chars(buf, buf + sizeof(buf), Valor).ptr;
+	for(int p = (Precisao > 0 && Precisao <= 17 ? Precisao : 17) - 1; p > 0 && fim - buf > Tamanho; p--)
+	{
+		fim = std::to_chars(buf, buf + sizeof(buf), Valor, std::chars_format::general, p).ptr;
+	}
+	int n = (int)(fim - buf);
+	if(n > Tamanho)
+	{
+		std::memset(Saida, '*', Tamanho);
+		return false;
+	}
+	std::memset(Saida, ' ', Tamanho - n);
+	std::memcpy(Saida + Tamanho - n, buf, n);
+	return true;
 }
 
 /*!
  * \brief Formata um nmero para um certo espao determinado.
- * \param  Valor    Nmero que se deseja formatar.
- * \param  Tamanho  Tamanho mximo do texto com o nmero formatado.
- * \return  Retorna um texto com o nmero colocado dentro do tamanho determinado.
+ * \param  Valor     Nmero que se deseja formatar.
+ * \param  Tamanho   Tamanho mximo do texto com o nmero formatado.
+ * \param  Precisao  Nmero de algarismos significativos (como no "%g"), ou zero para a menor representao exata.
+ * \return  Retorna um texto com o nmero colocado dentro do tamanho determinado (preenchido com "*" se no couber).
  */
-std::string NumeroCEPEL(double Valor, int Tamanho)
+std::string NumeroCEPEL(double Valor, int Tamanho, int Precisao)
 {
-    char buf[Tamanho+1];
-    std::sprintf(buf,"%*g",Tamanho,Valor);
-    return buf;
+    if(Tamanho <= 0) return "";
+    std::string texto(Tamanho, ' ');
+    FormatarCEPEL(Valor, Tamanho, Precisao, &texto[0]);
+    return texto;
+}
+
+/*!
+ * \brief Formata uma coluna de nmeros em campos consecutivos de tamanho fixo, em um buffer j alocado.
+ * \param  Valores   Nmeros que se deseja formatar.
+ * \param  Tamanho   Tamanho de cada campo.
+ * \param  Saida     Ponteiro para o buffer, com pelo menos Valores.size()*Tamanho caracteres (no  colocado o terminador nulo).
+ * \param  Precisao  Nmero de algarismos significativos (como no "%g"), ou zero para a menor representao exata.
+ * \return  Retorna o nmero de valores que no couberam no campo (preenchidos com "*").
+ */
+size_t NumerosCEPEL(const std::vector<double> &Valores, int Tamanho, char *Saida, int Precisao)
+{
+    size_t erros = 0;
+    if(Tamanho <= 0) return Valores.size();
+    for(size_t i = 0; i < Valores.size(); i++)
+    {
+        if(!FormatarCEPEL(Valores[i], Tamanho, Precisao, Saida + i*Tamanho)) erros++;
+    }
+    return erros;
+}
 
+/*!
+ * \brief Formata uma coluna de nmeros em campos consecutivos de tamanho fixo.
+ * \param  Valores   Nmeros que se deseja formatar.
+ * \param  Tamanho   Tamanho de cada campo.
+ * \param  Saida     Texto que ir receber os campos ( redimensionado uma nica vez).
+ * \param  Precisao  Nmero de algarismos significativos (como no "%g"), ou zero para a menor representao exata.
+ * \return  Retorna uma auto-referncia do texto, para aninhamento.
+ */
+std::string &NumerosCEPEL(const std::vector<double> &Valores, int Tamanho, std::string &Saida, int Precisao)
+{
+    Saida.resize(Tamanho > 0 ? Valores.size()*Tamanho : 0);
+    if(!Saida.empty()) NumerosCEPEL(Valores, Tamanho, &Saida[0], Precisao);
+    return Saida;
 }
 
 //-----------------------------------------------------------------------------
@@ -366,98 +1360,35 @@ std::string NomeMes(int Mes, bool Abreviado)
 	return std::string(meses[Mes-1]);
 }
 
-/*! Caracteres vlidos na codificao em base 64 (RFC 989). */
-static const std::string Base64_Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-/*!
- * \brief Identifica se um dado caracter  vlido para a RFC 989; escrito por Ren Nyffenegger (rene.nyffenegger@adp-gmbh.ch).
- * \param Char  Caractere que se deseja validar como alfanumrico, "/" ou "+".
- * \param Retorna verdadeiro se o caracter  alfanumrico, "/" ou "+", e falso caso contrrio.
- */
-static bool IsBase64(char Char)
-{
-	return (isalnum(Char) || (Char == '+') || (Char == '/'));
-}
-
 /*!
- * \brief Codificar um texto em base 64 (RCF 989).
+ * \brief Codificar um texto em base 64 (RFC 4648, antiga RFC 989).
  * \param BytesToEncode  Vetor de caracteres que sero codificados.
  * \param Len  Nmero de bytes do vetor de caracteres que ser codificado.
- * \return Retorna o nmero de bytes do vetor de caracteres codificado em base 64.
+ * \return Retorna o texto codificado em base 64.
  */
 std::string Base64_Encode(const char* BytesToEncode, unsigned int Len)
 {
-	std::string ret;
-	int i = 0;
-	int j = 0;
-	char char_array_3[3];
-	char char_array_4[4];
-	while(Len--)
-	{
-		char_array_3[i++] = *(BytesToEncode++);
-		if(i == 3)
-		{
-			char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-			char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-			char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-			char_array_4[3] = char_array_3[2] & 0x3f;
-			for(i = 0; (i <4) ; i++)  ret += Base64_Chars[char_array_4[i]];
-			i = 0;
-		}
-	}
-	if(i)
-	{
-		for(j = i; j < 3; j++)
-		char_array_3[j] = '\0';
-		char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-		char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-		char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-		char_array_4[3] = char_array_3[2] & 0x3f;
-		for (j = 0; (j < i + 1); j++)  ret += Base64_Chars[char_array_4[j]];
-		while((i++ < 3))  ret += '=';
-	}
-	return ret;
+	static const TBase64 codec;
+	return codec.Encode(BytesToEncode, Len);
 }
 
 /*!
- * \brief Decodificar um texto em base 64 (RCF 989) para o formato ANSI (C++).
+ * \brief Decodificar um texto em base 64 (RFC 4648, antiga RFC 989) para o formato ANSI (C++).
  * \param EncodedString  Texto em base 64 a ser decodificado para o formato ANSI do C++.
- * \return Retorna o texto decodificado de base 64 para o formato ANSI do C++.
+ * \return Retorna o texto decodificado de base 64 para o formato ANSI do C++ (a decodificao para no primeiro caractere invlido ou de preenchimento).
  */
 std::string Base64_Decode(std::string const& EncodedString)
 {
-	size_t in_len = EncodedString.size();
-	int i = 0;
-	int j = 0;
-	int in_ = 0;
-	char char_array_4[4], char_array_3[3];
+	static const TBase64 codec;
 	std::string ret;
-	while(in_len-- && ( EncodedString[in_] != '=') && IsBase64(EncodedString[in_]))
-	{
-		char_array_4[i++] = EncodedString[in_]; in_++;
-		if(i ==4)
-		{
-			for(i = 0; i < 4; i++)  char_array_4[i] = Base64_Chars.find(char_array_4[i]);
-			char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-			char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-			char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-			for (i = 0; (i < 3); i++)
-			ret += char_array_3[i];
-			i = 0;
-		}
-	}
-	if (i)
-	{
-		for (j = i; j <4; j++)  char_array_4[j] = 0;
-		for (j = 0; j <4; j++)  char_array_4[j] = Base64_Chars.find(char_array_4[j]);
-		char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-		char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-		char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-		for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
-	}
+	codec.Decode(EncodedString, ret);
 	return ret;
 }
 
+/*! Potncias de dez representadas exatamente em double. */
+static const double PotenciasDez[23] = { 1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7, 1E8, 1E9, 1E10, 1E11,
+                                         1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22 };
+
 /*!
  * \brief Arredonda um dado valor de forma euclidiana para um dado nmero de casas decimais.
  * \param Valor    Valor a ser arredondado.
@@ -466,13 +1397,40 @@ std::string Base64_Decode(std::string const& EncodedString)
  */
 double ArredondaValor(const double &Valor, const unsigned int &Digitos)
 {
-    double v = Valor;
-    long int f = 1; for(unsigned int i = 0; i < Digitos; i++) f *= 10;
-	double t = Valor*f - std::floor(Valor*f);
-	v *= f;
-	v = (t >= 0.5) ? std::ceil(v) : std::floor(v);
-	v /= f;
-    return v;
+    double f = (Digitos < 23) ? PotenciasDez[Digitos] : std::pow(10.0, (double)Digitos);
+    double v = Valor*f;
+    double b = std::floor(v);
+    // meio para cima: igual a ceil(v) quando a parte fracionria  pelo menos 0,5
+    return ((v - b >= 0.5) ? b + 1 : b)/f;
+}
+
+/*!
+ * \brief Arredonda um vetor de valores de forma euclidiana para um dado nmero de casas decimais (mesmo resultado de ArredondaValor).
+ * \param Valores  Valores a serem arredondados (so substitudos pelos valores arredondados).
+ * \param Digitos  Nmero de digitos para o arredondamento.
+ */
+void ArredondaValores(std::vector<double> &Valores, unsigned int Digitos)
+{
+    double f = (Digitos < 23) ? PotenciasDez[Digitos] : std::pow(10.0, (double)Digitos);
+    double *p = Valores.data();
+    size_t n = Valores.size(), i = 0;
+#if defined(FRIENDS_AVX2)
+    __m256d vf = _mm256_set1_pd(f), meio = _mm256_set1_pd(0.5), um = _mm256_set1_pd(1.0);
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d v = _mm256_mul_pd(_mm256_loadu_pd(p + i), vf);
+        __m256d b = _mm256_floor_pd(v);
+        __m256d acima = _mm256_cmp_pd(_mm256_sub_pd(v, b), meio, _CMP_GE_OQ);
+        b = _mm256_add_pd(b, _mm256_and_pd(acima, um));
+        _mm256_storeu_pd(p + i, _mm256_div_pd(b, vf));
+    }
+#endif
+    for(; i < n; i++)
+    {
+        double v = p[i]*f;
+        double b = std::floor(v);
+        p[i] = ((v - b >= 0.5) ? b + 1 : b)/f;
+    }
 }
 
 
@@ -1,9 +1,11 @@
+#ifndef FriendsH
 #define FriendsH
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
-
-#include "TDataHora.h"
+#include <string_view>
 
 //---------------------------------------------------------------------------
 
@@ -50,32 +52,50 @@ template <class Type> Type Max(Type x, Type y)
 
 // Funes de estatstica e probabilidade.
 double Media(const std::vector<double> &Valores);
-double Moda(const std::vector<double> &Valores);
+double Moda(const std::vector<double> &Valores, unsigned int Threads = 0);
+double ModaDiscreta(const std::vector<double> &Valores, double Resolucao = 0, unsigned int Threads = 0);
 double DesvioPadrao(const std::vector<double> &Valores);
 double AbcissaFreqAcumulada(double* Vetor, const unsigned int NPonto, const double P);
 double AbcissaFreqAcumulada(const std::vector<double> &Vetor, const double P);
 void Histograma(const std::vector<double> &Amostras, std::vector<double> &Frequencias, bool FreqRelativa = true);
 double Percentil(const std::vector<double> &Vetor, const double P);
+void Percentis(const std::vector<double> &Amostras, const std::vector<double> &P, std::vector<double> &Valores);
 bool AjustePolinomioMMQ(const std::vector<double> &Xi, const std::vector<double> &Yi, double *Coeficientes, int OrdemMax);
+bool AjustePolinomioMMQ(const std::vector<double> &Xi, const std::vector<std::vector<double> > &Yi, std::vector<std::vector<double> > &Coeficientes, int OrdemMax);
 void Binomio(int ValorMax, int NumCasas, std::vector<std::vector<int> > &Combinacoes);
 double TendenciaLinear(const std::vector<double> &Valores);
 double MediaMovel(const std::vector<double> &Valores, int Largura);
 
 // Funes de apoio de programao relativos ao uso de strings.
 std::string RemoverEspacos(const char* Expressao);
+void RemoverEspacos(std::string &Texto);
+size_t RemoverEspacos(std::string_view Entrada, char *Saida);
 std::string Trim(const char* Expressao);
+void Trim(std::string &Texto);
+std::string_view TrimView(std::string_view Texto);
 std::string UCase(const char* Expressao);
+void UCase(std::string &Texto);
+void UCase(std::string_view Entrada, char *Saida);
 std::string LCase(const char* Expressao);
+void LCase(std::string &Texto);
+void LCase(std::string_view Entrada, char *Saida);
 std::string Replace(const char* Expressao, const char* Busca, const char* Substitui);
+std::string Replace(std::string_view Expressao, std::string_view Busca, std::string_view Substitui);
+std::string Replace(std::string_view Expressao, const std::vector<std::pair<std::string,std::string> > &Tabela);
+std::vector<std::string_view> &Split(std::string_view Texto, char Delimitador, std::vector<std::string_view> &Elementos);
 std::vector<std::string> &Split(const std::string &Texto, char Delimitador, std::vector<std::string> &Elementos);
-std::string Narrow(const std::wstring& Entrada);
-std::string NumeroCEPEL(double Valor, int Tamanho);
+std::string Narrow(const std::wstring& Entrada, bool Utf8 = false);
+std::wstring Widen(const std::string& Entrada);
+std::string NumeroCEPEL(double Valor, int Tamanho, int Precisao = 6);
+size_t NumerosCEPEL(const std::vector<double> &Valores, int Tamanho, char *Saida, int Precisao = 6);
+std::string &NumerosCEPEL(const std::vector<double> &Valores, int Tamanho, std::string &Saida, int Precisao = 6);
 
 // Funes de apoio diversas.
 std::string NomeMes(int Mes, bool Abreviado);
 std::string Base64_Encode(char const* BytesToEncode, unsigned int Len);
 std::string Base64_Decode(std::string const& EncodedString);
 double ArredondaValor(const double &Valor, const unsigned int &Digitos = 2);
+void ArredondaValores(std::vector<double> &Valores, unsigned int Digitos = 2);
 
 //-----------------------------------------------------------------------------
 
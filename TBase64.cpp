@@ -0,0 +1,536 @@
+
+#include <cstring>
+
+#include "TBase64.h"
+
+// vector kernels, selected at compilation (the table-driven version is always available)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TBASE64_AVX2
+#define TBASE64_SSSE3
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define TBASE64_SSSE3
+#endif
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Constructor.
+ * \param CodecAlphabet Alphabet used to encode and decode.
+ * \param CodecPadding True if the encoded text is padded with "=" (in the strict mode, padding is then required when decoding).
+ * \param CodecStrict True if decoding must validate the whole input.
+ */
+TBase64::TBase64(EAlphabet CodecAlphabet, bool CodecPadding, bool CodecStrict)
+{
+	Alphabet = CodecAlphabet;
+	Padding = CodecPadding;
+	Strict = CodecStrict;
+	const char *chars = (Alphabet == b64UrlSafe) ? "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+	                                             : "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::memcpy(Symbols, chars, 64);
+	std::memset(Values, 0xFF, sizeof(Values));
+	for(unsigned int i = 0; i < 64; i++) Values[(unsigned char)Symbols[i]] = (unsigned char)i;
+	Reset();
+}
+
+/*!
+ * \brief Destructor (no pointers here, so nothing to declare).
+ */
+TBase64::~TBase64()
+{
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Exact size of the encoded text.
+ * \param Len Number of bytes to be encoded.
+ * \return Number of characters of the encoded text.
+ */
+std::size_t TBase64::EncodedSize(std::size_t Len) const
+{
+	std::size_t groups = Len / 3, rest = Len % 3;
+	if(rest == 0) return groups * 4;
+	return groups * 4 + (Padding ? 4 : rest + 1);
+}
+
+/*!
+ * \brief Maximum size of the decoded data (exact for valid input without padding or garbage).
+ * \param Len Number of characters to be decoded.
+ * \return Maximum number of decoded bytes.
+ */
+std::size_t TBase64::DecodedSize(std::size_t Len)
+{
+	std::size_t rest = Len % 4;
+	return (Len / 4) * 3 + (rest > 1 ? rest - 1 : 0);
+}
+
+//---------------------------------------------------------------------------
+
+#if defined(TBASE64_SSSE3)
+/*!
+ * \brief Split 12 bytes (in the 16 bytes of a register) into 16 values of 6 bits.
+ * \param In Register with the bytes.
+ * \return Register with the values, one per byte.
+ */
+static inline __m128i SplitSextets(__m128i In)
+{
+	In = _mm_shuffle_epi8(In, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	__m128i t0 = _mm_mulhi_epu16(_mm_and_si128(In, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+	__m128i t1 = _mm_mullo_epi16(_mm_and_si128(In, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t0, t1);
+}
+
+/*!
+ * \brief Translate 16 values of 6 bits into their characters.
+ * \param Sextets Register with the values.
+ * \param Shifts Offsets for each range of values (see the constructor of the lookup in EncodeGroups).
+ * \return Register with the characters.
+ */
+static inline __m128i SextetsToChars(__m128i Sextets, __m128i Shifts)
+{
+	// range index: 13 for A-Z, 0 for a-z, 1 to 10 for the digits, 11 and 12 for the last two symbols
+	__m128i index = _mm_subs_epu8(Sextets, _mm_set1_epi8(51));
+	__m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), Sextets);
+	index = _mm_or_si128(index, _mm_and_si128(upper, _mm_set1_epi8(13)));
+	return _mm_add_epi8(Sextets, _mm_shuffle_epi8(Shifts, index));
+}
+
+/*!
+ * \brief Translate 16 characters into their values of 6 bits.
+ * \param Chars Register with the characters.
+ * \param C62 Character of the value 62.
+ * \param C63 Character of the value 63.
+ * \param Values Register that will receive the values.
+ * \return True if all characters are in the alphabet.
+ */
+static inline bool CharsToSextets(__m128i Chars, char C62, char C63, __m128i &Values)
+{
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(Chars, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), Chars));
+	__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(Chars, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), Chars));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(Chars, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), Chars));
+	__m128i s62 = _mm_cmpeq_epi8(Chars, _mm_set1_epi8(C62));
+	__m128i s63 = _mm_cmpeq_epi8(Chars, _mm_set1_epi8(C63));
+	__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(s62, s63)));
+	if(_mm_movemask_epi8(valid) != 0xFFFF) return false;
+	__m128i shift = _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+	shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+	shift = _mm_or_si128(shift, _mm_and_si128(s62, _mm_set1_epi8((char)(62 - C62))));
+	shift = _mm_or_si128(shift, _mm_and_si128(s63, _mm_set1_epi8((char)(63 - C63))));
+	Values = _mm_add_epi8(Chars, shift);
+	return true;
+}
+
+/*!
+ * \brief Pack 16 values of 6 bits into 12 bytes (at the start of the register).
+ * \param Values Register with the values.
+ * \return Register with the bytes.
+ */
+static inline __m128i PackSextets(__m128i Values)
+{
+	__m128i pairs = _mm_maddubs_epi16(Values, _mm_set1_epi32(0x01400140));
+	__m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+	return _mm_shuffle_epi8(words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+#endif
+
+#if defined(TBASE64_AVX2)
+/*!
+ * \brief AVX2 version of SplitSextets (24 bytes, 12 in each lane).
+ */
+static inline __m256i SplitSextets256(__m256i In)
+{
+	In = _mm256_shuffle_epi8(In, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+	                                             10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	__m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(In, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+	__m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(In, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+	return _mm256_or_si256(t0, t1);
+}
+
+/*!
+ * \brief AVX2 version of SextetsToChars.
+ */
+static inline __m256i SextetsToChars256(__m256i Sextets, __m256i Shifts)
+{
+	__m256i index = _mm256_subs_epu8(Sextets, _mm256_set1_epi8(51));
+	__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), Sextets);
+	index = _mm256_or_si256(index, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+	return _mm256_add_epi8(Sextets, _mm256_shuffle_epi8(Shifts, index));
+}
+
+/*!
+ * \brief AVX2 version of CharsToSextets.
+ */
+static inline bool CharsToSextets256(__m256i Chars, char C62, char C63, __m256i &Values)
+{
+	__m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(Chars, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), Chars));
+	__m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(Chars, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), Chars));
+	__m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(Chars, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), Chars));
+	__m256i s62 = _mm256_cmpeq_epi8(Chars, _mm256_set1_epi8(C62));
+	__m256i s63 = _mm256_cmpeq_epi8(Chars, _mm256_set1_epi8(C63));
+	__m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(s62, s63)));
+	if(_mm256_movemask_epi8(valid) != -1) return false;
+	__m256i shift = _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')), _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(s62, _mm256_set1_epi8((char)(62 - C62))));
+	shift = _mm256_or_si256(shift, _mm256_and_si256(s63, _mm256_set1_epi8((char)(63 - C63))));
+	Values = _mm256_add_epi8(Chars, shift);
+	return true;
+}
+
+/*!
+ * \brief AVX2 version of PackSextets (24 bytes, at the start of the register).
+ */
+static inline __m256i PackSextets256(__m256i Values)
+{
+	__m256i pairs = _mm256_maddubs_epi16(Values, _mm256_set1_epi32(0x01400140));
+	__m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+	words = _mm256_shuffle_epi8(words, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+	                                                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	return _mm256_permutevar8x32_epi32(words, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+#endif
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Encode complete groups of 3 bytes.
+ * \param In Bytes to be encoded.
+ * \param Groups Number of groups of 3 bytes.
+ * \param Out Buffer that will receive 4 characters per group.
+ * \return Number of characters written.
+ */
+std::size_t TBase64::EncodeGroups(const unsigned char *In, std::size_t Groups, char *Out) const
+{
+	std::size_t len = Groups * 3, i = 0, o = 0;
+#if defined(TBASE64_SSSE3)
+	// offsets added to each range of values (see SextetsToChars)
+	__m128i shifts = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	                               '0' - 52, (char)(Symbols[62] - 62), (char)(Symbols[63] - 63), 'A', 0, 0);
+#if defined(TBASE64_AVX2)
+	__m256i shifts256 = _mm256_broadcastsi128_si256(shifts);
+	for(; i + 28 <= len; i += 24, o += 32)
+	{
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(In + i))),
+		                                     _mm_loadu_si128((const __m128i*)(In + i + 12)), 1);
+		_mm256_storeu_si256((__m256i*)(Out + o), SextetsToChars256(SplitSextets256(in), shifts256));
+	}
+#endif
+	for(; i + 16 <= len; i += 12, o += 16)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i*)(In + i));
+		_mm_storeu_si128((__m128i*)(Out + o), SextetsToChars(SplitSextets(in), shifts));
+	}
+#endif
+	for(; i < len; i += 3, o += 4)
+	{
+		unsigned int v = ((unsigned int)In[i] << 16) | ((unsigned int)In[i + 1] << 8) | In[i + 2];
+		Out[o] = Symbols[v >> 18];
+		Out[o + 1] = Symbols[(v >> 12) & 0x3F];
+		Out[o + 2] = Symbols[(v >> 6) & 0x3F];
+		Out[o + 3] = Symbols[v & 0x3F];
+	}
+	return o;
+}
+
+/*!
+ * \brief Encode the last 1 or 2 bytes, with padding if required.
+ * \param In Bytes to be encoded.
+ * \param Len Number of bytes (0 to 2).
+ * \param Out Buffer that will receive up to 4 characters.
+ * \return Number of characters written.
+ */
+std::size_t TBase64::EncodeTail(const unsigned char *In, std::size_t Len, char *Out) const
+{
+	if(Len == 0) return 0;
+	unsigned int v = (unsigned int)In[0] << 16;
+	if(Len > 1) v |= (unsigned int)In[1] << 8;
+	std::size_t o = 0;
+	Out[o++] = Symbols[v >> 18];
+	Out[o++] = Symbols[(v >> 12) & 0x3F];
+	if(Len > 1) Out[o++] = Symbols[(v >> 6) & 0x3F];
+	if(Padding)
+	{
+		while(o < 4) Out[o++] = '=';
+	}
+	return o;
+}
+
+/*!
+ * \brief Decode complete groups of 4 characters, stopping at the first group with characters outside the alphabet.
+ * \param In Characters to be decoded.
+ * \param Len Number of characters.
+ * \param Out Buffer that will receive 3 bytes per group.
+ * \param Used Reference that will receive the number of characters decoded (a multiple of 4).
+ * \return Number of bytes written.
+ */
+std::size_t TBase64::DecodeGroups(const char *In, std::size_t Len, unsigned char *Out, std::size_t &Used) const
+{
+	std::size_t i = 0, o = 0;
+#if defined(TBASE64_SSSE3)
+	char c62 = Symbols[62], c63 = Symbols[63];
+#if defined(TBASE64_AVX2)
+	for(; i + 32 <= Len; i += 32, o += 24)
+	{
+		__m256i values;
+		if(!CharsToSextets256(_mm256_loadu_si256((const __m256i*)(In + i)), c62, c63, values)) break;
+		__m256i bytes = PackSextets256(values);
+		_mm_storeu_si128((__m128i*)(Out + o), _mm256_castsi256_si128(bytes));
+		_mm_storel_epi64((__m128i*)(Out + o + 16), _mm256_extracti128_si256(bytes, 1));
+	}
+#endif
+	for(; i + 16 <= Len; i += 16, o += 12)
+	{
+		__m128i values;
+		if(!CharsToSextets(_mm_loadu_si128((const __m128i*)(In + i)), c62, c63, values)) break;
+		__m128i bytes = PackSextets(values);
+		_mm_storel_epi64((__m128i*)(Out + o), bytes);
+		int last = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+		std::memcpy(Out + o + 8, &last, 4);
+	}
+#endif
+	for(; i + 4 <= Len; i += 4, o += 3)
+	{
+		unsigned int a = Values[(unsigned char)In[i]], b = Values[(unsigned char)In[i + 1]];
+		unsigned int c = Values[(unsigned char)In[i + 2]], d = Values[(unsigned char)In[i + 3]];
+		if((a | b | c | d) & 0x80) break;
+		unsigned int v = (a << 18) | (b << 12) | (c << 6) | d;
+		Out[o] = (unsigned char)(v >> 16);
+		Out[o + 1] = (unsigned char)(v >> 8);
+		Out[o + 2] = (unsigned char)v;
+	}
+	Used = i;
+	return o;
+}
+
+/*!
+ * \brief Decode a piece of text, keeping the state of the incomplete group.
+ * \param In Characters to be decoded.
+ * \param Len Number of characters.
+ * \param Out Buffer that will receive the bytes.
+ * \param Group Values of the incomplete group.
+ * \param GroupCount Number of values in Group.
+ * \param PadCount Number of padding characters found.
+ * \param AtEnd True if the end of the data was found.
+ * \param Invalid True if invalid data was found (strict mode).
+ * \return Number of bytes written.
+ */
+std::size_t TBase64::DecodeStep(const char *In, std::size_t Len, unsigned char *Out, unsigned char *Group, unsigned int &GroupCount, unsigned int &PadCount, bool &AtEnd, bool &Invalid) const
+{
+	std::size_t i = 0, o = 0;
+	while(i < Len && !Invalid)
+	{
+		if(AtEnd && !Strict) break;  // lenient: everything after the end is ignored
+		if(GroupCount == 0 && !AtEnd)
+		{
+			std::size_t used;
+			o += DecodeGroups(In + i, Len - i, Out + o, used);
+			i += used;
+			if(i >= Len) break;
+		}
+		unsigned char c = (unsigned char)In[i++];
+		unsigned char v = Values[c];
+		if(v != 0xFF && !AtEnd)
+		{
+			Group[GroupCount++] = v;
+			if(GroupCount == 4)
+			{
+				unsigned int w = ((unsigned int)Group[0] << 18) | ((unsigned int)Group[1] << 12) | ((unsigned int)Group[2] << 6) | Group[3];
+				Out[o++] = (unsigned char)(w >> 16);
+				Out[o++] = (unsigned char)(w >> 8);
+				Out[o++] = (unsigned char)w;
+				GroupCount = 0;
+			}
+		}
+		else if(c == '=' && Strict)
+		{
+			// padding only completes a group of 2 or 3 values
+			AtEnd = true;
+			PadCount++;
+			if(!Padding || GroupCount < 2 || GroupCount + PadCount > 4) Invalid = true;
+		}
+		else
+		{
+			AtEnd = true;
+			if(Strict) Invalid = true;
+		}
+	}
+	return o;
+}
+
+/*!
+ * \brief Decode the last incomplete group and validate the end of the data.
+ * \param Out Buffer that will receive up to 2 bytes.
+ * \param Written Reference that will receive the number of bytes written.
+ * \param Group Values of the incomplete group.
+ * \param GroupCount Number of values in Group.
+ * \param PadCount Number of padding characters found.
+ * \param Invalid True if invalid data was found before.
+ * \return True if the data is valid (always, in the lenient mode).
+ */
+bool TBase64::DecodeEnd(unsigned char *Out, std::size_t &Written, const unsigned char *Group, unsigned int GroupCount, unsigned int PadCount, bool Invalid) const
+{
+	Written = 0;
+	if(Strict)
+	{
+		if(Invalid || GroupCount == 1) return false;
+		if(Padding && GroupCount != 0 && GroupCount + PadCount != 4) return false;
+		if(GroupCount == 2 && (Group[1] & 0x0F) != 0) return false;
+		if(GroupCount == 3 && (Group[2] & 0x03) != 0) return false;
+	}
+	if(GroupCount >= 2) Out[Written++] = (unsigned char)((Group[0] << 2) | (Group[1] >> 4));
+	if(GroupCount == 3) Out[Written++] = (unsigned char)((Group[1] << 4) | (Group[2] >> 2));
+	return true;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Encode bytes into a caller buffer.
+ * \param In Bytes to be encoded.
+ * \param Len Number of bytes.
+ * \param Out Buffer that will receive the text, with at least EncodedSize(Len) characters (no null terminator is written).
+ * \return Number of characters written.
+ */
+std::size_t TBase64::Encode(const void *In, std::size_t Len, char *Out) const
+{
+	const unsigned char *in = (const unsigned char*)In;
+	std::size_t groups = Len / 3;
+	std::size_t o = EncodeGroups(in, groups, Out);
+	return o + EncodeTail(in + groups * 3, Len - groups * 3, Out + o);
+}
+
+/*!
+ * \brief Encode bytes into a string.
+ * \param In Bytes to be encoded.
+ * \param Len Number of bytes.
+ * \return Encoded text.
+ */
+std::string TBase64::Encode(const void *In, std::size_t Len) const
+{
+	std::string text(EncodedSize(Len), '\0');
+	if(!text.empty()) Encode(In, Len, &text[0]);
+	return text;
+}
+
+/*!
+ * \brief Decode a text into a caller buffer.
+ * \param In Text to be decoded.
+ * \param Len Number of characters.
+ * \param Out Buffer that will receive the bytes, with at least DecodedSize(Len) bytes.
+ * \param Written Reference that will receive the number of bytes written.
+ * \return True if the text is valid (always, in the lenient mode).
+ */
+bool TBase64::Decode(const char *In, std::size_t Len, void *Out, std::size_t &Written) const
+{
+	unsigned char quad[4];
+	unsigned int count = 0, pads = 0;
+	bool ended = false, failed = false;
+	unsigned char *out = (unsigned char*)Out;
+	std::size_t o = DecodeStep(In, Len, out, quad, count, pads, ended, failed);
+	std::size_t tail;
+	bool ok = DecodeEnd(out + o, tail, quad, count, pads, failed);
+	Written = o + tail;
+	return ok;
+}
+
+/*!
+ * \brief Decode a text into a string.
+ * \param In Text to be decoded.
+ * \param Out String that will receive the bytes.
+ * \return True if the text is valid (always, in the lenient mode).
+ */
+bool TBase64::Decode(std::string_view In, std::string &Out) const
+{
+	Out.resize(DecodedSize(In.size()));
+	std::size_t written = 0;
+	bool ok = Decode(In.data(), In.size(), Out.empty() ? NULL : &Out[0], written);
+	Out.resize(written);
+	return ok;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Restart the streaming encoder and decoder.
+ */
+void TBase64::Reset()
+{
+	CarryCount = 0;
+	QuadCount = 0;
+	Pads = 0;
+	Ended = false;
+	Failed = false;
+}
+
+/*!
+ * \brief Encode a chunk of a byte stream (incomplete groups are kept for the next chunk).
+ * \param In Bytes to be encoded.
+ * \param Len Number of bytes.
+ * \param Out Buffer that will receive the text, with at least EncodedSize(Len + 2) characters.
+ * \return Number of characters written.
+ */
+std::size_t TBase64::EncodeChunk(const void *In, std::size_t Len, char *Out)
+{
+	const unsigned char *in = (const unsigned char*)In;
+	std::size_t o = 0;
+	if(CarryCount > 0)
+	{
+		while(CarryCount < 3 && Len > 0)
+		{
+			if(CarryCount < 2) Carry[CarryCount] = *in;
+			else
+			{
+				unsigned char group[3] = { Carry[0], Carry[1], *in };
+				o += EncodeGroups(group, 1, Out);
+			}
+			CarryCount++;
+			in++;
+			Len--;
+		}
+		if(CarryCount < 3) return o;
+		CarryCount = 0;
+	}
+	std::size_t groups = Len / 3;
+	o += EncodeGroups(in, groups, Out + o);
+	for(std::size_t i = groups * 3; i < Len; i++) Carry[CarryCount++] = in[i];
+	return o;
+}
+
+/*!
+ * \brief Finish the encoded stream, encoding the kept bytes.
+ * \param Out Buffer that will receive up to 4 characters.
+ * \return Number of characters written.
+ */
+std::size_t TBase64::EncodeFinish(char *Out)
+{
+	std::size_t o = EncodeTail(Carry, CarryCount, Out);
+	CarryCount = 0;
+	return o;
+}
+
+/*!
+ * \brief Decode a chunk of an encoded stream (incomplete groups are kept for the next chunk).
+ * \param In Characters to be decoded.
+ * \param Len Number of characters.
+ * \param Out Buffer that will receive the bytes, with at least DecodedSize(Len + 3) bytes.
+ * \return Number of bytes written (errors of the strict mode are reported by DecodeFinish).
+ */
+std::size_t TBase64::DecodeChunk(const char *In, std::size_t Len, void *Out)
+{
+	return DecodeStep(In, Len, (unsigned char*)Out, Quad, QuadCount, Pads, Ended, Failed);
+}
+
+/*!
+ * \brief Finish the decoded stream, decoding the kept characters.
+ * \param Out Buffer that will receive up to 2 bytes.
+ * \param Written Reference that will receive the number of bytes written.
+ * \return True if the whole stream is valid (always, in the lenient mode).
+ */
+bool TBase64::DecodeFinish(void *Out, std::size_t &Written)
+{
+	bool ok = DecodeEnd((unsigned char*)Out, Written, Quad, QuadCount, Pads, Failed);
+	Reset();
+	return ok;
+}
@@ -0,0 +1,79 @@
+#ifndef TBase64H
+#define TBase64H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Table-driven and vectorized Base64 codec (RFC 4648).
+ *
+ * The bulk of the data is processed 24 or 12 bytes at a time with AVX2 or SSSE3 (selected at
+ * compilation), and the remainder by lookup tables. Outputs can be written into caller buffers
+ * sized with EncodedSize() and DecodedSize(), so no reallocation happens. Chunked input is
+ * supported by the streaming functions (EncodeChunk/EncodeFinish and DecodeChunk/DecodeFinish),
+ * which keep the partial groups between calls.
+ *
+ * In the lenient mode (the default), decoding stops at the first character outside the alphabet
+ * (usually the padding), as the original Friends functions did. In the strict mode, any invalid
+ * character, misplaced or missing padding, or non-zero trailing bits make decoding fail.
+ */
+class TBase64
+{
+public:
+	enum EAlphabet  /*!< Alphabets of the codec. */
+	{
+		b64Standard = 0,  /*!< Standard alphabet, with "+" and "/". */
+		b64UrlSafe        /*!< URL and filename safe alphabet, with "-" and "_". */
+	};
+
+private:
+	EAlphabet Alphabet;         /*!< Alphabet in use. */
+	bool Padding;               /*!< True if the encoded text is padded with "=" to a multiple of 4 characters. */
+	bool Strict;                /*!< True if decoding validates the whole input. */
+	char Symbols[64];           /*!< Characters of each 6-bit value. */
+	unsigned char Values[256];  /*!< 6-bit value of each character (0xFF if it isn't in the alphabet). */
+
+	unsigned char Carry[2];  /*!< Bytes waiting for a complete group in the streaming encoder. */
+	unsigned int CarryCount; /*!< Number of bytes in Carry. */
+	unsigned char Quad[4];   /*!< Values waiting for a complete group in the streaming decoder. */
+	unsigned int QuadCount;  /*!< Number of values in Quad. */
+	unsigned int Pads;       /*!< Number of padding characters found by the streaming decoder. */
+	bool Ended;              /*!< True if the streaming decoder found the end of the data. */
+	bool Failed;             /*!< True if the streaming decoder found invalid data (strict mode). */
+
+	// support functions
+	std::size_t EncodeGroups(const unsigned char *In, std::size_t Groups, char *Out) const;
+	std::size_t EncodeTail(const unsigned char *In, std::size_t Len, char *Out) const;
+	std::size_t DecodeGroups(const char *In, std::size_t Len, unsigned char *Out, std::size_t &Used) const;
+	std::size_t DecodeStep(const char *In, std::size_t Len, unsigned char *Out, unsigned char *Group, unsigned int &GroupCount, unsigned int &PadCount, bool &AtEnd, bool &Invalid) const;
+	bool DecodeEnd(unsigned char *Out, std::size_t &Written, const unsigned char *Group, unsigned int GroupCount, unsigned int PadCount, bool Invalid) const;
+
+public:
+	// constructors and destructor
+	TBase64(EAlphabet CodecAlphabet = b64Standard, bool CodecPadding = true, bool CodecStrict = false);
+	virtual ~TBase64();
+
+	// sizes
+	std::size_t EncodedSize(std::size_t Len) const;
+	static std::size_t DecodedSize(std::size_t Len);
+
+	// one-shot functions
+	std::size_t Encode(const void *In, std::size_t Len, char *Out) const;
+	std::string Encode(const void *In, std::size_t Len) const;
+	bool Decode(const char *In, std::size_t Len, void *Out, std::size_t &Written) const;
+	bool Decode(std::string_view In, std::string &Out) const;
+
+	// streaming functions
+	void Reset();
+	std::size_t EncodeChunk(const void *In, std::size_t Len, char *Out);
+	std::size_t EncodeFinish(char *Out);
+	std::size_t DecodeChunk(const char *In, std::size_t Len, void *Out);
+	bool DecodeFinish(void *Out, std::size_t &Written);
+};
+
+//---------------------------------------------------------------------------
+
+#endif
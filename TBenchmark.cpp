@@ -0,0 +1,427 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "TBenchmark.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Registry of the benchmarks (a function static, so it exists before the static registrations run).
+ * \return Reference to the registry.
+ */
+std::vector<TBenchmark::TEntry> &TBenchmark::GetRegistry()
+{
+	static std::vector<TEntry> registry;
+	return registry;
+}
+
+/*!
+ * \brief Register a benchmark.
+ * \param Name Name of the benchmark.
+ * \param Function Benchmark function.
+ */
+TBenchmark::TRegistration::TRegistration(const char *Name, TFunction Function)
+{
+	TEntry entry;
+	entry.Name = Name;
+	entry.Function = Function;
+	GetRegistry().push_back(entry);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Class constructor, with the default options (10 ms per sample, 100 ms of warmup and 25 samples).
+ * \param Clock Clock of the timer.
+ */
+TBenchmark::TBenchmark(TPrecisionTimer::EClock Clock) : Timer(Clock)
+{
+	Counters = NULL;
+	MinTime = 0.01;
+	WarmupTime = 0.1;
+	Repetitions = 25;
+}
+
+/*!
+ * \brief Class destructor.
+ */
+TBenchmark::~TBenchmark()
+{
+	delete Counters;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Set the minimum time of each sample (the iterations are calibrated to reach it).
+ * \param Seconds Minimum time, in seconds.
+ */
+void TBenchmark::SetMinTime(double Seconds)
+{
+	MinTime = Seconds;
+}
+
+/*!
+ * \brief Set the time spent running each benchmark before the samples.
+ * \param Seconds Warmup time, in seconds.
+ */
+void TBenchmark::SetWarmupTime(double Seconds)
+{
+	WarmupTime = Seconds;
+}
+
+/*!
+ * \brief Set the number of samples of each benchmark.
+ * \param Count Number of samples (at least 1).
+ */
+void TBenchmark::SetRepetitions(unsigned int Count)
+{
+	Repetitions = std::max(Count, 1U);
+}
+
+/*!
+ * \brief Set the filter of RunAll().
+ * \param Text Only benchmarks whose names contain the text are run (empty for all).
+ */
+void TBenchmark::SetFilter(const std::string &Text)
+{
+	Filter = Text;
+}
+
+/*!
+ * \brief Read the hardware counters with the samples (of the calling thread and the threads it creates).
+ * \param Enabled True to read them.
+ * \return False if they were enabled but no counter is available (see GetCounters()->GetError()).
+ */
+bool TBenchmark::SetCounters(bool Enabled)
+{
+	if(!Enabled)
+	{
+		delete Counters;
+		Counters = NULL;
+		return true;
+	}
+	if(Counters == NULL) Counters = new TPerfCounters(true);
+	return Counters->IsAvailable();
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Time a call of a benchmark function.
+ * \param Function Benchmark function.
+ * \param State State with the number of iterations.
+ * \param Values Where the counters of the call are added (NULL if they aren't read).
+ * \return Time of the call, in seconds, without the overhead of the timer.
+ */
+double TBenchmark::Sample(TFunction Function, TState &State, TPerfCounters::TValues *Values)
+{
+	// the counters are read outside the timed interval, since each read is a system call
+	if(Values != NULL) Counters->Start();
+	ClobberMemory();
+	Timer.Start();
+	Function(State);
+	double elapsed = Timer.Stop();
+	ClobberMemory();
+	if(Values != NULL)
+	{
+		TPerfCounters::TValues counts = Counters->Stop();
+		for(unsigned int i = 0; i < TPerfCounters::pcCounters; i++) Values->Counts[i] += counts.Counts[i];
+	}
+	return std::max(elapsed - Timer.GetOverhead(), 0.0);
+}
+
+/*!
+ * \brief Percentile of sorted samples, interpolating between the nearest ranks.
+ * \param Sorted Samples in ascending order.
+ * \param P Percentile, between 0 and 1.
+ * \return Value of the percentile.
+ */
+double TBenchmark::Percentile(const std::vector<double> &Sorted, double P)
+{
+	double rank = P * (double)(Sorted.size() - 1);
+	std::size_t low = (std::size_t)rank;
+	if(low + 1 >= Sorted.size()) return Sorted.back();
+	return Sorted[low] + (rank - (double)low) * (Sorted[low + 1] - Sorted[low]);
+}
+
+/*!
+ * \brief Run a benchmark: calibrate the iterations, warm up and take the samples.
+ * \param Name Name of the benchmark.
+ * \param Function Benchmark function.
+ * \return Reference to its result (valid until the next run).
+ */
+const TBenchmark::TResult &TBenchmark::Run(const std::string &Name, TFunction Function)
+{
+	TState state;
+	state.Iterations = 1;
+	state.Items = 0;
+	state.Bytes = 0;
+
+	// a first call, not timed, runs the one-time setup of the benchmark (static data, files, caches)
+	Function(state);
+
+	// calibration: grow the iterations until a sample takes the minimum time (this also warms up)
+	double spent = 0;
+	while(true)
+	{
+		double elapsed = Sample(Function, state);
+		spent += elapsed;
+		if(elapsed >= MinTime || state.Iterations >= ((std::size_t)1 << 40)) break;
+		double factor = (elapsed > 0) ? 1.2 * MinTime / elapsed : 100;
+		state.Iterations = (std::size_t)std::ceil((double)state.Iterations * std::min(std::max(factor, 2.0), 100.0));
+	}
+	while(spent < WarmupTime) spent += Sample(Function, state);
+
+	TPerfCounters::TValues counts;
+	for(unsigned int i = 0; i < TPerfCounters::pcCounters; i++) counts.Counts[i] = 0;
+	TPerfCounters::TValues *values = (Counters != NULL && Counters->IsAvailable()) ? &counts : NULL;
+	std::vector<double> samples(Repetitions);
+	for(std::size_t i = 0; i < samples.size(); i++) samples[i] = Sample(Function, state, values) / (double)state.Iterations;
+	std::sort(samples.begin(), samples.end());
+
+	TResult result;
+	result.Name = Name;
+	result.Iterations = state.Iterations;
+	result.Samples = samples.size();
+	result.Median = Percentile(samples, 0.5);
+	std::vector<double> deviations(samples.size());
+	for(std::size_t i = 0; i < samples.size(); i++) deviations[i] = std::fabs(samples[i] - result.Median);
+	std::sort(deviations.begin(), deviations.end());
+	result.Mad = Percentile(deviations, 0.5);
+	result.Mean = 0;
+	for(std::size_t i = 0; i < samples.size(); i++) result.Mean += samples[i];
+	result.Mean /= (double)samples.size();
+	result.Min = samples.front();
+	result.Max = samples.back();
+	result.P5 = Percentile(samples, 0.05);
+	result.P25 = Percentile(samples, 0.25);
+	result.P75 = Percentile(samples, 0.75);
+	result.P95 = Percentile(samples, 0.95);
+	result.P99 = Percentile(samples, 0.99);
+	result.Items = state.Items;
+	result.Bytes = state.Bytes;
+	double iterations = (double)samples.size() * (double)state.Iterations;
+	result.Cycles = counts.Counts[TPerfCounters::pcCycles] / iterations;
+	result.Instructions = counts.Counts[TPerfCounters::pcInstructions] / iterations;
+	result.CacheMisses = counts.Counts[TPerfCounters::pcCacheMisses] / iterations;
+	result.BranchMisses = counts.Counts[TPerfCounters::pcBranchMisses] / iterations;
+	Results.push_back(result);
+	return Results.back();
+}
+
+/*!
+ * \brief Run the registered benchmarks that pass the filter, in registration order.
+ * \param Progress Stream that receives a line per benchmark as it finishes (NULL for none).
+ * \return Number of benchmarks run.
+ */
+std::size_t TBenchmark::RunAll(std::ostream *Progress)
+{
+	std::size_t count = 0;
+	const std::vector<TEntry> &registry = GetRegistry();
+	for(std::size_t i = 0; i < registry.size(); i++)
+	{
+		if(!Filter.empty() && registry[i].Name.find(Filter) == std::string::npos) continue;
+		const TResult &result = Run(registry[i].Name, registry[i].Function);
+		if(Progress != NULL) *Progress << result.Name << ": " << result.Median * 1e9 << " ns" << std::endl;
+		count++;
+	}
+	return count;
+}
+
+/*!
+ * \brief Results of the benchmarks run.
+ * \return Reference to the results, in run order.
+ */
+const std::vector<TBenchmark::TResult> &TBenchmark::GetResults() const
+{
+	return Results;
+}
+
+/*!
+ * \brief Timer of the samples (to report its clock and overhead).
+ * \return Reference to the timer.
+ */
+const TPrecisionTimer &TBenchmark::GetTimer() const
+{
+	return Timer;
+}
+
+/*!
+ * \brief Hardware counters read with the samples (to report which are available).
+ * \return Pointer to the counters (NULL if they aren't used).
+ */
+const TPerfCounters *TBenchmark::GetCounters() const
+{
+	return Counters;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Print the results as a table, with times in nanoseconds per iteration (and a table of counters per iteration, if used).
+ * \param Output Output stream.
+ */
+void TBenchmark::Print(std::ostream &Output) const
+{
+	char line[256];
+	std::snprintf(line, sizeof(line), "%-40s %14s %10s %14s %14s %12s %12s %12s\n", "Benchmark", "Median (ns)", "MAD (%)", "P5 (ns)", "P95 (ns)", "Items/s", "MB/s", "Iterations");
+	Output << line;
+	for(std::size_t i = 0; i < Results.size(); i++)
+	{
+		const TResult &r = Results[i];
+		double mad = (r.Median > 0) ? 100 * r.Mad / r.Median : 0;
+		double items = (r.Items > 0 && r.Median > 0) ? r.Items / r.Median : 0;
+		double bytes = (r.Bytes > 0 && r.Median > 0) ? r.Bytes / r.Median / 1e6 : 0;
+		std::snprintf(line, sizeof(line), "%-40s %14.2f %10.2f %14.2f %14.2f %12.4g %12.4g %12llu\n", r.Name.c_str(), r.Median * 1e9, mad, r.P5 * 1e9, r.P95 * 1e9, items, bytes, (unsigned long long)r.Iterations);
+		Output << line;
+	}
+	Output << "Clock: " << Timer.GetClockName() << ", overhead " << Timer.GetOverhead() * 1e9 << " ns" << std::endl;
+	if(Counters == NULL) return;
+	if(!Counters->GetError().empty()) Output << "Counters: " << Counters->GetError() << std::endl;
+	if(!Counters->IsAvailable()) return;
+	if(!Counters->IsInherited()) Output << "Counters: calling thread only (worker threads of the benchmarks aren't counted)" << std::endl;
+
+	std::snprintf(line, sizeof(line), "\n%-40s %14s %14s %8s %14s %14s\n", "Benchmark", "Cycles", "Instructions", "IPC", "Cache misses", "Branch misses");
+	Output << line;
+	for(std::size_t i = 0; i < Results.size(); i++)
+	{
+		const TResult &r = Results[i];
+		double ipc = (r.Cycles > 0) ? r.Instructions / r.Cycles : 0;
+		std::snprintf(line, sizeof(line), "%-40s %14.2f %14.2f %8.3f %14.4f %14.4f\n", r.Name.c_str(), r.Cycles, r.Instructions, ipc, r.CacheMisses, r.BranchMisses);
+		Output << line;
+	}
+}
+
+/*!
+ * \brief Write the results to a JSON file.
+ * \param FileName File name (may include full pathname).
+ * \return True if the file was written.
+ */
+bool TBenchmark::WriteJson(const char *FileName) const
+{
+	std::fstream file;
+	file.open(FileName, std::fstream::out);
+	if(!file.is_open()) return false;
+	file.precision(17);
+	file << "{\n  \"context\": { \"clock\": \"" << Timer.GetClockName() << "\", \"overhead_ns\": " << Timer.GetOverhead() * 1e9
+	     << ", \"counters\": " << ((Counters != NULL && Counters->IsAvailable()) ? "true" : "false")
+	     << ", \"counters_threads\": " << ((Counters != NULL && Counters->IsInherited()) ? "true" : "false") << " },\n  \"benchmarks\": [";
+	for(std::size_t i = 0; i < Results.size(); i++)
+	{
+		const TResult &r = Results[i];
+		std::string name;
+		for(std::size_t c = 0; c < r.Name.size(); c++)
+		{
+			if(r.Name[c] == '"' || r.Name[c] == '\\') name += '\\';
+			name += r.Name[c];
+		}
+		file << ((i > 0) ? ",\n" : "\n") << "    { \"name\": \"" << name << "\", \"iterations\": " << r.Iterations << ", \"samples\": " << r.Samples
+		     << ", \"median_ns\": " << r.Median * 1e9 << ", \"mad_ns\": " << r.Mad * 1e9 << ", \"mean_ns\": " << r.Mean * 1e9
+		     << ", \"min_ns\": " << r.Min * 1e9 << ", \"max_ns\": " << r.Max * 1e9 << ", \"p5_ns\": " << r.P5 * 1e9 << ", \"p25_ns\": " << r.P25 * 1e9
+		     << ", \"p75_ns\": " << r.P75 * 1e9 << ", \"p95_ns\": " << r.P95 * 1e9 << ", \"p99_ns\": " << r.P99 * 1e9
+		     << ", \"items_per_second\": " << ((r.Items > 0 && r.Median > 0) ? r.Items / r.Median : 0)
+		     << ", \"bytes_per_second\": " << ((r.Bytes > 0 && r.Median > 0) ? r.Bytes / r.Median : 0)
+		     << ", \"cycles\": " << r.Cycles << ", \"instructions\": " << r.Instructions << ", \"ipc\": " << ((r.Cycles > 0) ? r.Instructions / r.Cycles : 0)
+		     << ", \"cache_misses\": " << r.CacheMisses << ", \"branch_misses\": " << r.BranchMisses << " }";
+	}
+	file << "\n  ]\n}\n";
+	file.close();
+	return !file.fail();
+}
+
+/*!
+ * \brief Write the results to a CSV file (one line per benchmark, times in nanoseconds).
+ * \param FileName File name (may include full pathname).
+ * \return True if the file was written.
+ */
+bool TBenchmark::WriteCsv(const char *FileName) const
+{
+	std::fstream file;
+	file.open(FileName, std::fstream::out);
+	if(!file.is_open()) return false;
+	file.precision(17);
+	file << "name,iterations,samples,median_ns,mad_ns,mean_ns,min_ns,max_ns,p5_ns,p25_ns,p75_ns,p95_ns,p99_ns,items_per_second,bytes_per_second,cycles,instructions,ipc,cache_misses,branch_misses\n";
+	for(std::size_t i = 0; i < Results.size(); i++)
+	{
+		const TResult &r = Results[i];
+		file << '"' << r.Name << "\"," << r.Iterations << ',' << r.Samples << ',' << r.Median * 1e9 << ',' << r.Mad * 1e9 << ',' << r.Mean * 1e9 << ','
+		     << r.Min * 1e9 << ',' << r.Max * 1e9 << ',' << r.P5 * 1e9 << ',' << r.P25 * 1e9 << ',' << r.P75 * 1e9 << ',' << r.P95 * 1e9 << ','
+		     << r.P99 * 1e9 << ',' << ((r.Items > 0 && r.Median > 0) ? r.Items / r.Median : 0) << ',' << ((r.Bytes > 0 && r.Median > 0) ? r.Bytes / r.Median : 0) << ','
+		     << r.Cycles << ',' << r.Instructions << ',' << ((r.Cycles > 0) ? r.Instructions / r.Cycles : 0) << ',' << r.CacheMisses << ',' << r.BranchMisses << '\n';
+	}
+	file.close();
+	return !file.fail();
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Main function of a benchmark program: run the registered benchmarks and report them.
+ * \param argc Number of arguments.
+ * \param argv Arguments: --filter=TEXT, --min-time=SECONDS, --warmup=SECONDS, --repetitions=N,
+ * --clock=steady|raw|tsc|qpc, --counters, --json=FILE, --csv=FILE and --list.
+ * \return Exit code (0 on success).
+ */
+int TBenchmark::Main(int argc, char **argv)
+{
+	TPrecisionTimer::EClock clock = TPrecisionTimer::ckDefault;
+	std::string filter, json, csv;
+	double minTime = -1, warmup = -1;
+	int repetitions = -1;
+	bool list = false, counters = false;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		std::size_t eq = arg.find('=');
+		std::string key = arg.substr(0, eq), value = (eq == std::string::npos) ? std::string() : arg.substr(eq + 1);
+		if(key == "--filter") filter = value;
+		else if(key == "--min-time") minTime = std::atof(value.c_str());
+		else if(key == "--warmup") warmup = std::atof(value.c_str());
+		else if(key == "--repetitions") repetitions = std::atoi(value.c_str());
+		else if(key == "--json") json = value;
+		else if(key == "--csv") csv = value;
+		else if(key == "--list") list = true;
+		else if(key == "--counters") counters = true;
+		else if(key == "--clock")
+		{
+			if(value == "steady") clock = TPrecisionTimer::ckSteadyClock;
+			else if(value == "raw") clock = TPrecisionTimer::ckMonotonicRaw;
+			else if(value == "tsc") clock = TPrecisionTimer::ckTsc;
+			else if(value == "qpc") clock = TPrecisionTimer::ckPerformanceCounter;
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+	if(list)
+	{
+		const std::vector<TEntry> &registry = GetRegistry();
+		for(std::size_t i = 0; i < registry.size(); i++) std::cout << registry[i].Name << std::endl;
+		return 0;
+	}
+
+	TBenchmark benchmark(clock);
+	if(minTime > 0) benchmark.SetMinTime(minTime);
+	if(warmup >= 0) benchmark.SetWarmupTime(warmup);
+	if(repetitions > 0) benchmark.SetRepetitions((unsigned int)repetitions);
+	benchmark.SetFilter(filter);
+	if(counters) benchmark.SetCounters(true);
+	benchmark.RunAll(&std::cerr);
+	benchmark.Print(std::cout);
+	if(!json.empty() && !benchmark.WriteJson(json.c_str())) std::cerr << "Couldn't write " << json << std::endl;
+	if(!csv.empty() && !benchmark.WriteCsv(csv.c_str())) std::cerr << "Couldn't write " << csv << std::endl;
+	return 0;
+}
@@ -0,0 +1,161 @@
+#ifndef TBenchmarkH
+#define TBenchmarkH
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "TPerfCounters.h"
+#include "TPrecisionTimer.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Microbenchmark harness built on TPrecisionTimer.
+ *
+ * Benchmarks are functions registered with the TBENCHMARK macro, which run their body
+ * State.Iterations times. For each one, the harness calls it once (so the setup of static data
+ * isn't timed), finds the number of iterations that takes at least the minimum time per
+ * sample, warms it up, and then takes a number of
+ * samples, reporting the time per iteration by its median, median absolute deviation (MAD)
+ * and percentiles. Results are printed as a table and can be exported to JSON or CSV.
+ *
+ * DoNotOptimize() and ClobberMemory() keep the compiler from removing the measured code:
+ * the first makes a value "used", and the second makes all memory "read and written".
+ *
+ * Optionally (SetCounters), the samples also read the hardware counters of TPerfCounters, and
+ * the results get cycles, instructions, cache misses and branch misses per iteration. The counters
+ * include the threads that the benchmarks create (e.g. the workers of Moda), unless the kernel
+ * can't inherit them, in which case the table says they cover the calling thread only.
+ */
+class TBenchmark
+{
+public:
+	struct TState  /*!< Parameters of a run, given to the benchmark function. */
+	{
+		std::size_t Iterations;  /*!< Number of times the body must run. */
+		double Items;            /*!< Items processed per iteration (set by the benchmark, for throughput). */
+		double Bytes;            /*!< Bytes processed per iteration (set by the benchmark, for throughput). */
+	};
+	typedef void (*TFunction)(TState &State);  /*!< Benchmark function. */
+
+	struct TResult  /*!< Statistics of a benchmark (times per iteration, in seconds). */
+	{
+		std::string Name;        /*!< Name of the benchmark. */
+		std::size_t Iterations;  /*!< Iterations per sample. */
+		std::size_t Samples;     /*!< Number of samples. */
+		double Median;           /*!< Median. */
+		double Mad;              /*!< Median absolute deviation. */
+		double Mean;             /*!< Mean. */
+		double Min;              /*!< Minimum. */
+		double Max;              /*!< Maximum. */
+		double P5;               /*!< 5th percentile. */
+		double P25;              /*!< 25th percentile. */
+		double P75;              /*!< 75th percentile. */
+		double P95;              /*!< 95th percentile. */
+		double P99;              /*!< 99th percentile. */
+		double Items;            /*!< Items per iteration (zero if not set). */
+		double Bytes;            /*!< Bytes per iteration (zero if not set). */
+		double Cycles;           /*!< Mean cycles per iteration (zero if not counted). */
+		double Instructions;     /*!< Mean instructions per iteration (zero if not counted). */
+		double CacheMisses;      /*!< Mean cache misses per iteration (zero if not counted). */
+		double BranchMisses;     /*!< Mean branch misses per iteration (zero if not counted). */
+	};
+
+	struct TRegistration  /*!< Static object that registers a benchmark (see TBENCHMARK). */
+	{
+		TRegistration(const char *Name, TFunction Function);
+	};
+
+private:
+	struct TEntry  /*!< Registered benchmark. */
+	{
+		std::string Name;    /*!< Name of the benchmark. */
+		TFunction Function;  /*!< Benchmark function. */
+	};
+
+	TPrecisionTimer Timer;         /*!< Timer of the samples. */
+	TPerfCounters *Counters;       /*!< Counters read with the samples (NULL if they aren't used). */
+	double MinTime;                /*!< Minimum time of each sample, in seconds. */
+	double WarmupTime;             /*!< Time spent running before the samples, in seconds. */
+	unsigned int Repetitions;      /*!< Number of samples. */
+	std::string Filter;            /*!< Only benchmarks whose names contain it are run by RunAll(). */
+	std::vector<TResult> Results;  /*!< Results, in run order. */
+
+	// support functions
+	static std::vector<TEntry> &GetRegistry();
+	double Sample(TFunction Function, TState &State, TPerfCounters::TValues *Values = NULL);
+	static double Percentile(const std::vector<double> &Sorted, double P);
+
+public:
+	TBenchmark(TPrecisionTimer::EClock Clock = TPrecisionTimer::ckDefault);
+	virtual ~TBenchmark();
+	TBenchmark(const TBenchmark&) = delete;
+	TBenchmark &operator = (const TBenchmark&) = delete;
+
+	// options
+	void SetMinTime(double Seconds);
+	void SetWarmupTime(double Seconds);
+	void SetRepetitions(unsigned int Count);
+	void SetFilter(const std::string &Text);
+	bool SetCounters(bool Enabled);
+
+	// running
+	const TResult &Run(const std::string &Name, TFunction Function);
+	std::size_t RunAll(std::ostream *Progress = NULL);
+	const std::vector<TResult> &GetResults() const;
+	const TPrecisionTimer &GetTimer() const;
+	const TPerfCounters *GetCounters() const;
+
+	// output
+	void Print(std::ostream &Output) const;
+	bool WriteJson(const char *FileName) const;
+	bool WriteCsv(const char *FileName) const;
+	static int Main(int argc, char **argv);
+
+	// optimization barriers
+	template <class Type> static inline void DoNotOptimize(Type const &Value);
+	static inline void ClobberMemory();
+};
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Make the compiler assume that a value is used, so the code that computes it isn't removed.
+ * \param Value Value to be "used".
+ */
+template <class Type> inline void TBenchmark::DoNotOptimize(Type const &Value)
+{
+#if defined(__GNUC__)
+	asm volatile("" : : "r,m"(Value) : "memory");
+#else
+	static volatile const char *Sink;
+	Sink = reinterpret_cast<volatile const char*>(&Value);
+	_ReadWriteBarrier();
+#endif
+}
+
+/*!
+ * \brief Make the compiler assume that all memory is read and written here, so stores aren't removed or moved.
+ */
+inline void TBenchmark::ClobberMemory()
+{
+#if defined(__GNUC__)
+	asm volatile("" : : : "memory");
+#else
+	_ReadWriteBarrier();
+#endif
+}
+
+/*!
+ * \brief Define and register a benchmark, as "TBENCHMARK(Name) { for(...State.Iterations...) ... }".
+ */
+#define TBENCHMARK(Name) \
+	static void Name(TBenchmark::TState &State); \
+	static TBenchmark::TRegistration Name##Registration(#Name, Name); \
+	static void Name(TBenchmark::TState &State)
+
+//---------------------------------------------------------------------------
+
+#endif
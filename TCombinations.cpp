@@ -0,0 +1,142 @@
+
+#include "TCombinations.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Class constructor, positioned at the first tuple (all ones).
+ * \param ValorMax Values of each position go from 1 to ValorMax+1 (as in Binomio).
+ * \param NumCasas Number of positions (zero or less gives a single empty tuple).
+ */
+TCombinations::TCombinations(int ValorMax, int NumCasas)
+{
+	Base = (ValorMax < 0) ? 1 : ValorMax + 1;
+	Positions = (NumCasas < 0) ? 0 : NumCasas;
+	Total = 1;
+	for(int i = 0; i < Positions && Total != 0; i++)
+	{
+		if(Total > ~0ULL / (unsigned long long)Base) Total = 0;  // overflow
+		else Total *= Base;
+	}
+	Reset();
+}
+
+/*!
+ * \brief Destructor (no pointers here, so nothing to declare).
+ */
+TCombinations::~TCombinations()
+{
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Go back to the first tuple.
+ */
+void TCombinations::Reset()
+{
+	Digits.assign(Positions, 1);
+	Current = 0;
+	Finished = false;
+}
+
+/*!
+ * \brief Move to the next tuple (amortized O(1): the last position rolls over to the previous ones).
+ * \return True if moved, false if the current tuple was the last one (the generator is finished).
+ */
+bool TCombinations::Next()
+{
+	if(Finished) return false;
+	for(int i = Positions - 1; i >= 0; i--)
+	{
+		if(Digits[i] < Base)
+		{
+			Digits[i]++;
+			Current++;
+			return true;
+		}
+		Digits[i] = 1;  // roll over, move to the previous position
+	}
+	// every position rolled over: it was the last tuple
+	Digits.assign(Positions, Base);
+	Finished = true;
+	return false;
+}
+
+/*!
+ * \brief Move to the tuple of a given rank.
+ * \param Rank Index of the tuple in the sequence.
+ * \return True if moved, false if the rank is out of the sequence (or the sequence doesn't fit in 64 bits).
+ */
+bool TCombinations::Seek(unsigned long long Rank)
+{
+	if(!Unrank(Rank, Digits)) return false;
+	Current = Rank;
+	Finished = false;
+	return true;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Get the current tuple.
+ * \return Reference to the internal buffer (it's overwritten by Next() and Seek()).
+ */
+const std::vector<int> &TCombinations::Get() const
+{
+	return Digits;
+}
+
+/*!
+ * \brief Get the rank of the current tuple.
+ * \return Index of the current tuple in the sequence.
+ */
+unsigned long long TCombinations::GetRank() const
+{
+	return Current;
+}
+
+/*!
+ * \brief Get the number of tuples of the sequence.
+ * \return Number of tuples ((ValorMax+1)^NumCasas), or zero if it doesn't fit in 64 bits.
+ */
+unsigned long long TCombinations::GetCount() const
+{
+	return Total;
+}
+
+/*!
+ * \brief Convert a rank to its tuple (mixed radix digits).
+ * \param Rank Index of the tuple in the sequence.
+ * \param Tuple Vector that will receive the tuple.
+ * \return True if converted, false if the rank is out of the sequence.
+ */
+bool TCombinations::Unrank(unsigned long long Rank, std::vector<int> &Tuple) const
+{
+	if(Total == 0 || Rank >= Total) return false;
+	Tuple.resize(Positions);
+	for(int i = Positions - 1; i >= 0; i--)
+	{
+		Tuple[i] = (int)(Rank % Base) + 1;
+		Rank /= Base;
+	}
+	return true;
+}
+
+/*!
+ * \brief Convert a tuple to its rank.
+ * \param Tuple Tuple with NumCasas values from 1 to ValorMax+1.
+ * \param Rank Reference that will receive the index of the tuple in the sequence.
+ * \return True if converted, false if the tuple doesn't belong to the sequence.
+ */
+bool TCombinations::Rank(const std::vector<int> &Tuple, unsigned long long &Rank) const
+{
+	if(Total == 0 || (int)Tuple.size() != Positions) return false;
+	Rank = 0;
+	for(int i = 0; i < Positions; i++)
+	{
+		if(Tuple[i] < 1 || Tuple[i] > Base) return false;
+		Rank = Rank * Base + (Tuple[i] - 1);
+	}
+	return true;
+}
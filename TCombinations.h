@@ -0,0 +1,76 @@
+#ifndef TCombinationsH
+#define TCombinationsH
+
+#include <thread>
+#include <vector>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Lazy generator of the combinations of Binomio (Friends), without storing them.
+ *
+ * Enumerates every tuple of NumCasas positions with values from 1 to ValorMax+1, in the same
+ * order of Binomio (the last position changes faster). The current tuple lives in a single
+ * reusable buffer, and each tuple has a rank (its index in the sequence), which can be converted
+ * both ways in O(NumCasas) (constant for a given space), so the sequence can be split in chunks
+ * for worker threads; ForEach does exactly that.
+ */
+class TCombinations
+{
+private:
+	int Base;                    /*!< Number of values per position (ValorMax+1, at least 1). */
+	int Positions;               /*!< Number of positions. */
+	unsigned long long Total;    /*!< Number of tuples (zero if it doesn't fit in 64 bits). */
+	unsigned long long Current;  /*!< Rank of the current tuple. */
+	bool Finished;               /*!< True after Next() passes the last tuple. */
+	std::vector<int> Digits;     /*!< Current tuple. */
+
+public:
+	// constructors and destructor
+	TCombinations(int ValorMax, int NumCasas);
+	virtual ~TCombinations();
+
+	// navigation functions
+	void Reset();
+	bool Next();
+	bool Seek(unsigned long long Rank);
+
+	// output functions
+	const std::vector<int> &Get() const;
+	unsigned long long GetRank() const;
+	unsigned long long GetCount() const;
+	bool Unrank(unsigned long long Rank, std::vector<int> &Tuple) const;
+	bool Rank(const std::vector<int> &Tuple, unsigned long long &Rank) const;
+
+	/*!
+	 * \brief Visit all tuples, splitting the sequence in contiguous chunks for a pool of threads.
+	 * \param Function Function (or lambda) called as Function(const std::vector<int> &Tuple, unsigned long long Rank); it must be thread safe.
+	 * \param Threads Number of threads (zero is the number of hardware threads).
+	 * \return True if visited, false if the number of tuples doesn't fit in 64 bits.
+	 */
+	template <class Visitor> bool ForEach(Visitor Function, unsigned int Threads = 0) const
+	{
+		if(Total == 0) return false;
+		if(Threads == 0) Threads = std::thread::hardware_concurrency();
+		if(Threads == 0) Threads = 1;
+		if(Threads > Total) Threads = (unsigned int)Total;
+		std::vector<std::thread> pool;
+		for(unsigned int t = 0; t < Threads; t++)
+		{
+			unsigned long long begin = Total / Threads * t + ((t < Total % Threads) ? t : Total % Threads);
+			unsigned long long count = Total / Threads + ((t < Total % Threads) ? 1 : 0);
+			pool.push_back(std::thread([this, begin, count, &Function]()
+			{
+				TCombinations chunk(*this);
+				chunk.Seek(begin);
+				for(unsigned long long i = 0; i < count; i++, chunk.Next()) Function(chunk.Get(), begin + i);
+			}));
+		}
+		for(unsigned int t = 0; t < Threads; t++) pool[t].join();
+		return true;
+	}
+};
+
+//---------------------------------------------------------------------------
+
+#endif
@@ -1,24 +1,824 @@
-#include <fstream>
+
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #include "TConfigFile.h"
+#include "TProfiler.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Read-only memory mapping of a whole file.
+ * \param FileName File name (may include full pathname).
+ * \param Data Reference that will receive the pointer to the mapped contents (NULL for an empty file).
+ * \param Size Reference that will receive the size of the file.
+ * \param Handle Reference that will receive the mapping handle, to be released by UnmapFile().
+ * \return True if the file was mapped, false if it couldn't be opened or mapped.
+ */
+static bool MapFile(const char *FileName, const char *&Data, std::size_t &Size, void *&Handle)
+{
+	Data = NULL;
+	Size = 0;
+	Handle = NULL;
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	Size = (std::size_t)size.QuadPart;
+	if(Size > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(mapping != NULL)
+		{
+			Data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);  // the view keeps the mapping alive
+		}
+		if(Data == NULL)
+		{
+			CloseHandle(file);
+			return false;
+		}
+	}
+	CloseHandle(file);
+#else
+	int file = open(FileName, O_RDONLY);
+	if(file < 0) return false;
+	struct stat info;
+	if(fstat(file, &info) != 0)
+	{
+		close(file);
+		return false;
+	}
+	Size = (std::size_t)info.st_size;
+	if(Size > 0)
+	{
+		void *map = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, file, 0);
+		if(map == MAP_FAILED)
+		{
+			close(file);
+			return false;
+		}
+		madvise(map, Size, MADV_SEQUENTIAL);
+		Data = (const char*)map;
+	}
+	close(file);  // the mapping stays valid
+#endif
+	return true;
+}
+
+/*!
+ * \brief Release a mapping done by MapFile().
+ * \param Data Pointer to the mapped contents.
+ * \param Size Size of the file.
+ * \param Handle Mapping handle.
+ */
+static void UnmapFile(const char *Data, std::size_t Size, void *Handle)
+{
+	(void)Handle;
+	if(Data == NULL) return;
+#if defined(_WIN32)
+	(void)Size;
+	UnmapViewOfFile(Data);
+#else
+	munmap((void*)Data, Size);
+#endif
+}
+
+/*!
+ * \brief Replace a file atomically: the text is written to a temporary file with a single call,
+ * flushed to the disk and renamed over the file, so readers see either the old or the new file.
+ * \param FileName File name (may include full pathname).
+ * \param Text Whole contents of the file.
+ * \return True if the file was replaced, false if it couldn't be written (the old file is kept).
+ */
+static bool WriteAtomic(const char *FileName, const std::string &Text)
+{
+#if defined(_WIN32)
+	std::string temporary = std::string(FileName) + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+	HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return false;
+	bool ok = true;
+	for(std::size_t done = 0; ok && done < Text.size(); )
+	{
+		DWORD written = 0;
+		DWORD size = (DWORD)std::min<std::size_t>(Text.size() - done, 1U << 30);
+		ok = ::WriteFile(file, Text.data() + done, size, &written, NULL) != 0;
+		done += written;
+	}
+	ok = ok && FlushFileBuffers(file) != 0;
+	CloseHandle(file);
+	ok = ok && MoveFileExA(temporary.c_str(), FileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+	if(!ok) DeleteFileA(temporary.c_str());
+	return ok;
+#else
+	std::string temporary = std::string(FileName) + "." + std::to_string(getpid()) + ".tmp";
+	int file = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if(file < 0) return false;
+	struct stat info;
+	if(stat(FileName, &info) == 0) fchmod(file, info.st_mode & 07777);  // keep the permissions of the old file
+	bool ok = true;
+	for(std::size_t done = 0; ok && done < Text.size(); )
+	{
+		ssize_t written = write(file, Text.data() + done, Text.size() - done);
+		if(written > 0) done += (std::size_t)written;
+		else ok = written < 0 && errno == EINTR;
+	}
+	ok = ok && fsync(file) == 0;
+	ok = (close(file) == 0) && ok;
+	ok = ok && rename(temporary.c_str(), FileName) == 0;
+	if(!ok)
+	{
+		unlink(temporary.c_str());
+		return false;
+	}
+	// the rename itself is only durable after the directory is flushed
+	std::string directory = std::filesystem::path(FileName).parent_path().string();
+	int folder = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(folder >= 0)
+	{
+		fsync(folder);
+		close(folder);
+	}
+	return true;
+#endif
+}
+
+/*!
+ * \brief Identify the characters removed from both sides of names and values.
+ * \param Char Character to be tested.
+ * \return True for space, tab, carriage return and new line.
+ */
+static inline bool IsBlank(char Char)
+{
+	return Char == ' ' || Char == '\t' || Char == '\r' || Char == '\n';
+}
+
+/*!
+ * \brief Identify a section header, such as "[name]".
+ * \param Begin First character of the line (without blanks).
+ * \param End End of the line (without blanks).
+ * \param Prefix String that will receive the prefix of the names in the section ("name.", or empty for "[]").
+ * \return True if the line is a section header (Prefix is unchanged otherwise).
+ */
+static bool ParseSection(const char *Begin, const char *End, std::string &Prefix)
+{
+	if(End - Begin < 2 || *Begin != '[' || End[-1] != ']') return false;
+	if(std::memchr(Begin, '=', End - Begin) != NULL) return false;
+	const char *b = Begin + 1, *e = End - 1;
+	while(b < e && IsBlank(*b)) b++;
+	while(e > b && IsBlank(e[-1])) e--;
+	Prefix.assign(b, e - b);
+	if(!Prefix.empty()) Prefix += '.';
+	return true;
+}
+
+/*!
+ * \brief Request a memory address to the cache, without waiting for it.
+ * \param Address Address that will be used soon.
+ */
+static inline void Prefetch(const void *Address)
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(Address);
+#elif defined(_MSC_VER)
+	_mm_prefetch((const char*)Address, _MM_HINT_T0);
+#else
+	(void)Address;
+#endif
+}
+
+/*!
+ * \brief Convert a whole text to an integer (an optional sign and decimal digits).
+ * \param Text Text to be converted.
+ * \param Value Reference that will receive the integer.
+ * \return True if the whole text is an integer in range.
+ */
+static bool ParseInt(std::string_view Text, long long &Value)
+{
+	const char *b = Text.data(), *e = Text.data() + Text.size();
+	// from_chars doesn't take a '+', but a '-' after a skipped '+' isn't a number either
+	if(b < e && *b == '+' && ++b < e && *b == '-') return false;
+	std::from_chars_result r = std::from_chars(b, e, Value);
+	return r.ec == std::errc() && r.ptr == e && b < e;
+}
+
+/*!
+ * \brief Convert a whole text to a double (fixed or scientific notation).
+ * \param Text Text to be converted.
+ * \param Value Reference that will receive the double.
+ * \return True if the whole text is a number in range.
+ */
+static bool ParseDouble(std::string_view Text, double &Value)
+{
+	const char *b = Text.data(), *e = Text.data() + Text.size();
+	// from_chars doesn't take a '+', but a '-' after a skipped '+' isn't a number either
+	if(b < e && *b == '+' && ++b < e && *b == '-') return false;
+	std::from_chars_result r = std::from_chars(b, e, Value);
+	return r.ec == std::errc() && r.ptr == e && b < e;
+}
+
+/*!
+ * \brief Convert a text to a boolean (true/false, yes/no, on/off or 1/0, case insensitive).
+ * \param Text Text to be converted.
+ * \param Value Reference that will receive the boolean.
+ * \return True if the text is one of the accepted words.
+ */
+static bool ParseBool(std::string_view Text, bool &Value)
+{
+	char word[6];
+	if(Text.empty() || Text.size() > 5) return false;
+	for(std::size_t i = 0; i < Text.size(); i++) word[i] = (Text[i] >= 'A' && Text[i] <= 'Z') ? Text[i] + ('a' - 'A') : Text[i];
+	std::string_view w(word, Text.size());
+	if(w == "true" || w == "yes" || w == "on" || w == "1") Value = true;
+	else if(w == "false" || w == "no" || w == "off" || w == "0") Value = false;
+	else return false;
+	return true;
+}
+
+/*!
+ * \brief Hash of the contents of a file, to detect files rewritten without changes.
+ * \param Data Contents of the file.
+ * \param Size Size of the contents.
+ * \return 64-bit hash (8 bytes at a time).
+ */
+static std::uint64_t HashBytes(const char *Data, std::size_t Size)
+{
+	std::uint64_t hash = Size * 0x9E3779B97F4A7C15ULL;
+	std::size_t i = 0;
+	for(; i + 8 <= Size; i += 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, Data + i, 8);
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+		hash ^= hash >> 29;
+	}
+	std::uint64_t word = 0;
+	if(i < Size) std::memcpy(&word, Data + i, Size - i);  // Data may be NULL for an empty file
+	hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ULL;
+	return hash ^ (hash >> 32);
+}
 
 //---------------------------------------------------------------------------
 
 /*!
- * \brief Remove escape characters (\r, \n e \t) from both sides of a string.
- * \param  Expression String to be trimmed (from both sides).
- * \return Return the string without escape characters in both sides.
- * \sa Friends repository.
+ * \brief Hash of a parameter name (64-bit FNV-1a, with a final mix so the low bits used by the index depend on all bytes).
+ * \param Key Parameter name.
+ * \return Hash of the name.
+ */
+std::uint64_t TConfigFile::HashKey(std::string_view Key)
+{
+	std::uint64_t hash = 14695981039346656037ULL;
+	for(std::size_t i = 0; i < Key.size(); i++)
+	{
+		hash ^= (unsigned char)Key[i];
+		hash *= 1099511628211ULL;
+	}
+	hash ^= hash >> 32;
+	hash *= 0xD6E8FEB86659FD93ULL;
+	return hash ^ (hash >> 32);
+}
+
+/*!
+ * \brief Find the slot of a name in the index, by linear probing.
+ * \param Key Parameter name.
+ * \param Hash Hash of the name.
+ * \return Slot holding the first entry of the name, or the empty slot where it would be.
+ */
+std::size_t TConfigFile::FindSlot(std::string_view Key, std::uint64_t Hash) const
+{
+	std::size_t mask = Slots.size() - 1;
+	std::size_t slot = (std::size_t)Hash & mask;
+	while(Slots[slot].Entry != std::string::npos)
+	{
+		if(Slots[slot].Hash == Hash)
+		{
+			const TEntry &entry = Entries[Slots[slot].Entry];
+			if(std::string_view(Arena.data() + entry.Key, entry.KeySize) == Key) break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+/*!
+ * \brief Parameter stored in the arena or in the mapped image.
+ * \param Index Index of the parameter (from 0 to GetCount()-1).
+ * \return Reference to the entry.
+ */
+inline const TConfigFile::TEntry &TConfigFile::GetEntry(std::size_t Index) const
+{
+	return (Image != NULL) ? Image->Entries[Index] : Entries[Index];
+}
+
+/*!
+ * \brief Names and values, in the arena or in the mapped image.
+ * \return Pointer to which the entry offsets refer.
+ */
+inline const char *TConfigFile::GetText() const
+{
+	return (Image != NULL) ? Image->Text : Arena.data();
+}
+
+/*!
+ * \brief Slot of a name in the perfect hash table of an image.
+ * \param Hash Hash of the name.
+ * \param Displacement Displacement of the bucket of the name.
+ * \param TableSize Size of the table.
+ * \return Slot of the name.
+ */
+static inline std::size_t ImageSlot(std::uint64_t Hash, std::uint32_t Displacement, std::size_t TableSize)
+{
+	std::uint64_t x = Hash ^ ((std::uint64_t)Displacement * 0x9E3779B97F4A7C15ULL);
+	x ^= x >> 31;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 29;
+	return (std::size_t)(x % TableSize);
+}
+
+/*!
+ * \brief Find the first entry of a name in the mapped image (a single probe).
+ * \param Key Parameter name.
+ * \return Index of the first entry with the name, or npos if it doesn't exist.
+ */
+std::size_t TConfigFile::FindImageEntry(std::string_view Key) const
+{
+	if(Image->TableSize == 0) return std::string::npos;
+	std::uint64_t hash = HashKey(Key);
+	std::uint32_t displacement = Image->Displacements[(std::size_t)((hash >> 32) % Image->Buckets)];
+	std::uint64_t index = Image->Table[ImageSlot(hash, displacement, Image->TableSize)];
+	if(index == (std::uint64_t)-1) return std::string::npos;
+	const TEntry &entry = Image->Entries[index];
+	if(entry.Hash != hash || std::string_view(Image->Text + entry.Key, entry.KeySize) != Key) return std::string::npos;
+	return (std::size_t)index;
+}
+
+/*!
+ * \brief Find the first entry of a name.
+ * \param Key Parameter name.
+ * \return Index of the first entry with the name, or npos if it doesn't exist.
  */
-std::string TConfigFile::Trim(const char* Expression)
+std::size_t TConfigFile::FindEntry(std::string_view Key) const
 {
-	std::string text = Expression;
-	char const* delims = " \t\r\n";  // escape chars
-	std::string::size_type corte = text.find_first_not_of(delims);
-	text.erase(0,corte);
-	corte = text.find_last_not_of(delims);
-	text.erase(corte+1);
-	return text;
+	if(Image != NULL) return FindImageEntry(Key);
+	if(Slots.empty()) return std::string::npos;
+	return Slots[FindSlot(Key, HashKey(Key))].Entry;
+}
+
+/*!
+ * \brief Add entries to the index, chaining repeated names in file order.
+ * \param First First entry to be indexed (the index is rebuilt from the first entry if it has to grow).
+ */
+void TConfigFile::Index(std::size_t First)
+{
+	// room for the worst case (all names new), so the index doesn't grow inside the loop
+	std::size_t capacity = Slots.empty() ? 16 : Slots.size();
+	while(capacity < 2*(Keys + Entries.size() - First)) capacity *= 2;
+	if(capacity != Slots.size())
+	{
+		TSlot empty = { 0, std::string::npos };
+		Slots.assign(capacity, empty);
+		Keys = 0;
+		First = 0;
+	}
+	std::size_t mask = Slots.size() - 1;
+	for(std::size_t i = First; i < Entries.size(); i++)
+	{
+		// the slots are visited in random order, so they are requested ahead to overlap the cache misses
+		if(i + 16 < Entries.size()) Prefetch(&Slots[(std::size_t)Entries[i + 16].Hash & mask]);
+		TEntry &entry = Entries[i];
+		entry.Next = std::string::npos;
+		entry.Last = i;
+		std::size_t slot = FindSlot(std::string_view(Arena.data() + entry.Key, entry.KeySize), entry.Hash);
+		if(Slots[slot].Entry == std::string::npos)
+		{
+			Slots[slot].Hash = entry.Hash;
+			Slots[slot].Entry = i;
+			Keys++;
+		}
+		else
+		{
+			TEntry &head = Entries[Slots[slot].Entry];
+			Entries[head.Last].Next = i;
+			head.Last = i;
+		}
+	}
+}
+
+/*!
+ * \brief Append a parameter to the arena and the entries (it still has to be indexed).
+ * \param Key Parameter name (it must not point into the arena).
+ * \param Value Parameter value (it must not point into the arena).
+ */
+void TConfigFile::Append(std::string_view Key, std::string_view Value)
+{
+	TEntry entry;
+	entry.Key = Arena.size();
+	entry.KeySize = Key.size();
+	Arena.append(Key.data(), Key.size());
+	entry.Value = Arena.size();
+	entry.ValueSize = Value.size();
+	Arena.append(Value.data(), Value.size());
+	entry.Hash = HashKey(Key);
+	entry.Next = std::string::npos;
+	entry.Last = Entries.size();
+	Entries.push_back(entry);
+}
+
+/*!
+ * \brief Append a parameter to the arena, the entries and the index.
+ * \param Key Parameter name (it must not point into the arena).
+ * \param Value Parameter value (it must not point into the arena).
+ */
+void TConfigFile::Insert(std::string_view Key, std::string_view Value)
+{
+	Append(Key, Value);
+	Index(Entries.size() - 1);
+	ResetCache();
+	ResolveHandles();
+}
+
+/*!
+ * \brief Move the names and values after SourceText to a new tail of the arena, dropping the dead bytes.
+ */
+void TConfigFile::Compact()
+{
+	std::string tail;
+	tail.reserve(Arena.size() - SourceText - DeadBytes);
+	for(std::size_t i = 0; i < Entries.size(); i++)
+	{
+		TEntry &entry = Entries[i];
+		if(entry.Key >= SourceText)
+		{
+			std::size_t key = SourceText + tail.size();
+			tail.append(Arena, entry.Key, entry.KeySize);
+			entry.Key = key;
+		}
+		if(entry.Value >= SourceText)
+		{
+			std::size_t value = SourceText + tail.size();
+			tail.append(Arena, entry.Value, entry.ValueSize);
+			entry.Value = value;
+		}
+	}
+	Arena.resize(SourceText);
+	Arena.append(tail);
+	DeadBytes = 0;
+}
+
+/*!
+ * \brief Parse the text of a configuration file in a single pass.
+ * \param Text Contents of the file.
+ * \param Size Size of the contents.
+ * \param Source Source that will receive the lines (cleared first), with their names and values appended to the arena. Invalid lines are ignored.
+ */
+void TConfigFile::Parse(const char *Text, std::size_t Size, TSource &Source)
+{
+	Source.Text = Arena.size();
+	Source.Lines.clear();
+	Arena.reserve(Arena.size() + Size);  // names and values are never larger than the file (unless sections are used)
+	std::string section;
+	const char *p = Text, *end = Text + Size;
+	while(p < end)
+	{
+		const char *eol = (const char*)std::memchr(p, '\n', end - p);
+		if(eol == NULL) eol = end;
+		const char *b = p, *e = eol;
+		p = (eol < end) ? eol + 1 : end;
+		while(b < e && IsBlank(*b)) b++;
+		while(e > b && IsBlank(e[-1])) e--;
+		if(b == e) continue;     // blank line
+		if(*b == '#') continue;  // comment
+		const char *eq = (const char*)std::memchr(b, '=', e - b);
+		TLine line;
+		if(eq == NULL)
+		{
+			if(ParseSection(b, e, section)) continue;
+			if(e - b > 8 && std::memcmp(b, "include", 7) == 0 && IsBlank(b[7]))  // include
+			{
+				const char *ib = b + 8;
+				while(ib < e && IsBlank(*ib)) ib++;
+				line.Key = std::string::npos;
+				line.KeySize = 0;
+				line.Value = (Arena.size() - Source.Text);
+				line.ValueSize = e - ib;
+				line.Hash = 0;
+				line.Kind = lkInclude;
+				Arena.append(ib, e - ib);
+				Source.Lines.push_back(line);
+			}
+			continue;  // invalid line
+		}
+		const char *ke = eq, *vb = eq + 1;
+		while(ke > b && IsBlank(ke[-1])) ke--;
+		while(vb < e && IsBlank(*vb)) vb++;
+		line.Key = (Arena.size() - Source.Text);
+		Arena.append(section);
+		Arena.append(b, ke - b);
+		line.KeySize = (Arena.size() - Source.Text) - line.Key;
+		line.Value = (Arena.size() - Source.Text);
+		line.ValueSize = e - vb;
+		Arena.append(vb, e - vb);
+		line.Hash = HashKey(std::string_view(Arena.data() + Source.Text + line.Key, line.KeySize));
+		const char *dollar = (const char*)std::memchr(vb, '$', e - vb);
+		line.Kind = lkParameter;
+		while(dollar != NULL && dollar + 1 < e)
+		{
+			if(dollar[1] == '{')
+			{
+				line.Kind = lkInterpolate;
+				break;
+			}
+			dollar = (const char*)std::memchr(dollar + 1, '$', e - dollar - 1);
+		}
+		Source.Lines.push_back(line);
+	}
+	Source.TextSize = Arena.size() - Source.Text;
+}
+
+/*!
+ * \brief Replace the references to environment variables in a text.
+ * \param Text Text with "${VARIABLE}" or "${VARIABLE:-default}" references (undefined variables without default are removed, unclosed references are kept).
+ * \param Output String that will receive the text (cleared first).
+ * \param Used Map that will receive the names and values of the variables referenced (NULL to skip).
+ */
+void TConfigFile::Interpolate(std::string_view Text, std::string &Output, std::map<std::string,std::string> *Used)
+{
+	Output.clear();
+	std::size_t p = 0;
+	while(p < Text.size())
+	{
+		std::size_t b = Text.find("${", p);
+		std::size_t e = (b == std::string_view::npos) ? b : Text.find('}', b + 2);
+		if(e == std::string_view::npos)
+		{
+			Output.append(Text.data() + p, Text.size() - p);
+			break;
+		}
+		Output.append(Text.data() + p, b - p);
+		std::string_view reference = Text.substr(b + 2, e - b - 2);
+		std::size_t d = reference.find(":-");
+		std::string name(reference.substr(0, d));
+		const char *value = std::getenv(name.c_str());
+		if(Used != NULL) (*Used)[name] = (value != NULL) ? value : "";  // unset and empty expand the same way
+		if(value != NULL && *value != '\0') Output.append(value);
+		else if(d != std::string_view::npos) Output.append(reference.substr(d + 2));
+		p = e + 1;
+	}
+}
+
+/*!
+ * \brief Parsed contents of a file, in the arena, parsing it only if it changed since the last read.
+ * \param Path Normalized path of the file.
+ * \param Previous Arena of the last read, from which the text of unchanged files is copied.
+ * \return Source of the file, or NULL if it couldn't be read (it's still recorded as a source
+ * that doesn't exist, so IsModified() notices when it appears).
+ */
+TConfigFile::TSource *TConfigFile::LoadSource(const std::string &Path, const std::string &Previous)
+{
+	std::unordered_map<std::string,TSource>::iterator it = Sources.find(Path);
+	if(it != Sources.end() && it->second.Used) return it->second.Exists ? &it->second : NULL;  // included again in the same read
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(Path, error);  // taken before reading, so a later write is still noticed
+	bool same = false;
+	if(!error && it != Sources.end() && it->second.Exists)
+	{
+		std::uintmax_t size = std::filesystem::file_size(Path, error);
+		same = !error && it->second.Time == time && it->second.Size == size;
+	}
+	const char *data = NULL;
+	std::size_t size = 0;
+	void *handle = NULL;
+	bool missing = error || (!same && !MapFile(Path.c_str(), data, size, handle));
+	if(it == Sources.end()) it = Sources.insert(std::make_pair(Path, TSource())).first;
+	TSource &source = it->second;
+	if(missing)
+	{
+		source.Time = error ? std::filesystem::file_time_type::min() : time;  // an unreadable file is only noticed when it's written
+		source.Size = 0;
+		source.Hash = 0;
+		source.Text = Arena.size();
+		source.TextSize = 0;
+		source.Lines.clear();
+		source.Exists = false;
+		source.Used = true;
+		return NULL;
+	}
+	if(!same)
+	{
+		std::uint64_t hash = HashBytes(data, size);
+		same = source.Exists && source.Size == size && source.Hash == hash;  // touched, but not changed
+		if(!same) Parse(data, size, source);
+		UnmapFile(data, size, handle);
+		source.Size = size;
+		source.Hash = hash;
+	}
+	if(same)  // the lines are kept, and only the text is copied
+	{
+		std::size_t text = Arena.size();
+		Arena.append(Previous, source.Text, source.TextSize);
+		source.Text = text;
+	}
+	source.Time = time;
+	source.Exists = true;
+	source.Used = true;
+	return &source;
+}
+
+/*!
+ * \brief Append the parameters of a source to the entries, following its includes.
+ * \param Path Normalized path of the source.
+ * \param Source Parsed source.
+ * \param Previous Arena of the last read (see LoadSource()).
+ * \param Stack Paths being flattened (an include of one of them is ignored, to avoid cycles).
+ */
+void TConfigFile::Flatten(const std::string &Path, const TSource &Source, const std::string &Previous, std::vector<std::string> &Stack)
+{
+	Stack.push_back(Path);
+	std::size_t base = Source.Text;  // parameters without references are used in place
+	Entries.reserve(Entries.size() + Source.Lines.size());
+	std::string text;
+	for(std::size_t i = 0; i < Source.Lines.size(); i++)
+	{
+		const TLine &line = Source.Lines[i];
+		if(line.Kind == lkInclude)
+		{
+			Interpolate(std::string_view(Arena.data() + base + line.Value, line.ValueSize), text, &Variables);
+			std::filesystem::path target(text);
+			if(target.is_relative()) target = std::filesystem::path(Path).parent_path() / target;
+			std::string include = target.lexically_normal().string();
+			if(std::find(Stack.begin(), Stack.end(), include) != Stack.end()) continue;
+			TSource *source = LoadSource(include, Previous);
+			if(source != NULL) Flatten(include, *source, Previous, Stack);  // missing files are ignored, as invalid lines (but watched)
+			continue;
+		}
+		TEntry entry;
+		entry.Key = base + line.Key;
+		entry.KeySize = line.KeySize;
+		entry.Value = base + line.Value;
+		entry.ValueSize = line.ValueSize;
+		if(line.Kind == lkInterpolate)  // interpolated at each read, so changes of the environment are seen
+		{
+			Interpolate(std::string_view(Arena.data() + base + line.Value, line.ValueSize), text, &Variables);
+			entry.Value = Arena.size();
+			entry.ValueSize = text.size();
+			Arena.append(text);
+		}
+		entry.Hash = line.Hash;
+		entry.Next = std::string::npos;
+		entry.Last = Entries.size();
+		Entries.push_back(entry);
+	}
+	Stack.pop_back();
+}
+
+/*!
+ * \brief Find again the entries of the interned names, after the parameters changed.
+ */
+void TConfigFile::ResolveHandles()
+{
+	HandleEntries.resize(Handles.size());
+	for(std::size_t i = 0; i < Handles.size(); i++) HandleEntries[i] = FindEntry(Handles[i]);
+}
+
+/*!
+ * \brief Discard the cached conversions (the entries changed, so they are created again on demand).
+ */
+void TConfigFile::ResetCache()
+{
+	delete[] Cache.exchange(NULL);
+}
+
+/*!
+ * \brief Cached conversions of an entry, creating the cache of all entries at the first call.
+ * \param Entry Index of the entry.
+ * \return Reference to the cached conversions.
+ *
+ * Concurrent readers may race to create the cache: only one of them publishes it, and the
+ * others discard their copies.
+ */
+TConfigFile::TCache &TConfigFile::GetCache(std::size_t Entry) const
+{
+	TCache *cache = Cache.load(std::memory_order_acquire);
+	if(cache == NULL)
+	{
+		TCache *created = new TCache[GetCount()]();
+		if(Cache.compare_exchange_strong(cache, created, std::memory_order_acq_rel)) cache = created;
+		else delete[] created;
+	}
+	return cache[Entry];
+}
+
+/*!
+ * \brief Integer value of an entry, converted once.
+ * \param Entry Index of the entry.
+ * \param Value Reference that will receive the integer.
+ * \return True if the value is an integer.
+ */
+bool TConfigFile::CachedInt(std::size_t Entry, long long &Value) const
+{
+	TCache &cache = GetCache(Entry);
+	unsigned char state = cache.State.load(std::memory_order_acquire);
+	if(!(state & csIntDone))
+	{
+		long long value = 0;
+		bool valid = ParseInt(GetValueAt(Entry), value);
+		cache.Int.store(value, std::memory_order_relaxed);
+		state |= cache.State.fetch_or(csIntDone | (valid ? csIntValid : 0), std::memory_order_release) | csIntDone | (valid ? csIntValid : 0);
+	}
+	if(!(state & csIntValid)) return false;
+	Value = cache.Int.load(std::memory_order_relaxed);
+	return true;
+}
+
+/*!
+ * \brief Double value of an entry, converted once.
+ * \param Entry Index of the entry.
+ * \param Value Reference that will receive the double.
+ * \return True if the value is a number.
+ */
+bool TConfigFile::CachedDouble(std::size_t Entry, double &Value) const
+{
+	TCache &cache = GetCache(Entry);
+	unsigned char state = cache.State.load(std::memory_order_acquire);
+	if(!(state & csDoubleDone))
+	{
+		double value = 0;
+		bool valid = ParseDouble(GetValueAt(Entry), value);
+		cache.Double.store(value, std::memory_order_relaxed);
+		state |= cache.State.fetch_or(csDoubleDone | (valid ? csDoubleValid : 0), std::memory_order_release) | csDoubleDone | (valid ? csDoubleValid : 0);
+	}
+	if(!(state & csDoubleValid)) return false;
+	Value = cache.Double.load(std::memory_order_relaxed);
+	return true;
+}
+
+/*!
+ * \brief Boolean value of an entry, converted once.
+ * \param Entry Index of the entry.
+ * \param Value Reference that will receive the boolean.
+ * \return True if the value is a boolean word.
+ */
+bool TConfigFile::CachedBool(std::size_t Entry, bool &Value) const
+{
+	TCache &cache = GetCache(Entry);
+	unsigned char state = cache.State.load(std::memory_order_acquire);
+	if(!(state & csBoolDone))
+	{
+		bool value = false;
+		bool valid = ParseBool(GetValueAt(Entry), value);
+		unsigned char flags = csBoolDone | (valid ? csBoolValid : 0) | (value ? csBoolValue : 0);
+		state |= cache.State.fetch_or(flags, std::memory_order_release) | flags;
+	}
+	if(!(state & csBoolValid)) return false;
+	Value = (state & csBoolValue) != 0;
+	return true;
+}
+
+/*!
+ * \brief Split the value of an entry in a list, trimming each item.
+ * \param Entry Index of the entry (npos if it doesn't exist).
+ * \param Values Vector that will receive the items (cleared first), as views of the value.
+ * \param Delimiter Character between the items.
+ * \return Number of items (an empty value has none).
+ */
+std::size_t TConfigFile::SplitList(std::size_t Entry, std::vector<std::string_view> &Values, char Delimiter) const
+{
+	Values.clear();
+	if(Entry == std::string::npos) return 0;
+	std::string_view value = GetValueAt(Entry);
+	if(value.empty()) return 0;
+	const char *p = value.data(), *end = value.data() + value.size();
+	while(true)
+	{
+		const char *d = (const char*)std::memchr(p, Delimiter, end - p);
+		const char *b = p, *e = (d != NULL) ? d : end;
+		while(b < e && IsBlank(*b)) b++;
+		while(e > b && IsBlank(e[-1])) e--;
+		Values.push_back(std::string_view(b, e - b));
+		if(d == NULL) break;
+		p = d + 1;
+	}
+	return Values.size();
 }
 
 //---------------------------------------------------------------------------
@@ -28,6 +828,12 @@ std::string TConfigFile::Trim(const char* Expression)
  */
 TConfigFile::TConfigFile()
 {
+	Keys = 0;
+	FileEntries = 0;
+	SourceText = 0;
+	DeadBytes = 0;
+	Cache.store(NULL);
+	Image = NULL;
 }
 
 /*!
@@ -36,7 +842,23 @@ TConfigFile::TConfigFile()
  */
 TConfigFile::TConfigFile(const TConfigFile &Copy)
 {
-	Parameters = Copy.Parameters;
+	Keys = 0;
+	Image = NULL;
+	SourceText = 0;  // the sources aren't copied
+	DeadBytes = 0;
+	if(Copy.Image != NULL) Materialize(*Copy.Image);  // the copy owns its parameters
+	else
+	{
+		Arena = Copy.Arena;
+		Entries = Copy.Entries;
+		Slots = Copy.Slots;
+		Keys = Copy.Keys;
+	}
+	FileEntries = Copy.FileEntries;
+	Cache.store(NULL);  // conversions are cached again on demand
+	Handles = Copy.Handles;
+	HandleIds = Copy.HandleIds;
+	HandleEntries = Copy.HandleEntries;
 }
 
 /*!
@@ -44,6 +866,8 @@ TConfigFile::TConfigFile(const TConfigFile &Copy)
  */
 TConfigFile::~TConfigFile()
 {
+	ResetCache();
+	ReleaseImage(false);
 }
 
 //---------------------------------------------------------------------------
@@ -55,7 +879,24 @@ TConfigFile::~TConfigFile()
  */
 const TConfigFile& TConfigFile::operator = (const TConfigFile &Copy)
 {
-	Parameters = Copy.Parameters;
+	if(this == &Copy) return *this;
+	ReleaseImage(false);
+	Sources.clear();
+	SourceText = 0;
+	DeadBytes = 0;
+	if(Copy.Image != NULL) Materialize(*Copy.Image);
+	else
+	{
+		Arena = Copy.Arena;
+		Entries = Copy.Entries;
+		Slots = Copy.Slots;
+		Keys = Copy.Keys;
+	}
+	FileEntries = Copy.FileEntries;
+	ResetCache();
+	Handles = Copy.Handles;
+	HandleIds = Copy.HandleIds;
+	HandleEntries = Copy.HandleEntries;
 	return *this;
 }
 
@@ -65,45 +906,852 @@ const TConfigFile& TConfigFile::operator = (const TConfigFile &Copy)
  * \brief Read a configuration file and parse the variables to this class, cleaning its container first.
  * \param ConfigFile File name (may include full pathname) to the configuration file to be parsed.
  * \return True if parsed the file successfully, false if it couldn't open the file (no error message will be thrown).
+ *
+ * Included files that can't be opened are ignored, but IsModified() reports when they appear.
+ * Files that didn't change since the last read are not parsed again.
  */
 bool TConfigFile::ReadFile(const char* ConfigFile)
 {
-    std::fstream file;
-    file.open(ConfigFile,std::fstream::in);
-    if(!file.is_open()) return false;
-    Parameters.clear();
-    while(!file.eof())
-    {
-        std::string line;
-        getline(file,line);
-        line = Trim(line.c_str());
-        if(line.empty()) continue;  // line em branco
-        if(line.substr(0,1) == "#") continue;  // comentrio
-        std::string::size_type pos = 0;
-		if((pos = line.find("=",pos)) == std::string::npos) continue;  // line invlida
-		std::string param,val;
-		param = Trim(line.substr(0,pos).c_str());
-		val = Trim(line.substr(pos+1).c_str());
-		Parameters.insert( std::pair<std::string,std::string>(param,val) );
-    }
-    file.close();
-    return true;
+	TPROFILE("TConfigFile::ReadFile");
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::absolute(ConfigFile, error);
+	if(error) return false;
+	std::string root = path.lexically_normal().string();
+	for(std::unordered_map<std::string,TSource>::iterator it = Sources.begin(); it != Sources.end(); it++) it->second.Used = false;
+	std::string previous;
+	previous.swap(Arena);
+	TSource *source = LoadSource(root, previous);
+	if(source == NULL)
+	{
+		Arena.swap(previous);
+		return false;
+	}
+	ReleaseImage(false);
+	Entries.clear();
+	Slots.clear();
+	Keys = 0;
+	Variables.clear();
+	std::vector<std::string> stack;
+	Flatten(root, *source, previous, stack);
+	FileEntries = Entries.size();
+	SourceText = Arena.size();
+	DeadBytes = 0;
+	Index(0);  // indexed at once, after the size is known
+	ResetCache();
+	ResolveHandles();
+	for(std::unordered_map<std::string,TSource>::iterator it = Sources.begin(); it != Sources.end(); )
+	{
+		if(it->second.Used) it++;
+		else it = Sources.erase(it);  // no longer included
+	}
+	return true;
+}
+
+/*!
+ * \brief Check if any file read by the last ReadFile() (or compiled into the image read by ReadCache()) changed since then.
+ * \return True if a file or an environment variable referenced by the files changed, or if no file was read yet.
+ */
+bool TConfigFile::IsModified() const
+{
+	if(Image != NULL) return !ImageIsCurrent(NULL);
+	if(Sources.empty()) return true;
+	for(std::unordered_map<std::string,TSource>::const_iterator it = Sources.begin(); it != Sources.end(); it++)
+	{
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(it->first, error);
+		if(!it->second.Exists)  // a missing include changed only if it appeared (or an unreadable one was written)
+		{
+			if(!error && time != it->second.Time) return true;
+			continue;
+		}
+		if(error || time != it->second.Time) return true;
+		std::uintmax_t size = std::filesystem::file_size(it->first, error);
+		if(error || size != it->second.Size) return true;
+	}
+	for(std::map<std::string,std::string>::const_iterator it = Variables.begin(); it != Variables.end(); it++)
+	{
+		const char *value = std::getenv(it->first.c_str());
+		if(it->second != ((value != NULL) ? value : "")) return true;
+	}
+	return false;
+}
+
+/*!
+ * \brief Merge the current values into the text of a file, following its includes (see WriteFile()).
+ * \param Path Normalized path of the file.
+ * \param Output String that will receive the merged text (appended).
+ * \param Section String that will receive the section at the end of the file.
+ * \param Next Next entry of each name already matched (names are matched to their lines in order).
+ * \param Written Flags of the entries matched to a line.
+ * \param Stack Paths being merged (an include of one of them is ignored, as in Flatten()).
+ * \param Includes Map that will receive the merged text of each included file that changed, by path (the first merge of a file included again).
+ * \return False if the file couldn't be read.
+ */
+bool TConfigFile::Merge(const std::string &Path, std::string &Output, std::string &Section, std::unordered_map<std::string,std::size_t> &Next, std::vector<bool> &Written, std::vector<std::string> &Stack, std::map<std::string,std::string> &Includes) const
+{
+	const char *data;
+	std::size_t size;
+	void *handle;
+	if(!MapFile(Path.c_str(), data, size, handle)) return false;
+	Stack.push_back(Path);
+	Section.clear();
+	Output.reserve(Output.size() + size + size / 8);
+	std::string key, value;
+	const char *p = data, *end = data + size;
+	while(p < end)
+	{
+		const char *eol = (const char*)std::memchr(p, '\n', end - p);
+		eol = (eol == NULL) ? end : eol + 1;
+		const char *line = p, *b = p, *e = eol;
+		p = eol;
+		while(b < e && IsBlank(*b)) b++;
+		while(e > b && IsBlank(e[-1])) e--;
+		const char *eq = (b < e && *b != '#') ? (const char*)std::memchr(b, '=', e - b) : NULL;
+		if(eq == NULL)  // blank line, comment, section, include or invalid line
+		{
+			if(!ParseSection(b, e, Section) && e - b > 8 && std::memcmp(b, "include", 7) == 0 && IsBlank(b[7]))
+			{
+				const char *ib = b + 8;
+				while(ib < e && IsBlank(*ib)) ib++;
+				Interpolate(std::string_view(ib, e - ib), value);
+				std::filesystem::path target(value);
+				if(target.is_relative()) target = std::filesystem::path(Path).parent_path() / target;
+				std::string include = target.lexically_normal().string();
+				std::string text, section;
+				if(std::find(Stack.begin(), Stack.end(), include) == Stack.end()) Merge(include, text, section, Next, Written, Stack, Includes);  // missing files are kept as they are
+			}
+			Output.append(line, eol - line);
+			continue;
+		}
+		const char *ke = eq, *vb = eq + 1;
+		while(ke > b && IsBlank(ke[-1])) ke--;
+		while(vb < e && IsBlank(*vb)) vb++;
+		key.assign(Section);
+		key.append(b, ke - b);
+		std::unordered_map<std::string,std::size_t>::iterator it = Next.find(key);
+		std::size_t index = (it != Next.end()) ? it->second : FindEntry(key);
+		if(index == std::string::npos) continue;  // removed
+		Next[key] = GetEntry(index).Next;
+		Written[index] = true;
+		std::string_view current = GetValueAt(index), original(vb, e - vb);
+		if(original.find("${") != std::string_view::npos)
+		{
+			Interpolate(original, value);
+			if(value == current) original = current;
+		}
+		if(original == current) Output.append(line, eol - line);
+		else
+		{
+			Output.append(line, vb - line);  // name, blanks and '=' as they were
+			Output.append(current.data(), current.size());
+			Output.append(e, eol - e);       // line ending as it was
+		}
+	}
+	if(!Output.empty() && Output.back() != '\n') Output += '\n';
+	bool changed = Output.size() != size || std::memcmp(Output.data(), data, size) != 0;
+	UnmapFile(data, size, handle);
+	Stack.pop_back();
+	if(changed && !Stack.empty() && !Includes.count(Path)) Includes[Path] = Output;  // unchanged includes aren't written
+	return true;
 }
 
 /*!
  * \brief Write the parameters and their values in a standard way to a output file.
  * \param ConfigFile File name (may include full pathname) to the configuration file to be written.
- * \return True if wrote the configuration file, false if it couldn't open the file for output (no error message will be thrown).
- */
-bool TConfigFile::WriteFile(const char* ConfigFile)
-{
-    std::fstream file;
-    file.open(ConfigFile,std::fstream::out);
-    if(!file.is_open()) return false;
-    for(std::multimap<std::string,std::string>::iterator it = Parameters.begin(); it != Parameters.end(); it++)
-    {
-        file << it->first << " = " << it->second << std::endl;
-    }
-    file.close();
-    return true;
+ * \param RoundTrip True to keep the comments, blank lines and order of the existing file and of the
+ * files it includes, rewriting only the lines whose values changed (parameters that no longer exist
+ * are removed, and the ones added after the read are appended at the end of the file).
+ * \return True if wrote the configuration file (and the included files that changed), false if
+ * it couldn't write them (no error message will be thrown).
+ *
+ * Each output is built in memory and replaces its file atomically (see WriteAtomic), so a
+ * failure never leaves a half-written file. In round trip mode, repeated names are matched to
+ * their lines in order (following the includes, as they were read), values with environment
+ * references are kept while they still expand to the current value, and values changed in an
+ * included file are written back to that file (the included files are written first).
+ */
+bool TConfigFile::WriteFile(const char* ConfigFile, bool RoundTrip) const
+{
+	std::string output, section;
+	std::vector<bool> written(GetCount(), false);
+	std::map<std::string,std::string> includes;
+	bool merged = false;
+	if(RoundTrip)  // a missing file is written whole
+	{
+		std::error_code error;
+		std::filesystem::path path = std::filesystem::absolute(ConfigFile, error);
+		std::unordered_map<std::string,std::size_t> next;
+		std::vector<std::string> stack;
+		merged = !error && Merge(path.lexically_normal().string(), output, section, next, written, stack, includes);
+		if(!merged) output.clear();
+	}
+	if(!merged)
+	{
+		std::size_t total = 0;
+		for(std::size_t i = 0; i < GetCount(); i++) total += GetEntry(i).KeySize + GetEntry(i).ValueSize + 4;
+		output.reserve(total);
+	}
+	for(std::size_t i = merged ? FileEntries : 0; i < GetCount(); i++)
+	{
+		if(written[i]) continue;
+		if(!section.empty())  // appended names have their full names, outside the last section
+		{
+			output.append("[]\n");
+			section.clear();
+		}
+		std::string_view key = GetKeyAt(i), value = GetValueAt(i);
+		output.append(key.data(), key.size());
+		output.append(" = ");
+		output.append(value.data(), value.size());
+		output += '\n';
+	}
+	for(std::map<std::string,std::string>::const_iterator it = includes.begin(); it != includes.end(); it++)
+	{
+		if(!WriteAtomic(it->first.c_str(), it->second)) return false;
+	}
+	return WriteAtomic(ConfigFile, output);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Header of a compiled image, followed by the entries, the table, the displacements,
+ * the source records, the variable records and the text (each part aligned to 8 bytes).
+ */
+struct TImageHeader
+{
+	char Magic[8];               /*!< "TCFGIMG" and a null. */
+	std::uint32_t Version;       /*!< Version of the format. */
+	std::uint32_t EntrySize;     /*!< Size of each entry (an image from another platform is rejected). */
+	std::uint64_t Endian;        /*!< 0x0102030405060708, in the byte order of the platform. */
+	std::uint64_t Checksum;      /*!< Hash of everything after the header. */
+	std::uint64_t Count;         /*!< Number of entries. */
+	std::uint64_t TableSize;     /*!< Size of the perfect hash table. */
+	std::uint64_t Buckets;       /*!< Number of displacements. */
+	std::uint64_t SourceCount;   /*!< Number of source records. */
+	std::uint64_t SourcesSize;   /*!< Size of the source records. */
+	std::uint64_t VariableCount; /*!< Number of variable records. */
+	std::uint64_t VariablesSize; /*!< Size of the variable records. */
+	std::uint64_t TextSize;      /*!< Size of the text. */
+};
+
+static const char ImageMagic[8] = { 'T', 'C', 'F', 'G', 'I', 'M', 'G', '\0' };
+static const std::uint32_t ImageVersion = 2;
+static const std::uint64_t MissingSize = (std::uint64_t)-1;  /*!< Size of the record of an include that couldn't be read. */
+
+/*!
+ * \brief Round a size up to a multiple of 8.
+ * \param Size Size to be rounded.
+ * \return Rounded size.
+ */
+static inline std::size_t Align8(std::size_t Size)
+{
+	return (Size + 7) & ~(std::size_t)7;
+}
+
+/*!
+ * \brief Copy the parameters of an image to the arena and the entries, indexing them again.
+ * \param Source Mapped image.
+ */
+void TConfigFile::Materialize(const TImage &Source)
+{
+	Arena.assign(Source.Text, Source.TextSize);
+	Entries.assign(Source.Entries, Source.Entries + Source.Count);
+	SourceText = 0;  // not shared with sources, but the dead bytes of the image aren't known
+	DeadBytes = 0;
+	Slots.clear();
+	Keys = 0;
+	Index(0);
+}
+
+/*!
+ * \brief Unmap the image, if there's one.
+ * \param Keep True to copy its parameters to the arena first (before they are changed).
+ */
+void TConfigFile::ReleaseImage(bool Keep)
+{
+	if(Image == NULL) return;
+	if(Keep) Materialize(*Image);
+	UnmapFile(Image->Data, Image->Size, Image->Handle);
+	delete Image;
+	Image = NULL;
+}
+
+/*!
+ * \brief Check the source files and environment variables recorded in the image.
+ * \param Path Normalized path of a file that must be one of the sources (NULL to skip).
+ * \return True if no source file or variable changed since the image was compiled.
+ */
+bool TConfigFile::ImageIsCurrent(const char *Path) const
+{
+	bool found = (Path == NULL);
+	const char *p = Image->Sources;
+	for(std::size_t i = 0; i < Image->SourceCount; i++)
+	{
+		std::uint64_t record[3];  // time, size (MissingSize for a missing include) and path size
+		std::memcpy(record, p, sizeof(record));
+		std::string source(p + sizeof(record), (std::size_t)record[2]);
+		p += sizeof(record) + Align8((std::size_t)record[2]);
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(source, error);
+		if(record[1] == MissingSize)
+		{
+			if(!error && (std::uint64_t)time.time_since_epoch().count() != record[0]) return false;
+			continue;
+		}
+		if(error || (std::uint64_t)time.time_since_epoch().count() != record[0]) return false;
+		std::uintmax_t size = std::filesystem::file_size(source, error);
+		if(error || size != record[1]) return false;
+		if(!found && source == Path) found = true;
+	}
+	p = Image->Variables;
+	for(std::size_t i = 0; i < Image->VariableCount; i++)
+	{
+		std::uint64_t record[2];  // name size and value size
+		std::memcpy(record, p, sizeof(record));
+		std::string name(p + sizeof(record), (std::size_t)record[0]);
+		std::string_view value(p + sizeof(record) + record[0], (std::size_t)record[1]);
+		p += sizeof(record) + Align8((std::size_t)(record[0] + record[1]));
+		const char *current = std::getenv(name.c_str());
+		if(value != ((current != NULL) ? current : "")) return false;
+	}
+	return found;
+}
+
+/*!
+ * \brief Compile the parameters into a binary image, to be read by ReadCache().
+ * \param CacheFile File name (may include full pathname) of the image.
+ * \return True if the image was written, false if it couldn't be written (no error message will be thrown).
+ *
+ * The image records the files read (with their times and sizes), the includes that were missing
+ * and the environment variables referenced (with their values, since the image keeps the expanded
+ * values), so it's rejected after any of them changes or appears. It's written to a temporary file and renamed, so readers never see it half-written.
+ */
+bool TConfigFile::WriteCache(const char* CacheFile) const
+{
+	// first entry of each name (the entries that no other entry chains to)
+	std::vector<bool> chained(GetCount(), false);
+	for(std::size_t i = 0; i < GetCount(); i++)
+	{
+		if(GetEntry(i).Next != std::string::npos) chained[GetEntry(i).Next] = true;
+	}
+	std::vector<std::size_t> heads;
+	std::vector<std::uint64_t> hashes;
+	for(std::size_t i = 0; i < GetCount(); i++)
+	{
+		if(chained[i]) continue;
+		heads.push_back(i);
+		hashes.push_back(GetEntry(i).Hash);
+	}
+
+	// perfect hash (hash and displace): buckets are placed from the largest, each with the
+	// first displacement that sends all its names to free slots; the table grows if one fails
+	std::size_t n = heads.size();
+	std::size_t buckets = n / 2 + 1, tableSize = n + n / 4 + 1;
+	std::vector<std::uint32_t> displacements;
+	std::vector<std::uint64_t> table;
+	std::vector<std::size_t> order(n), start(buckets + 1), sorted(buckets), slots;
+	for(std::size_t i = 0; i < n; i++) start[(std::size_t)((hashes[i] >> 32) % buckets) + 1]++;
+	for(std::size_t b = 0; b < buckets; b++) start[b + 1] += start[b];
+	std::vector<std::size_t> fill(start.begin(), start.end() - 1);
+	for(std::size_t i = 0; i < n; i++) order[fill[(std::size_t)((hashes[i] >> 32) % buckets)]++] = i;
+	for(std::size_t b = 0; b < buckets; b++) sorted[b] = b;
+	std::stable_sort(sorted.begin(), sorted.end(), [&start](std::size_t a, std::size_t b) { return start[a + 1] - start[a] > start[b + 1] - start[b]; });
+	for(bool placed = false; !placed; tableSize += tableSize / 8 + 1)
+	{
+		if(tableSize > 4 * n + 64) return false;  // only if two names have the same 64-bit hash
+		displacements.assign(buckets, 0);
+		table.assign(tableSize, (std::uint64_t)-1);
+		placed = true;
+		for(std::size_t k = 0; k < buckets && placed; k++)
+		{
+			std::size_t b = sorted[k];
+			if(start[b + 1] == start[b]) break;
+			placed = false;
+			for(std::uint32_t d = 0; d < (1U << 20) && !placed; d++)
+			{
+				slots.clear();
+				placed = true;
+				for(std::size_t i = start[b]; i < start[b + 1] && placed; i++)
+				{
+					std::size_t slot = ImageSlot(hashes[order[i]], d, tableSize);
+					placed = table[slot] == (std::uint64_t)-1 && std::find(slots.begin(), slots.end(), slot) == slots.end();
+					slots.push_back(slot);
+				}
+				if(!placed) continue;
+				displacements[b] = d;
+				for(std::size_t i = start[b]; i < start[b + 1]; i++) table[slots[i - start[b]]] = heads[order[i]];
+			}
+		}
+		if(placed) break;
+	}
+	if(n == 0) tableSize = 0, table.clear();
+
+	// source records
+	std::string sources;
+	std::size_t sourceCount = 0;
+	if(Image != NULL)
+	{
+		const char *p = Image->Sources;
+		for(std::size_t i = 0; i < Image->SourceCount; i++)
+		{
+			std::uint64_t record[3];
+			std::memcpy(record, p, sizeof(record));
+			p += sizeof(record) + Align8((std::size_t)record[2]);
+		}
+		sources.assign(Image->Sources, p - Image->Sources);
+		sourceCount = Image->SourceCount;
+	}
+	for(std::unordered_map<std::string,TSource>::const_iterator it = Sources.begin(); it != Sources.end(); it++)
+	{
+		std::uint64_t record[3] = { (std::uint64_t)it->second.Time.time_since_epoch().count(), it->second.Exists ? (std::uint64_t)it->second.Size : MissingSize, (std::uint64_t)it->first.size() };
+		sources.append((const char*)record, sizeof(record));
+		sources.append(it->first);
+		sources.append(Align8(it->first.size()) - it->first.size(), '\0');
+		sourceCount++;
+	}
+
+	// variable records
+	std::string variables;
+	std::size_t variableCount = 0;
+	if(Image != NULL)
+	{
+		const char *p = Image->Variables;
+		for(std::size_t i = 0; i < Image->VariableCount; i++)
+		{
+			std::uint64_t record[2];
+			std::memcpy(record, p, sizeof(record));
+			p += sizeof(record) + Align8((std::size_t)(record[0] + record[1]));
+		}
+		variables.assign(Image->Variables, p - Image->Variables);
+		variableCount = Image->VariableCount;
+	}
+	for(std::map<std::string,std::string>::const_iterator it = Variables.begin(); it != Variables.end(); it++)
+	{
+		std::uint64_t record[2] = { (std::uint64_t)it->first.size(), (std::uint64_t)it->second.size() };
+		variables.append((const char*)record, sizeof(record));
+		variables.append(it->first);
+		variables.append(it->second);
+		variables.append(Align8(it->first.size() + it->second.size()) - it->first.size() - it->second.size(), '\0');
+		variableCount++;
+	}
+
+	// image, built in memory
+	TImageHeader header;
+	std::memcpy(header.Magic, ImageMagic, sizeof(ImageMagic));
+	header.Version = ImageVersion;
+	header.EntrySize = sizeof(TEntry);
+	header.Endian = 0x0102030405060708ULL;
+	header.Count = GetCount();
+	header.TableSize = table.size();
+	header.Buckets = buckets;
+	header.SourceCount = sourceCount;
+	header.SourcesSize = sources.size();
+	header.VariableCount = variableCount;
+	header.VariablesSize = variables.size();
+	header.TextSize = (Image != NULL) ? Image->TextSize : Arena.size();
+	std::string image;
+	image.reserve(sizeof(header) + GetCount() * sizeof(TEntry) + table.size() * 8 + Align8(buckets * 4) + sources.size() + variables.size() + header.TextSize);
+	image.append((const char*)&header, sizeof(header));
+	if(GetCount() > 0) image.append((const char*)&GetEntry(0), GetCount() * sizeof(TEntry));
+	if(!table.empty()) image.append((const char*)table.data(), table.size() * sizeof(std::uint64_t));
+	image.append((const char*)displacements.data(), buckets * sizeof(std::uint32_t));
+	image.append(Align8(image.size()) - image.size(), '\0');
+	image.append(sources);
+	image.append(variables);
+	image.append(GetText(), (std::size_t)header.TextSize);
+	header.Checksum = HashBytes(image.data() + sizeof(header), image.size() - sizeof(header));
+	std::memcpy(&image[0], &header, sizeof(header));
+
+	return WriteAtomic(CacheFile, image);
+}
+
+/*!
+ * \brief Read the parameters from a compiled image, which is mapped and queried in place.
+ * \param CacheFile File name (may include full pathname) of the image written by WriteCache().
+ * \param ConfigFile File from which the image must have been compiled (NULL to accept any).
+ * \return True if the image was read, false if it couldn't be opened, is invalid (wrong version,
+ * platform or checksum), any of its source files or environment variables changed or it came from another file (the
+ * parameters are kept).
+ *
+ * Parameters changed later are first copied from the image to memory.
+ */
+bool TConfigFile::ReadCache(const char* CacheFile, const char* ConfigFile)
+{
+	TPROFILE("TConfigFile::ReadCache");
+	std::string root;
+	if(ConfigFile != NULL)
+	{
+		std::error_code error;
+		std::filesystem::path path = std::filesystem::absolute(ConfigFile, error);
+		if(error) return false;
+		root = path.lexically_normal().string();
+	}
+	TImage image;
+	if(!MapFile(CacheFile, image.Data, image.Size, image.Handle)) return false;
+	TImageHeader header;
+	bool valid = image.Size >= sizeof(header);
+	if(valid)
+	{
+		std::memcpy(&header, image.Data, sizeof(header));
+		valid = std::memcmp(header.Magic, ImageMagic, sizeof(ImageMagic)) == 0 && header.Version == ImageVersion && header.EntrySize == sizeof(TEntry) && header.Endian == 0x0102030405060708ULL;
+	}
+	std::size_t entries = 0, table = 0, displacements = 0, sources = 0, variables = 0, text = 0;
+	if(valid)
+	{
+		entries = sizeof(header);
+		table = entries + (std::size_t)header.Count * sizeof(TEntry);
+		displacements = table + (std::size_t)header.TableSize * sizeof(std::uint64_t);
+		sources = Align8(displacements + (std::size_t)header.Buckets * sizeof(std::uint32_t));
+		variables = sources + (std::size_t)header.SourcesSize;
+		text = variables + (std::size_t)header.VariablesSize;
+		valid = header.Buckets > 0 && text + header.TextSize == image.Size && HashBytes(image.Data + sizeof(header), image.Size - sizeof(header)) == header.Checksum;
+	}
+	if(valid)
+	{
+		image.Entries = (const TEntry*)(image.Data + entries);
+		image.Count = (std::size_t)header.Count;
+		image.Table = (const std::uint64_t*)(image.Data + table);
+		image.TableSize = (std::size_t)header.TableSize;
+		image.Displacements = (const std::uint32_t*)(image.Data + displacements);
+		image.Buckets = (std::size_t)header.Buckets;
+		image.Sources = image.Data + sources;
+		image.SourceCount = (std::size_t)header.SourceCount;
+		image.Variables = image.Data + variables;
+		image.VariableCount = (std::size_t)header.VariableCount;
+		image.Text = image.Data + text;
+		image.TextSize = (std::size_t)header.TextSize;
+		TImage *current = Image;
+		Image = &image;  // temporarily, to check the sources
+		valid = ImageIsCurrent((ConfigFile != NULL) ? root.c_str() : NULL);
+		Image = current;
+	}
+	if(!valid)
+	{
+		UnmapFile(image.Data, image.Size, image.Handle);
+		return false;
+	}
+	Clear();
+	Image = new TImage(image);
+	FileEntries = image.Count;
+	ResetCache();
+	ResolveHandles();
+	return true;
+}
+
+/*!
+ * \brief Read a configuration file through its compiled image, compiling it again if needed.
+ * \param ConfigFile File name (may include full pathname) to the configuration file.
+ * \param CacheFile File name (may include full pathname) of the image.
+ * \return True if the parameters were read from the image or from the file, false if neither could be read.
+ *
+ * The image is used if it was compiled from the same file and no source file changed since.
+ * Otherwise the file is read as text and the image is written again (a failure to write it
+ * only costs the next start).
+ */
+bool TConfigFile::ReadFile(const char* ConfigFile, const char* CacheFile)
+{
+	if(ReadCache(CacheFile, ConfigFile)) return true;
+	if(!ReadFile(ConfigFile)) return false;
+	WriteCache(CacheFile);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Remove all parameters.
+ */
+void TConfigFile::Clear()
+{
+	ReleaseImage(false);
+	Arena.clear();
+	Sources.clear();  // their text was in the arena
+	Variables.clear();
+	Entries.clear();
+	Slots.clear();
+	Keys = 0;
+	FileEntries = 0;
+	SourceText = 0;
+	DeadBytes = 0;
+	ResetCache();
+	ResolveHandles();
+}
+
+/*!
+ * \brief Number of parameters (counting repeated names).
+ * \return Number of parameters.
+ */
+std::size_t TConfigFile::GetCount() const
+{
+	return (Image != NULL) ? Image->Count : Entries.size();
+}
+
+/*!
+ * \brief Name of a parameter, in file order.
+ * \param Index Index of the parameter (from 0 to GetCount()-1).
+ * \return Name of the parameter (valid until the parameters are changed).
+ */
+std::string_view TConfigFile::GetKeyAt(std::size_t Index) const
+{
+	const TEntry &entry = GetEntry(Index);
+	return std::string_view(GetText() + entry.Key, entry.KeySize);
+}
+
+/*!
+ * \brief Value of a parameter, in file order.
+ * \param Index Index of the parameter (from 0 to GetCount()-1).
+ * \return Value of the parameter (valid until the parameters are changed).
+ */
+std::string_view TConfigFile::GetValueAt(std::size_t Index) const
+{
+	const TEntry &entry = GetEntry(Index);
+	return std::string_view(GetText() + entry.Value, entry.ValueSize);
+}
+
+/*!
+ * \brief Check if a parameter exists.
+ * \param Key Parameter name.
+ * \return True if there's at least one parameter with the name.
+ */
+bool TConfigFile::HasKey(std::string_view Key) const
+{
+	return FindEntry(Key) != std::string::npos;
+}
+
+/*!
+ * \brief Value of a parameter (the first one, if the name is repeated).
+ * \param Key Parameter name.
+ * \param Default Value returned if the parameter doesn't exist.
+ * \return Value of the parameter (valid until the parameters are changed).
+ */
+std::string_view TConfigFile::GetValue(std::string_view Key, std::string_view Default) const
+{
+	std::size_t index = FindEntry(Key);
+	return (index == std::string::npos) ? Default : GetValueAt(index);
+}
+
+/*!
+ * \brief All values of a repeated parameter, in file order.
+ * \param Key Parameter name.
+ * \param Values Vector that will receive the values (cleared first).
+ * \return Number of values.
+ */
+std::size_t TConfigFile::GetValues(std::string_view Key, std::vector<std::string_view> &Values) const
+{
+	Values.clear();
+	for(std::size_t index = FindEntry(Key); index != std::string::npos; index = GetEntry(index).Next)
+	{
+		Values.push_back(GetValueAt(index));
+	}
+	return Values.size();
+}
+
+/*!
+ * \brief Add a parameter, even if the name already exists (as the multimap insert).
+ * \param Key Parameter name.
+ * \param Value Parameter value.
+ */
+void TConfigFile::AddValue(std::string_view Key, std::string_view Value)
+{
+	std::string key(Key), value(Value);  // the views may point into the arena, which may grow
+	ReleaseImage(true);
+	Insert(key, value);
+}
+
+/*!
+ * \brief Change the value of a parameter (the first one, if the name is repeated), adding it if it doesn't exist.
+ * \param Key Parameter name.
+ * \param Value Parameter value.
+ *
+ * A value set before is overwritten in place when the new one fits. Otherwise the new value is
+ * appended to the arena, and the arena is compacted when more than half of what was added after
+ * the read is dead, so repeated changes don't make it grow without bound.
+ */
+void TConfigFile::SetValue(std::string_view Key, std::string_view Value)
+{
+	std::string key(Key), value(Value);  // the views may point into the arena, which may grow
+	ReleaseImage(true);
+	std::size_t index = FindEntry(key);
+	if(index == std::string::npos)
+	{
+		Insert(key, value);
+		return;
+	}
+	TEntry &entry = Entries[index];
+	if(entry.Value >= SourceText && value.size() <= entry.ValueSize)  // not shared with the sources, so it can be overwritten
+	{
+		std::memcpy(&Arena[entry.Value], value.data(), value.size());
+		DeadBytes += entry.ValueSize - value.size();
+	}
+	else
+	{
+		if(entry.Value >= SourceText) DeadBytes += entry.ValueSize;
+		entry.Value = Arena.size();
+		Arena.append(value);
+	}
+	entry.ValueSize = value.size();
+	if(DeadBytes > 4096 && DeadBytes > (Arena.size() - SourceText) / 2) Compact();
+	TCache *cache = Cache.load();
+	if(cache != NULL) cache[index].State.store(0);  // converted again at the next typed read
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Integer value of a parameter (the first one, if the name is repeated), converted only once.
+ * \param Key Parameter name.
+ * \param Value Reference that will receive the integer (unchanged if the function fails).
+ * \return True if the parameter exists and is an integer.
+ */
+bool TConfigFile::GetInt(std::string_view Key, long long &Value) const
+{
+	std::size_t index = FindEntry(Key);
+	return index != std::string::npos && CachedInt(index, Value);
+}
+
+/*!
+ * \brief Double value of a parameter (the first one, if the name is repeated), converted only once.
+ * \param Key Parameter name.
+ * \param Value Reference that will receive the double (unchanged if the function fails).
+ * \return True if the parameter exists and is a number.
+ */
+bool TConfigFile::GetDouble(std::string_view Key, double &Value) const
+{
+	std::size_t index = FindEntry(Key);
+	return index != std::string::npos && CachedDouble(index, Value);
+}
+
+/*!
+ * \brief Boolean value of a parameter (true/false, yes/no, on/off or 1/0), converted only once.
+ * \param Key Parameter name.
+ * \param Value Reference that will receive the boolean (unchanged if the function fails).
+ * \return True if the parameter exists and is a boolean word.
+ */
+bool TConfigFile::GetBool(std::string_view Key, bool &Value) const
+{
+	std::size_t index = FindEntry(Key);
+	return index != std::string::npos && CachedBool(index, Value);
+}
+
+/*!
+ * \brief Items of a list parameter, such as "a, b, c".
+ * \param Key Parameter name.
+ * \param Values Vector that will receive the trimmed items (cleared first), as views valid until the parameters are changed.
+ * \param Delimiter Character between the items.
+ * \return Number of items (zero if the parameter doesn't exist or is empty).
+ */
+std::size_t TConfigFile::GetList(std::string_view Key, std::vector<std::string_view> &Values, char Delimiter) const
+{
+	return SplitList(FindEntry(Key), Values, Delimiter);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Intern a parameter name, so later reads skip the hash lookup.
+ * \param Key Parameter name (it doesn't need to exist yet).
+ * \return Handle of the name, valid for the life of the object.
+ */
+TConfigFile::THandle TConfigFile::GetHandle(std::string_view Key)
+{
+	std::string key(Key);
+	THandle handle;
+	std::unordered_map<std::string,std::size_t>::const_iterator it = HandleIds.find(key);
+	if(it != HandleIds.end())
+	{
+		handle.Id = it->second;
+		return handle;
+	}
+	handle.Id = Handles.size();
+	HandleIds[key] = handle.Id;
+	Handles.push_back(key);
+	HandleEntries.push_back(FindEntry(key));
+	return handle;
+}
+
+/*!
+ * \brief Check if an interned parameter exists.
+ * \param Handle Handle of the name.
+ * \return True if there's at least one parameter with the name.
+ */
+bool TConfigFile::HasKey(THandle Handle) const
+{
+	return HandleEntries[Handle.Id] != std::string::npos;
+}
+
+/*!
+ * \brief Value of an interned parameter (the first one, if the name is repeated).
+ * \param Handle Handle of the name.
+ * \param Default Value returned if the parameter doesn't exist.
+ * \return Value of the parameter (valid until the parameters are changed).
+ */
+std::string_view TConfigFile::GetValue(THandle Handle, std::string_view Default) const
+{
+	std::size_t index = HandleEntries[Handle.Id];
+	return (index == std::string::npos) ? Default : GetValueAt(index);
+}
+
+/*!
+ * \brief Integer value of an interned parameter (see the version by name).
+ */
+bool TConfigFile::GetInt(THandle Handle, long long &Value) const
+{
+	std::size_t index = HandleEntries[Handle.Id];
+	return index != std::string::npos && CachedInt(index, Value);
+}
+
+/*!
+ * \brief Double value of an interned parameter (see the version by name).
+ */
+bool TConfigFile::GetDouble(THandle Handle, double &Value) const
+{
+	std::size_t index = HandleEntries[Handle.Id];
+	return index != std::string::npos && CachedDouble(index, Value);
+}
+
+/*!
+ * \brief Boolean value of an interned parameter (see the version by name).
+ */
+bool TConfigFile::GetBool(THandle Handle, bool &Value) const
+{
+	std::size_t index = HandleEntries[Handle.Id];
+	return index != std::string::npos && CachedBool(index, Value);
+}
+
+/*!
+ * \brief Items of an interned list parameter (see the version by name).
+ */
+std::size_t TConfigFile::GetList(THandle Handle, std::vector<std::string_view> &Values, char Delimiter) const
+{
+	return SplitList(HandleEntries[Handle.Id], Values, Delimiter);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Copy the parameters to a multimap (the container used by older versions of this class).
+ * \return Multimap with the parameters, with repeated names in file order.
+ */
+std::multimap<std::string,std::string> TConfigFile::GetParameters() const
+{
+	std::multimap<std::string,std::string> parameters;
+	for(std::size_t i = 0; i < GetCount(); i++)
+	{
+		parameters.insert(std::pair<std::string,std::string>(std::string(GetKeyAt(i)), std::string(GetValueAt(i))));
+	}
+	return parameters;
+}
+
+/*!
+ * \brief Replace the parameters by the contents of a multimap (the container used by older versions of this class).
+ * \param Parameters Multimap with the parameters.
+ */
+void TConfigFile::SetParameters(const std::multimap<std::string,std::string> &Parameters)
+{
+	Clear();
+	for(std::multimap<std::string,std::string>::const_iterator it = Parameters.begin(); it != Parameters.end(); it++)
+	{
+		Insert(it->first, it->second);
+	}
 }
@@ -1,23 +1,169 @@
 #ifndef TConfigFileH
 #define TConfigFileH
 
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
 #include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 //---------------------------------------------------------------------------
 
 /*!
  * \brief Class to read configuration files in a Linux style.
+ *
+ * The file is memory-mapped and parsed in a single pass. Names and values are packed into a
+ * single arena (one allocation for the whole file), the entries keep their file order and
+ * refer to the arena by offsets, and names are indexed by an open-addressing hash table.
+ * Repeated names are allowed (as in the multimap this class used before), and are chained
+ * in file order.
+ *
+ * Typed getters (GetInt, GetDouble, GetBool) convert each value only once: the results are
+ * cached per entry, with atomics, so concurrent readers are safe. Names used in hot paths can
+ * be interned with GetHandle(), and then each read is a single array index.
+ *
+ * Besides flat "Name = Value" lines, files may have "[section]" headers (the following names
+ * are stored as "section.Name"), "include path" lines (relative paths start at the directory
+ * of the including file, and each file starts outside any section) and "${VARIABLE}" or
+ * "${VARIABLE:-default}" references to environment variables in values and include paths.
+ * Everything is flattened into the same index. Each file read is kept parsed, with its time,
+ * size and a hash of its contents, so reading again only parses the files that changed.
+ *
+ * The parameters can also be compiled into a binary image (WriteCache), which later starts map
+ * and query in place (ReadCache), with a perfect hash index and no parsing. The image records
+ * the files it came from and the environment variables they referenced, and is rejected if any
+ * of them changed, so ReadFile(ConfigFile, CacheFile) falls back to the text files and compiles
+ * the image again.
  */
 class TConfigFile
 {
+public:
+	struct THandle  /*!< Interned parameter name (valid for the life of the object, even after the file is read again). */
+	{
+		std::size_t Id;  /*!< Index of the name in the interned names. */
+	};
+
 private:
+	struct TEntry  /*!< Parameter (name and value) stored in the arena. */
+	{
+		std::size_t Key;        /*!< Offset of the name in the arena. */
+		std::size_t KeySize;    /*!< Size of the name. */
+		std::size_t Value;      /*!< Offset of the value in the arena. */
+		std::size_t ValueSize;  /*!< Size of the value. */
+		std::uint64_t Hash;     /*!< Hash of the name. */
+		std::size_t Next;       /*!< Next entry with the same name (npos if it's the last). */
+		std::size_t Last;       /*!< Last entry with the same name (only kept in the first one). */
+	};
+
+	struct TSlot  /*!< Slot of the index (the hash is repeated here so probing doesn't touch the entries). */
+	{
+		std::uint64_t Hash;  /*!< Hash of the name. */
+		std::size_t Entry;   /*!< First entry with the name (npos if the slot is empty). */
+	};
+
+	std::string Arena;            /*!< Characters of all names and values. */
+	std::vector<TEntry> Entries;  /*!< Parameters, in file order. */
+	std::vector<TSlot> Slots;     /*!< Open-addressing index of the names (size is a power of two). */
+	std::size_t Keys;             /*!< Number of distinct names. */
+	std::size_t FileEntries;      /*!< Number of entries read from files (the others were added later). */
+	std::size_t SourceText;       /*!< Size of the start of the arena shared with the sources (never overwritten, since the next read copies it). */
+	std::size_t DeadBytes;        /*!< Bytes after SourceText no longer used by any entry (reclaimed by Compact()). */
+
+	struct TCache  /*!< Cached conversions of a value. */
+	{
+		std::atomic<unsigned char> State;  /*!< Conversions done and their results (see the ECacheState flags). */
+		std::atomic<long long> Int;        /*!< Value converted to integer. */
+		std::atomic<double> Double;        /*!< Value converted to double. */
+	};
+	enum ECacheState  /*!< Flags of TCache::State. */
+	{
+		csIntDone = 1, csIntValid = 2, csDoubleDone = 4, csDoubleValid = 8, csBoolDone = 16, csBoolValid = 32, csBoolValue = 64
+	};
+	mutable std::atomic<TCache*> Cache;  /*!< Cached conversions, one per entry (created at the first typed read). */
+
+	std::vector<std::string> Handles;       /*!< Interned names. */
+	std::unordered_map<std::string,std::size_t> HandleIds;  /*!< Handle of each interned name. */
+	std::vector<std::size_t> HandleEntries; /*!< First entry of each interned name (npos if it doesn't exist). */
+
+	struct TLine  /*!< Parameter or include directive of a source file (offsets from the text of the source). */
+	{
+		std::size_t Key;        /*!< Offset of the name, with the section (unused for includes). */
+		std::size_t KeySize;    /*!< Size of the name. */
+		std::size_t Value;      /*!< Offset of the value (or of the included path). */
+		std::size_t ValueSize;  /*!< Size of the value. */
+		std::uint64_t Hash;     /*!< Hash of the name. */
+		unsigned char Kind;     /*!< Kind of line (see ELineKind). */
+	};
+	enum ELineKind  /*!< Kinds of TLine. */
+	{
+		lkParameter, lkInterpolate, lkInclude
+	};
+	struct TSource  /*!< Parsed configuration file, reused while it doesn't change. */
+	{
+		std::filesystem::file_time_type Time;  /*!< Modification time when it was read. */
+		std::uintmax_t Size;                   /*!< Size when it was read. */
+		std::uint64_t Hash;                    /*!< Hash of the contents. */
+		std::size_t Text;                      /*!< Offset of the names and values of the lines in the arena. */
+		std::size_t TextSize;                  /*!< Size of the names and values. */
+		std::vector<TLine> Lines;              /*!< Lines, in file order. */
+		bool Exists;                           /*!< False for an include that couldn't be read (noticed when it appears). */
+		bool Used;                             /*!< Reached by the last read (unused sources are discarded). */
+	};
+	std::unordered_map<std::string,TSource> Sources;  /*!< Files read, by normalized path (discarded when the arena is replaced, and not copied). */
+	std::map<std::string,std::string> Variables;     /*!< Environment variables referenced by the files read, with their values then (empty if unset). */
+
+	struct TImage  /*!< Compiled image mapped in memory (the parameters are read from it while it isn't changed). */
+	{
+		const char *Data;                    /*!< Mapped file. */
+		std::size_t Size;                    /*!< Size of the file. */
+		void *Handle;                        /*!< Mapping handle. */
+		const TEntry *Entries;               /*!< Parameters, in file order. */
+		std::size_t Count;                   /*!< Number of parameters. */
+		const std::uint64_t *Table;          /*!< Perfect hash table, with the first entry of each name (npos if unused). */
+		std::size_t TableSize;               /*!< Size of the table. */
+		const std::uint32_t *Displacements;  /*!< Displacement of each bucket of names in the table. */
+		std::size_t Buckets;                 /*!< Number of buckets. */
+		const char *Sources;                 /*!< Records of the source files (time, size and path). */
+		std::size_t SourceCount;             /*!< Number of source files. */
+		const char *Variables;               /*!< Records of the environment variables (name and value). */
+		std::size_t VariableCount;           /*!< Number of environment variables. */
+		const char *Text;                    /*!< Names and values. */
+		std::size_t TextSize;                /*!< Size of the names and values. */
+	};
+	TImage *Image;  /*!< Mapped image (NULL if the parameters are in the arena). */
+
 	// support functions
-	std::string Trim(const char* Expression);
+	static std::uint64_t HashKey(std::string_view Key);
+	std::size_t FindSlot(std::string_view Key, std::uint64_t Hash) const;
+	void Index(std::size_t First);
+	void Append(std::string_view Key, std::string_view Value);
+	void Insert(std::string_view Key, std::string_view Value);
+	void Compact();
+	void Parse(const char *Text, std::size_t Size, TSource &Source);
+	static void Interpolate(std::string_view Text, std::string &Output, std::map<std::string,std::string> *Used = NULL);
+	TSource *LoadSource(const std::string &Path, const std::string &Previous);
+	void Flatten(const std::string &Path, const TSource &Source, const std::string &Previous, std::vector<std::string> &Stack);
+	bool Merge(const std::string &Path, std::string &Output, std::string &Section, std::unordered_map<std::string,std::size_t> &Next, std::vector<bool> &Written, std::vector<std::string> &Stack, std::map<std::string,std::string> &Includes) const;
+	const TEntry &GetEntry(std::size_t Index) const;
+	const char *GetText() const;
+	std::size_t FindImageEntry(std::string_view Key) const;
+	bool ImageIsCurrent(const char *Path) const;
+	void Materialize(const TImage &Source);
+	void ReleaseImage(bool Keep);
+	std::size_t FindEntry(std::string_view Key) const;
+	void ResolveHandles();
+	void ResetCache();
+	TCache &GetCache(std::size_t Entry) const;
+	bool CachedInt(std::size_t Entry, long long &Value) const;
+	bool CachedDouble(std::size_t Entry, double &Value) const;
+	bool CachedBool(std::size_t Entry, bool &Value) const;
+	std::size_t SplitList(std::size_t Entry, std::vector<std::string_view> &Values, char Delimiter) const;
 
 public:
-	std::multimap<std::string,std::string> Parameters;  /*!< Parameters and values. */
-
 	// constructos and destructor
 	TConfigFile();
 	TConfigFile(const TConfigFile &Copy);
@@ -28,11 +174,45 @@ public:
 
 	// file operations
 	bool ReadFile(const char* ConfigFile);
-	bool WriteFile(const char* ConfigFile);
+	bool WriteFile(const char* ConfigFile, bool RoundTrip = false) const;
+	bool IsModified() const;
+
+	// compiled image
+	bool WriteCache(const char* CacheFile) const;
+	bool ReadCache(const char* CacheFile, const char* ConfigFile = NULL);
+	bool ReadFile(const char* ConfigFile, const char* CacheFile);
+
+	// parameters
+	void Clear();
+	std::size_t GetCount() const;
+	std::string_view GetKeyAt(std::size_t Index) const;
+	std::string_view GetValueAt(std::size_t Index) const;
+	bool HasKey(std::string_view Key) const;
+	std::string_view GetValue(std::string_view Key, std::string_view Default = std::string_view()) const;
+	std::size_t GetValues(std::string_view Key, std::vector<std::string_view> &Values) const;
+	void AddValue(std::string_view Key, std::string_view Value);
+	void SetValue(std::string_view Key, std::string_view Value);
+
+	// typed getters (false if the parameter doesn't exist or can't be converted, leaving Value unchanged)
+	bool GetInt(std::string_view Key, long long &Value) const;
+	bool GetDouble(std::string_view Key, double &Value) const;
+	bool GetBool(std::string_view Key, bool &Value) const;
+	std::size_t GetList(std::string_view Key, std::vector<std::string_view> &Values, char Delimiter = ',') const;
+
+	// interned names
+	THandle GetHandle(std::string_view Key);
+	bool HasKey(THandle Handle) const;
+	std::string_view GetValue(THandle Handle, std::string_view Default = std::string_view()) const;
+	bool GetInt(THandle Handle, long long &Value) const;
+	bool GetDouble(THandle Handle, double &Value) const;
+	bool GetBool(THandle Handle, bool &Value) const;
+	std::size_t GetList(THandle Handle, std::vector<std::string_view> &Values, char Delimiter = ',') const;
+
+	// compatibility with the multimap container
+	std::multimap<std::string,std::string> GetParameters() const;
+	void SetParameters(const std::multimap<std::string,std::string> &Parameters);
 };
 
 //---------------------------------------------------------------------------
 
 #endif
-
-
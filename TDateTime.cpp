@@ -2,8 +2,8 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
-#include <sstream>
 #include "TDateTime.h"
+#include "TProfiler.h"
 
 //---------------------------------------------------------------------------
 
@@ -63,9 +63,13 @@ time_t mktimeUTC(struct tm* timeinfo)
 std::vector<std::string> TDateTime::Split(const std::string &Text, char Delimiter) const
 {
     std::vector<std::string> chunks;
-    std::stringstream ss(Text);
-    std::string item;
-    while(std::getline(ss, item, Delimiter))  chunks.push_back(item);
+    std::string::size_type begin = 0, end;
+    while((end = Text.find(Delimiter, begin)) != std::string::npos)
+    {
+        chunks.emplace_back(Text, begin, end - begin);
+        begin = end + 1;
+    }
+    if(begin < Text.size())  chunks.emplace_back(Text, begin, std::string::npos);  // like getline, no empty chunk after a final delimiter
     return chunks;
 }
 
@@ -78,18 +82,21 @@ std::vector<std::string> TDateTime::Split(const std::string &Text, char Delimite
  */
 std::string TDateTime::Replace(const char* Haystack, const char* Needle, const char* Replace) const
 {
-	std::string texto = Haystack;
+	std::string text = Haystack;
 	std::string search = Needle;
 	std::string replace = Replace;
-	if(search != replace)
+	if(search.empty() || search == replace) return text;
+	// build the output forward, never scanning the replaced text again
+	std::string texto;
+	texto.reserve(text.size());
+	std::string::size_type begin = 0, pos;
+	while( (pos = text.find(search, begin)) != std::string::npos )
 	{
-		std::string::size_type pos = 0;
-		while( (pos = texto.find(search, pos)) != std::string::npos )
-		{
-			texto.replace(pos, search.size(), replace);
-			pos++;
-		}
+		texto.append(text, begin, pos - begin);
+		texto.append(replace);
+		begin = pos + search.size();
 	}
+	texto.append(text, begin, std::string::npos);
 	return texto;
 }
 
@@ -349,6 +356,7 @@ bool TDateTime::Set(const int &Year, const int &Month, const int &Day, const int
  */
 bool TDateTime::Set(const char* DataANSI)
 {
+	TPROFILE("TDateTime::Set(const char*)");
     int Year=0, mes=0, dia=0, hrs=0, min=0, seg=0;
     std::vector<std::string> tmp = Split(DataANSI,' ');
     std::string data,hora;
@@ -0,0 +1,348 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "THistogram.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Get the binary representation of a double as an integer (positive doubles are monotonic in it).
+ * \param Value Double value.
+ * \return Integer with the same bits.
+ */
+static inline long long DoubleBits(double Value)
+{
+	long long bits;
+	std::memcpy(&bits, &Value, sizeof(bits));
+	return bits;
+}
+
+/*!
+ * \brief Get the double of a binary representation.
+ * \param Bits Integer with the bits.
+ * \return Double with the same bits.
+ */
+static inline double BitsDouble(long long Bits)
+{
+	double value;
+	std::memcpy(&value, &Bits, sizeof(value));
+	return value;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Default constructor, with a single linear bin over [0, 1).
+ */
+THistogram::THistogram()
+{
+	SetLinear(0, 1, 1);
+}
+
+/*!
+ * \brief Destructor (no pointers here, so nothing to declare).
+ */
+THistogram::~THistogram()
+{
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Set bins of the same width (the counters are cleared).
+ * \param Min Lower edge of the first bin.
+ * \param Max Upper edge of the last bin.
+ * \param NBins Number of bins.
+ * \return True if the layout was set, false if the range is empty or there's no bin.
+ */
+bool THistogram::SetLinear(double Min, double Max, unsigned int NBins)
+{
+	if(!(Max > Min) || NBins == 0) return false;
+	Binning = hbLinear;
+	Bins = NBins;
+	Lower = Min;
+	Upper = Max;
+	Scale = NBins / (Max - Min);
+	Shift = 0;
+	Base = 0;
+	Clear();
+	return true;
+}
+
+/*!
+ * \brief Set logarithmic bins, with 2^SubBits bins per power of two (the counters are cleared).
+ * \param Min Lower value of the range (positive; the first bin starts at or just below it).
+ * \param Max Upper value of the range (the last bin ends at or just above it).
+ * \param SubBits Bits of the mantissa used to split each power of two (from 0 to 20).
+ * \return True if the layout was set, false if the range is invalid or needs more than 2^24 bins.
+ */
+bool THistogram::SetLogarithmic(double Min, double Max, unsigned int SubBits)
+{
+	if(!(Min > 0) || !(Max > Min) || SubBits > 20 || std::isinf(Max)) return false;
+	long long base = DoubleBits(Min) >> (52 - SubBits);
+	long long bins = (DoubleBits(Max) >> (52 - SubBits)) - base + 1;
+	if(bins > (1LL << 24)) return false;  // too many bins for the range
+	Binning = hbLogarithmic;
+	Shift = 52 - SubBits;
+	Base = base;
+	Bins = (unsigned int)bins;
+	Lower = BitsDouble(Base << Shift);
+	Upper = BitsDouble((Base + Bins) << Shift);
+	Scale = 0;
+	Clear();
+	return true;
+}
+
+/*!
+ * \brief Clear all counters (the layout is kept).
+ */
+void THistogram::Clear()
+{
+	Counts.assign(Bins + 2, 0);
+	Total = 0;
+	CumulativeValid = false;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Get the counter of a value in linear bins, without branches (0 is the underflow and Bins+1 the overflow).
+ * \param Value Value to be classified (NaN is counted as underflow).
+ * \return Index of the counter.
+ */
+inline unsigned int THistogram::LinearIndex(double Value) const
+{
+	double t = (Value - Lower) * Scale + 1.0;
+	t = (t > 0) ? t : 0.0;
+	t = (t < Bins + 1.0) ? t : Bins + 1.0;
+	return (unsigned int)t;
+}
+
+/*!
+ * \brief Get the counter of a value in logarithmic bins, without branches (0 is the underflow and Bins+1 the overflow).
+ * \param Value Value to be classified (NaN is counted as underflow).
+ * \return Index of the counter.
+ */
+inline unsigned int THistogram::LogarithmicIndex(double Value) const
+{
+	long long i = (DoubleBits(Value) >> Shift) - Base + 1;  // negative doubles give negative indexes
+	i = (i > 0) ? i : 0;
+	i = (i < (long long)Bins + 1) ? i : (long long)Bins + 1;
+	i = (Value == Value) ? i : 0;
+	return (unsigned int)i;
+}
+
+/*!
+ * \brief Get the counter of a value (0 is the underflow and Bins+1 the overflow).
+ * \param Value Value to be classified (NaN is counted as underflow).
+ * \return Index of the counter.
+ */
+inline unsigned int THistogram::Index(double Value) const
+{
+	return (Binning == hbLinear) ? LinearIndex(Value) : LogarithmicIndex(Value);
+}
+
+/*!
+ * \brief Count a single value.
+ * \param Value Value to be counted.
+ */
+void THistogram::Push(double Value)
+{
+	Counts[Index(Value)]++;
+	Total++;
+	CumulativeValid = false;
+}
+
+/*!
+ * \brief Count an array of values.
+ *
+ * The indexes are calculated in blocks (a loop that can be vectorized, with the kind of bins
+ * chosen once per block instead of per value) and only then the counters are incremented.
+ *
+ * \param Values Pointer to the values.
+ * \param Count Number of values.
+ */
+void THistogram::Add(const double *Values, std::size_t Count)
+{
+	const std::size_t block = 256;
+	unsigned int index[block];
+	for(std::size_t b = 0; b < Count; b += block)
+	{
+		std::size_t n = (Count - b < block) ? Count - b : block;
+		if(Binning == hbLinear) for(std::size_t i = 0; i < n; i++) index[i] = LinearIndex(Values[b + i]);
+		else for(std::size_t i = 0; i < n; i++) index[i] = LogarithmicIndex(Values[b + i]);
+		for(std::size_t i = 0; i < n; i++) Counts[index[i]]++;
+	}
+	Total += Count;
+	CumulativeValid = false;
+}
+
+/*!
+ * \brief Count a vector of values.
+ * \param Values Values to be counted.
+ */
+void THistogram::Add(const std::vector<double> &Values)
+{
+	if(!Values.empty()) Add(&Values[0], Values.size());
+}
+
+/*!
+ * \brief Add the counters of other histogram (for instance, of other thread) to this one.
+ * \param Other Histogram to be merged.
+ * \return True if merged, false if the layouts are different.
+ */
+bool THistogram::Merge(const THistogram &Other)
+{
+	if(Binning != Other.Binning || Bins != Other.Bins || Lower != Other.Lower || Upper != Other.Upper) return false;
+	for(std::size_t i = 0; i < Counts.size(); i++) Counts[i] += Other.Counts[i];
+	Total += Other.Total;
+	CumulativeValid = false;
+	return true;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Get the cumulative counters, calculating them if the counters changed.
+ * \return Reference to the cumulative counters (underflow, bins and overflow).
+ */
+const std::vector<unsigned long long> &THistogram::GetCumulative() const
+{
+	if(!CumulativeValid)
+	{
+		Cumulative.resize(Counts.size());
+		unsigned long long s = 0;
+		for(std::size_t i = 0; i < Counts.size(); i++)
+		{
+			s += Counts[i];
+			Cumulative[i] = s;
+		}
+		CumulativeValid = true;
+	}
+	return Cumulative;
+}
+
+/*!
+ * \brief Get the number of bins.
+ * \return Number of bins (without underflow and overflow).
+ */
+unsigned int THistogram::GetBins() const
+{
+	return Bins;
+}
+
+/*!
+ * \brief Get the number of values counted.
+ * \return Number of values (including underflow and overflow).
+ */
+unsigned long long THistogram::GetTotal() const
+{
+	return Total;
+}
+
+/*!
+ * \brief Get the counter of a bin.
+ * \param Bin Index of the bin (from 0 to GetBins()-1).
+ * \return Number of values in the bin, or zero if the bin doesn't exist.
+ */
+unsigned long long THistogram::GetCount(unsigned int Bin) const
+{
+	return (Bin < Bins) ? Counts[Bin + 1] : 0;
+}
+
+/*!
+ * \brief Get the number of values below the first bin.
+ * \return Underflow counter.
+ */
+unsigned long long THistogram::GetUnderflow() const
+{
+	return Counts[0];
+}
+
+/*!
+ * \brief Get the number of values above the last bin.
+ * \return Overflow counter.
+ */
+unsigned long long THistogram::GetOverflow() const
+{
+	return Counts[Bins + 1];
+}
+
+/*!
+ * \brief Get the lower edge of a bin.
+ * \param Bin Index of the bin (GetBins() gives the upper edge of the last bin).
+ * \return Lower edge of the bin.
+ */
+double THistogram::GetBinLower(unsigned int Bin) const
+{
+	if(Bin >= Bins) return Upper;
+	if(Binning == hbLinear) return Lower + Bin / Scale;
+	return BitsDouble((Base + Bin) << Shift);
+}
+
+/*!
+ * \brief Get the upper edge of a bin.
+ * \param Bin Index of the bin.
+ * \return Upper edge of the bin.
+ */
+double THistogram::GetBinUpper(unsigned int Bin) const
+{
+	return GetBinLower(Bin + 1);
+}
+
+/*!
+ * \brief Get the frequencies of the bins.
+ * \param Frequencies Vector that will receive the frequency of each bin.
+ * \param Relative True to divide the counters by the total, false for absolute counters.
+ */
+void THistogram::GetFrequencies(std::vector<double> &Frequencies, bool Relative) const
+{
+	Frequencies.resize(Bins);
+	double f = (Relative && Total > 0) ? 1.0 / Total : 1.0;
+	for(unsigned int i = 0; i < Bins; i++) Frequencies[i] = Counts[i + 1] * f;
+}
+
+/*!
+ * \brief Estimate the fraction of the values below a given value (linear interpolation inside the bin).
+ * \param Value Value to be evaluated.
+ * \return Cumulative frequency, from 0.0 to 1.0 (zero if the histogram is empty).
+ */
+double THistogram::CumulativeFrequency(double Value) const
+{
+	if(Total == 0) return 0;
+	const std::vector<unsigned long long> &c = GetCumulative();
+	unsigned int i = Index(Value);
+	if(i == 0) return 0;
+	if(i == Bins + 1) return (double)c[Bins] / Total;
+	double lo = GetBinLower(i - 1), hi = GetBinUpper(i - 1);
+	double frac = (hi > lo) ? (Value - lo) / (hi - lo) : 0.0;
+	return (c[i - 1] + frac * Counts[i]) / Total;
+}
+
+/*!
+ * \brief Estimate the value below which a given fraction of the values is (inverse of the cumulative frequency).
+ *
+ * The bin is found by a binary search over the cumulative counters, O(log bins), and the value is
+ * linearly interpolated inside it. Fractions that fall in the underflow or overflow return the edges
+ * of the range.
+ *
+ * \param P Cumulative frequency, from 0.0 to 1.0.
+ * \return Estimated value (the lower edge if the histogram is empty).
+ */
+double THistogram::InverseCumulative(double P) const
+{
+	if(Total == 0 || !(P > 0)) return Lower;
+	if(P > 1) P = 1;
+	const std::vector<unsigned long long> &c = GetCumulative();
+	double rank = P * Total;
+	if(rank <= c[0]) return Lower;
+	if(rank > c[Bins]) return Upper;
+	// first counter whose cumulative reaches the rank
+	std::size_t i = std::lower_bound(c.begin() + 1, c.begin() + Bins + 1, (unsigned long long)std::ceil(rank)) - c.begin();
+	double before = (double)c[i - 1];
+	double frac = (Counts[i] > 0) ? (rank - before) / Counts[i] : 0.0;
+	double lo = GetBinLower(i - 1), hi = GetBinUpper(i - 1);
+	return lo + frac * (hi - lo);
+}
@@ -0,0 +1,79 @@
+#ifndef THistogramH
+#define THistogramH
+
+#include <cstddef>
+#include <vector>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Histogram with fixed-width or logarithmic (HDR-style) bins, mergeable and invertible.
+ *
+ * Linear bins have the same width over [Min, Max). Logarithmic bins split each power of two in
+ * 2^SubBits linear sub-bins, so the relative width of any bin is at most 2^-SubBits; the bin of
+ * a positive double is taken directly from the high bits of its representation (which are
+ * monotonic), without calling log(). In both cases the bin index is computed without branches,
+ * and values out of range go to the underflow and overflow counters. Histograms with the same
+ * layout (for instance, one per thread) can be merged, and the cumulative frequency is inverted
+ * by a binary search over the bins.
+ */
+class THistogram
+{
+public:
+	enum EBinning  /*!< Kinds of bins. */
+	{
+		hbLinear = 0,  /*!< Bins of the same width. */
+		hbLogarithmic  /*!< Bins of the same relative width (positive values only). */
+	};
+
+private:
+	EBinning Binning;                          /*!< Kind of bins. */
+	unsigned int Bins;                         /*!< Number of bins (without underflow and overflow). */
+	double Lower;                              /*!< Lower edge of the first bin. */
+	double Upper;                              /*!< Upper edge of the last bin. */
+	double Scale;                              /*!< Bins per unit (linear bins). */
+	unsigned int Shift;                        /*!< Bits discarded from the representation of a double (logarithmic bins). */
+	long long Base;                            /*!< Shifted representation of the lower edge (logarithmic bins). */
+	std::vector<unsigned long long> Counts;    /*!< Counters: underflow, bins and overflow. */
+	unsigned long long Total;                  /*!< Number of values added. */
+	mutable std::vector<unsigned long long> Cumulative;  /*!< Cumulative counters (calculated on demand). */
+	mutable bool CumulativeValid;              /*!< True if Cumulative is up to date with Counts. */
+
+	// support functions
+	unsigned int LinearIndex(double Value) const;
+	unsigned int LogarithmicIndex(double Value) const;
+	unsigned int Index(double Value) const;
+	const std::vector<unsigned long long> &GetCumulative() const;
+
+public:
+	// constructors and destructor
+	THistogram();
+	virtual ~THistogram();
+
+	// layout functions
+	bool SetLinear(double Min, double Max, unsigned int NBins);
+	bool SetLogarithmic(double Min, double Max, unsigned int SubBits);
+	void Clear();
+
+	// accumulation functions
+	void Push(double Value);
+	void Add(const double *Values, std::size_t Count);
+	void Add(const std::vector<double> &Values);
+	bool Merge(const THistogram &Other);
+
+	// output functions
+	unsigned int GetBins() const;
+	unsigned long long GetTotal() const;
+	unsigned long long GetCount(unsigned int Bin) const;
+	unsigned long long GetUnderflow() const;
+	unsigned long long GetOverflow() const;
+	double GetBinLower(unsigned int Bin) const;
+	double GetBinUpper(unsigned int Bin) const;
+	void GetFrequencies(std::vector<double> &Frequencies, bool Relative = true) const;
+	double CumulativeFrequency(double Value) const;
+	double InverseCumulative(double P) const;
+};
+
+//---------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,316 @@
+
+#include <chrono>
+#include <filesystem>
+#include <unordered_set>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "TLiveConfig.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Constructor, reading the file for the first time.
+ * \param ConfigFile File name (may include full pathname) to the configuration file.
+ *
+ * If the file can't be read, the snapshot starts empty (version 0) and it can be loaded later by Reload().
+ */
+TLiveConfig::TLiveConfig(const char *ConfigFile)
+{
+	FileName = ConfigFile;
+	Snapshot = std::make_shared<const TConfigFile>();
+	Version.store(0);
+	NextId = 1;
+	Running.store(false);
+	WakeHandle = -1;
+	Reload();
+}
+
+/*!
+ * \brief Destructor, stopping the watcher.
+ */
+TLiveConfig::~TLiveConfig()
+{
+	Stop();
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Current snapshot of the configuration.
+ * \return Snapshot, which stays valid (and unchanged) while it's held.
+ */
+std::shared_ptr<const TConfigFile> TLiveConfig::GetSnapshot() const
+{
+	return std::atomic_load(&Snapshot);
+}
+
+/*!
+ * \brief Number of snapshots published so far.
+ * \return Version of the current snapshot.
+ */
+std::uint64_t TLiveConfig::GetVersion() const
+{
+	return Version.load(std::memory_order_acquire);
+}
+
+/*!
+ * \brief Update a snapshot held by a reader, only if a new one was published (only an atomic read if nothing changed).
+ * \param Current Snapshot held by the reader (updated if needed).
+ * \param CurrentVersion Version of the snapshot held by the reader (updated if needed; start it at zero).
+ * \return True if the snapshot was updated.
+ */
+bool TLiveConfig::Refresh(std::shared_ptr<const TConfigFile> &Current, std::uint64_t &CurrentVersion) const
+{
+	std::uint64_t version = Version.load(std::memory_order_acquire);
+	if(version == CurrentVersion && Current) return false;
+	Current = std::atomic_load(&Snapshot);
+	CurrentVersion = version;
+	return true;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Names whose values differ between two snapshots (including added and removed names).
+ * \param Old Previous snapshot.
+ * \param New New snapshot.
+ * \param Keys Vector that will receive the changed names.
+ */
+void TLiveConfig::Diff(const TConfigFile &Old, const TConfigFile &New, std::vector<std::string> &Keys)
+{
+	std::unordered_set<std::string_view> seen;
+	std::vector<std::string_view> a, b;
+	for(std::size_t i = 0; i < New.GetCount(); i++)
+	{
+		std::string_view key = New.GetKeyAt(i);
+		if(!seen.insert(key).second) continue;
+		New.GetValues(key, a);
+		Old.GetValues(key, b);
+		if(a != b) Keys.push_back(std::string(key));
+	}
+	for(std::size_t i = 0; i < Old.GetCount(); i++)
+	{
+		std::string_view key = Old.GetKeyAt(i);
+		if(seen.insert(key).second) Keys.push_back(std::string(key));  // removed
+	}
+}
+
+/*!
+ * \brief Publish a new snapshot (called with Mutex locked).
+ * \param Next New snapshot, which won't be changed anymore.
+ */
+void TLiveConfig::Publish(std::shared_ptr<TConfigFile> Next)
+{
+	std::atomic_store(&Snapshot, std::shared_ptr<const TConfigFile>(Next));
+	Version.fetch_add(1, std::memory_order_release);  // after the swap, so a reader that sees the version gets the snapshot
+}
+
+/*!
+ * \brief Read the file again and publish it as a new snapshot, calling the callbacks of the changed names.
+ * \return True if the file was read, false if it couldn't be opened (the current snapshot is kept).
+ */
+bool TLiveConfig::Reload()
+{
+	std::vector<std::pair<TCallback, std::vector<std::string> > > calls;
+	std::shared_ptr<TConfigFile> next;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		if(!Loader.ReadFile(FileName.c_str())) return false;
+		next = std::make_shared<TConfigFile>(Loader);
+		for(std::size_t i = 0; i < Interned.size(); i++) next->GetHandle(Interned[i]);  // same handles in every snapshot
+		std::shared_ptr<const TConfigFile> old = std::atomic_load(&Snapshot);
+		Publish(next);
+
+		std::vector<std::string> changed;
+		Diff(*old, *next, changed);
+		if(changed.empty()) return true;
+		std::unordered_set<std::string> changedSet(changed.begin(), changed.end());
+		for(std::size_t i = 0; i < Subscriptions.size(); i++)
+		{
+			std::vector<std::string> keys;
+			if(Subscriptions[i].Keys.empty()) keys = changed;
+			else
+			{
+				for(std::size_t k = 0; k < Subscriptions[i].Keys.size(); k++)
+				{
+					if(changedSet.count(Subscriptions[i].Keys[k])) keys.push_back(Subscriptions[i].Keys[k]);
+				}
+			}
+			if(!keys.empty()) calls.push_back(std::make_pair(Subscriptions[i].Callback, keys));
+		}
+	}
+	// called without the lock, so callbacks may use this object
+	for(std::size_t i = 0; i < calls.size(); i++) calls[i].first(calls[i].second, *next);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Check if the file, or a file it includes, changed since the last reload.
+ * \return True if a file changed (or if the file was never read).
+ */
+bool TLiveConfig::FileChanged()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Loader.IsModified();
+}
+
+/*!
+ * \brief Body of the watcher thread.
+ * \param Interval Maximum time between checks of the file, in milliseconds.
+ *
+ * On Linux, inotify wakes the watcher as soon as the file is written or replaced in its directory
+ * (files are checked only when closed or renamed, not while they are written). Elsewhere, or if
+ * inotify isn't available, the modification time is polled at each interval.
+ */
+void TLiveConfig::Watch(unsigned int Interval)
+{
+#if defined(__linux__)
+	int notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(notify >= 0)
+	{
+		std::filesystem::path directory = std::filesystem::path(FileName).parent_path();
+		if(directory.empty()) directory = ".";
+		if(inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+		{
+			close(notify);
+			notify = -1;
+		}
+	}
+	while(Running.load())
+	{
+		struct pollfd fds[2];
+		fds[0].fd = WakeHandle;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd = notify;
+		fds[1].events = POLLIN;
+		fds[1].revents = 0;
+		poll(fds, (notify >= 0) ? 2 : 1, (int)Interval);
+		if(notify >= 0 && (fds[1].revents & POLLIN))
+		{
+			char events[4096];
+			while(read(notify, events, sizeof(events)) > 0) {}  // the file is checked by its time anyway
+		}
+		if(!Running.load()) break;
+		if(FileChanged()) Reload();
+	}
+	if(notify >= 0) close(notify);
+#else
+	std::unique_lock<std::mutex> lock(WaitMutex);
+	while(Running.load())
+	{
+		WaitSignal.wait_for(lock, std::chrono::milliseconds(Interval));
+		if(!Running.load()) break;
+		lock.unlock();
+		if(FileChanged()) Reload();
+		lock.lock();
+	}
+#endif
+}
+
+/*!
+ * \brief Start watching the file in a background thread.
+ * \param Interval Maximum time between checks of the file, in milliseconds.
+ * \return True if the watcher started, false if it was already running.
+ */
+bool TLiveConfig::Start(unsigned int Interval)
+{
+	if(Watcher.joinable()) return false;
+#if defined(__linux__)
+	WakeHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+	Running.store(true);
+	Watcher = std::thread(&TLiveConfig::Watch, this, Interval);
+	return true;
+}
+
+/*!
+ * \brief Stop the watcher thread (nothing happens if it isn't running).
+ */
+void TLiveConfig::Stop()
+{
+	if(!Watcher.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(WaitMutex);
+		Running.store(false);
+	}
+	WaitSignal.notify_all();
+#if defined(__linux__)
+	if(WakeHandle >= 0)
+	{
+		std::uint64_t one = 1;
+		if(write(WakeHandle, &one, sizeof(one)) < 0) {}  // the poll timeout still stops the watcher
+	}
+#endif
+	Watcher.join();
+#if defined(__linux__)
+	if(WakeHandle >= 0) close(WakeHandle);
+	WakeHandle = -1;
+#endif
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Intern a name in the current and all future snapshots.
+ * \param Key Parameter name (it doesn't need to exist yet).
+ * \return Handle of the name, valid in every snapshot of this object.
+ *
+ * Interning a new name publishes a copy of the current snapshot, so it's meant for setup time.
+ */
+TConfigFile::THandle TLiveConfig::GetHandle(std::string_view Key)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	TConfigFile::THandle handle;
+	for(handle.Id = 0; handle.Id < Interned.size(); handle.Id++)
+	{
+		if(Interned[handle.Id] == Key) return handle;
+	}
+	Interned.push_back(std::string(Key));
+	std::shared_ptr<TConfigFile> next = std::make_shared<TConfigFile>(*std::atomic_load(&Snapshot));
+	handle = next->GetHandle(Key);
+	Publish(next);
+	return handle;
+}
+
+/*!
+ * \brief Register a callback for changes.
+ * \param Callback Function called after a reload with the changed names (in the thread that reloaded).
+ * \param Keys Names of interest (empty for all names).
+ * \return Identifier of the callback, for RemoveCallback().
+ */
+std::size_t TLiveConfig::AddCallback(TCallback Callback, const std::vector<std::string> &Keys)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	TSubscription subscription;
+	subscription.Id = NextId++;
+	subscription.Keys = Keys;
+	subscription.Callback = Callback;
+	Subscriptions.push_back(subscription);
+	return subscription.Id;
+}
+
+/*!
+ * \brief Remove a callback.
+ * \param Id Identifier returned by AddCallback().
+ */
+void TLiveConfig::RemoveCallback(std::size_t Id)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	for(std::size_t i = 0; i < Subscriptions.size(); i++)
+	{
+		if(Subscriptions[i].Id == Id)
+		{
+			Subscriptions.erase(Subscriptions.begin() + i);
+			return;
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#ifndef TLiveConfigH
+#define TLiveConfigH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "TConfigFile.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Configuration file that can be reloaded while other threads read it.
+ *
+ * Each reload parses the file into a new TConfigFile, which is never changed after it is
+ * published, and swaps it atomically with the current snapshot. Readers keep a snapshot
+ * (a shared_ptr) for as long as they need it. Hot paths can call Refresh(), which only
+ * reads an atomic version counter until a new snapshot is published; only then it fetches the
+ * snapshot with std::atomic_load, which standard libraries usually implement with an internal
+ * lock (libstdc++ uses a mutex pool), so readers pay for a lock once per publication. The file (and the files it includes) may be watched by a background thread (inotify
+ * on Linux, modification time polling elsewhere), and callbacks receive only the names whose
+ * values changed.
+ */
+class TLiveConfig
+{
+public:
+	typedef std::function<void(const std::vector<std::string> &Keys, const TConfigFile &Snapshot)> TCallback;  /*!< Change callback, with the changed names and the new snapshot. */
+
+private:
+	struct TSubscription  /*!< Registered change callback. */
+	{
+		std::size_t Id;                 /*!< Identifier returned by AddCallback(). */
+		std::vector<std::string> Keys;  /*!< Names of interest (empty for all). */
+		TCallback Callback;             /*!< Function to be called. */
+	};
+
+	std::string FileName;                         /*!< Configuration file. */
+	std::shared_ptr<const TConfigFile> Snapshot;  /*!< Current snapshot (only accessed with std::atomic_load/atomic_store). */
+	std::atomic<std::uint64_t> Version;           /*!< Incremented at each publication. */
+
+	std::mutex Mutex;                           /*!< Serializes reloads, interned names and callbacks (readers don't take it). */
+	std::vector<std::string> Interned;          /*!< Names interned in every snapshot, in handle order. */
+	std::vector<TSubscription> Subscriptions;   /*!< Change callbacks. */
+	std::size_t NextId;                         /*!< Identifier of the next callback. */
+	TConfigFile Loader;                         /*!< Reads the files, keeping them parsed so reloads only parse the changed ones. */
+
+	std::thread Watcher;                 /*!< Background thread watching the file. */
+	std::atomic<bool> Running;           /*!< True while the watcher should run. */
+	std::mutex WaitMutex;                /*!< Mutex of the watcher sleep. */
+	std::condition_variable WaitSignal;  /*!< Wakes the watcher when it's stopped. */
+	int WakeHandle;                      /*!< Event descriptor that wakes the watcher from inotify (Linux only). */
+
+	// support functions
+	bool FileChanged();
+	void Publish(std::shared_ptr<TConfigFile> Next);
+	void Watch(unsigned int Interval);
+	static void Diff(const TConfigFile &Old, const TConfigFile &New, std::vector<std::string> &Keys);
+
+public:
+	// constructors and destructor
+	TLiveConfig(const char *ConfigFile);
+	virtual ~TLiveConfig();
+
+	// reading functions (safe from any thread)
+	std::shared_ptr<const TConfigFile> GetSnapshot() const;
+	std::uint64_t GetVersion() const;
+	bool Refresh(std::shared_ptr<const TConfigFile> &Current, std::uint64_t &CurrentVersion) const;
+
+	// reloading functions
+	bool Reload();
+	bool Start(unsigned int Interval = 1000);
+	void Stop();
+
+	// interned names and callbacks
+	TConfigFile::THandle GetHandle(std::string_view Key);
+	std::size_t AddCallback(TCallback Callback, const std::vector<std::string> &Keys = std::vector<std::string>());
+	void RemoveCallback(std::size_t Id);
+};
+
+//---------------------------------------------------------------------------
+
+#endif
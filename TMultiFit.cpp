@@ -1,6 +1,10 @@
+
+#include <algorithm>
+#include <cmath>
 #include <nlopt.hpp>
 
 #include "TMultiFit.h"
+#include "TProfiler.h"
 
 //---------------------------------------------------------------------------
 
@@ -9,6 +13,14 @@
  */
 TMultiFit::TMultiFit()
 {
+	N = 0;
+	M = 0;
+	Method = fmSolver;
+	Lambda = 0;
+	Alpha = 1;
+	SumW = 0;
+	YY = 0;
+	Cached = false;
 }
 
 /*!
@@ -20,6 +32,153 @@ TMultiFit::~TMultiFit()
 
 //---------------------------------------------------------------------------
 
+/*!
+ * \brief Build (if needed) the cached normal equations X'WX and X'Wy of the current problem.
+ *
+ * Only the upper triangle is accumulated in the sample loop, since the matrix is symmetric,
+ * and it's mirrored at the end. Any change in X, Y or W invalidates the cache.
+ */
+void TMultiFit::BuildNormalEquations()
+{
+	if(Cached) return;
+	G.assign(M * M, 0.0);
+	C.assign(M, 0.0);
+	SumW = 0;
+	YY = 0;
+	for(unsigned int i = 0; i < N; i++)
+	{
+		const double *x = &X[i * M];
+		double w = W.empty() ? 1.0 : W[i];
+		double wy = w * Y[i];
+		SumW += w;
+		YY += wy * Y[i];
+		for(unsigned int j = 0; j < M; j++)
+		{
+			double wx = w * x[j];
+			double *g = &G[j * M];
+			for(unsigned int k = j; k < M; k++) g[k] += wx * x[k];
+			C[j] += wy * x[j];
+		}
+	}
+	for(unsigned int j = 0; j < M; j++)
+	{
+		for(unsigned int k = 0; k < j; k++) G[j * M + k] = G[k * M + j];
+	}
+	Cached = true;
+}
+
+/*!
+ * \brief Solve a symmetric positive definite linear system by the Cholesky decomposition.
+ * \param A Matrix m x m of the system, stored row by row (it's a copy, since it's decomposed in place).
+ * \param b Vector m x 1 with the independent terms, which will be replaced by the solution.
+ * \param m Dimension of the system.
+ * \return True if the system was solved, false if the matrix isn't positive definite (e.g. collinear variables).
+ */
+bool TMultiFit::SolveCholesky(std::vector<double> A, std::vector<double> &b, unsigned int m)
+{
+	// decomposition A = LL', with L stored in the lower triangle of A
+	for(unsigned int j = 0; j < m; j++)
+	{
+		double *aj = &A[j * m];
+		double d = aj[j];
+		for(unsigned int k = 0; k < j; k++) d -= aj[k] * aj[k];
+		if(!(d > 1E-12 * (std::fabs(aj[j]) + 1E-300))) return false;
+		d = std::sqrt(d);
+		aj[j] = d;
+		for(unsigned int i = j + 1; i < m; i++)
+		{
+			double *ai = &A[i * m];
+			double s = ai[j];
+			for(unsigned int k = 0; k < j; k++) s -= ai[k] * aj[k];
+			ai[j] = s / d;
+		}
+	}
+	// forward (Ly = b) and backward (L'x = y) substitutions
+	for(unsigned int i = 0; i < m; i++)
+	{
+		double s = b[i];
+		for(unsigned int k = 0; k < i; k++) s -= A[i * m + k] * b[k];
+		b[i] = s / A[i * m + i];
+	}
+	for(unsigned int i = m; i-- > 0; )
+	{
+		double s = b[i];
+		for(unsigned int k = i + 1; k < m; k++) s -= A[k * m + i] * b[k];
+		b[i] = s / A[i * m + i];
+	}
+	return true;
+}
+
+/*!
+ * \brief Minimize the elastic-net objective by cyclic coordinate descent with covariance updates.
+ *
+ * The objective is (1/2SumW) * sum(w * (y - xB)^2) + Lambda * ((1 - Alpha)/2 * |B|^2 + Alpha * |B|_1).
+ * Only the normal equations are used (never the samples), and the gradient vector is updated
+ * in O(m) when a coefficient changes. After each full pass the iterations run over the active
+ * (non-null) set only, until it converges, and then a full pass confirms the convergence. The
+ * current content of B is used as a warm start.
+ *
+ * \param G Matrix m x m X'WX.
+ * \param C Vector m x 1 X'Wy.
+ * \param SumW Sum of the weights.
+ * \param m Number of variables.
+ * \param Lambda Regularization strength.
+ * \param Alpha Mixing between L1 and L2 penalties.
+ * \param Tolerance Convergence threshold for the largest change of the objective in a pass.
+ * \param B Coefficients vector, used as starting point and replaced by the solution.
+ * \return Number of passes done over the variables.
+ */
+unsigned int TMultiFit::CoordinateDescent(const double *G, const double *C, double SumW, unsigned int m, double Lambda, double Alpha, double Tolerance, std::vector<double> &B)
+{
+	const unsigned int maxpasses = 100000;
+	double s = 1.0 / SumW;
+	double l1 = Lambda * Alpha;
+	double l2 = Lambda * (1.0 - Alpha);
+	std::vector<double> r(m);  // gradient of the square error part: (C - GB) / SumW
+	for(unsigned int j = 0; j < m; j++)
+	{
+		double v = C[j];
+		for(unsigned int k = 0; k < m; k++) v -= G[j * m + k] * B[k];
+		r[j] = v * s;
+	}
+	std::vector<char> active(m, 0);
+	bool full = true;
+	unsigned int passes = 0;
+	while(passes < maxpasses)
+	{
+		passes++;
+		double maxdelta = 0;
+		for(unsigned int j = 0; j < m; j++)
+		{
+			if(!full && !active[j]) continue;
+			const double *gj = G + j * m;  // symmetric, so row j is also column j
+			double gjj = gj[j] * s;
+			if(gjj <= 0) continue;  // null variable, nothing to do
+			double z = r[j] + gjj * B[j];
+			double bj = (z > l1) ? (z - l1) : ((z < -l1) ? (z + l1) : 0.0);
+			bj /= (gjj + l2);
+			double d = bj - B[j];
+			if(d == 0) continue;
+			B[j] = bj;
+			if(bj != 0) active[j] = 1;
+			for(unsigned int k = 0; k < m; k++) r[k] -= gj[k] * s * d;
+			if(gjj * d * d > maxdelta) maxdelta = gjj * d * d;
+		}
+		if(maxdelta <= Tolerance)
+		{
+			if(full) break;  // a full pass without changes: converged
+			full = true;     // the active set converged, check all variables again
+		}
+		else
+		{
+			full = false;
+		}
+	}
+	return passes;
+}
+
+//---------------------------------------------------------------------------
+
 /*!
  * \brief Set the matrices of the undependable and dependable variables (signals) of the problem.
  * \param Xi Matrix with the values of every dependable variable, being the rows as the set of values for each variable (matrix-vector notation).
@@ -31,22 +190,59 @@ bool TMultiFit::SetValues(const std::vector<std::vector<double> > &Xi, const std
 	if(Yi.size() == 0 || Xi.size() == 0) return false;
 	if(Yi.size() != Xi.size()) return false;
 	if(Xi[0].size() == 0) return false;
-	Y.clear();
-	X.clear();
-	B.clear();
-	unsigned int n = Yi.size();
-	unsigned int m = Xi[0].size();
-	for(unsigned int j = 0; j < m; j++) B.push_back(1);
-	for(unsigned int i = 0; i < n; i++)
-	{
-		Y.push_back(Yi[i]);
-		std::vector<double> aux;
-		for(unsigned int j = 0; j < m; j++)
-		{
-			aux.push_back(Xi[i][j]);
-		}
-		X.push_back(aux);
+	for(unsigned int i = 1; i < Xi.size(); i++)
+	{
+		if(Xi[i].size() != Xi[0].size()) return false;
+	}
+	N = Yi.size();
+	M = Xi[0].size();
+	Y = Yi;
+	X.resize(N * M);
+	for(unsigned int i = 0; i < N; i++)
+	{
+		std::copy(Xi[i].begin(), Xi[i].end(), X.begin() + i * M);
 	}
+	B.assign(M, 1);
+	W.clear();
+	Cached = false;
+	return true;
+}
+
+/*!
+ * \brief Set the weights of each sample, so the weighted square error will be minimized.
+ * \param Wi Vector with a non-negative weight for each sample (an empty vector removes the weights).
+ * \return True if the weights were assigned, false if the dimension doesn't match the samples or a weight is negative.
+ */
+bool TMultiFit::SetWeights(const std::vector<double> &Wi)
+{
+	if(!Wi.empty() && Wi.size() != N) return false;
+	for(unsigned int i = 0; i < Wi.size(); i++)
+	{
+		if(!(Wi[i] >= 0)) return false;
+	}
+	W = Wi;
+	Cached = false;
+	return true;
+}
+
+/*!
+ * \brief Set the method used to reduce the square error.
+ *
+ * The regularization strength is relative to the mean weighted square error, so the same
+ * Lambda has the same meaning regardless of the number of samples.
+ *
+ * \param FitMethod Method used by Reduce().
+ * \param FitLambda Regularization strength (used by fmRidge and fmElasticNet).
+ * \param FitAlpha Mixing between L1 and L2 penalties (used by fmElasticNet, 1 is the Lasso).
+ * \return True if the method was assigned, false if a parameter is out of range.
+ */
+bool TMultiFit::SetMethod(EFitMethod FitMethod, double FitLambda, double FitAlpha)
+{
+	if(!(FitLambda >= 0)) return false;
+	if(!(FitAlpha >= 0 && FitAlpha <= 1)) return false;
+	Method = FitMethod;
+	Lambda = FitLambda;
+	Alpha = FitAlpha;
 	return true;
 }
 
@@ -61,42 +257,113 @@ std::vector<double> TMultiFit::GetCoefficients()
 
 /*!
  * \brief calculate the square error of the current state of the problem (the current coefficient vector).
- * \return Square error of the current state, or zero if there's no problem set.
+ * \return Square error (weighted, if there are weights) of the current state, or zero if there's no problem set.
  */
 double TMultiFit::SquareError()
 {
-	if(Y.size() == 0 || X.size() == 0) return 0;
-	unsigned int n = Y.size();
-	unsigned int m = B.size();
+	TPROFILE("TMultiFit::SquareError");
+	if(N == 0 || M == 0) return 0;
 	double erro = 0;
-	for(unsigned int i = 0; i < n; i++)
+	for(unsigned int i = 0; i < N; i++)
 	{
+		const double *x = &X[i * M];
 		double e = 0;
-		for(unsigned int j = 0; j < m; j++)
+		for(unsigned int j = 0; j < M; j++)
 		{
-			e += B[j] * X[i][j];
+			e += B[j] * x[j];
 		}
 		e = Y[i] - e;
-		erro += e*e;
+		erro += W.empty() ? e*e : W[i]*e*e;
 	}
 	return erro;
 }
 
 /*!
- * \brief Use a solver to reduce the square error of this object, in order to acquire the best coefficient matrix.
+ * \brief Use the selected method to reduce the square error of this object, in order to acquire the best coefficient matrix.
  *
- * Currently it's using the BOBYQA (http://en.wikipedia.org/wiki/BOBYQA) solver in order to get the best approach
+ * The default method is the BOBYQA (http://en.wikipedia.org/wiki/BOBYQA) solver in order to get the best approach
 * to the coefficients vector. Since the least square error method is unconstrained, one can assume that the boundary
-* doesn't exists, hence the quadratic approximation can act a quasi Newton method.
+* doesn't exists, hence the quadratic approximation can act a quasi Newton method. The other methods are solved over
+* the normal equations, which are built once and cached until the values or the weights change.
+*
+* \return True if the coefficients were calculated, false if there's no problem set or the normal equations are singular (the coefficients are kept).
 */
-void TMultiFit::Reduce()
+bool TMultiFit::Reduce()
 {
-    std::vector<double> b(B);
-    nlopt::opt opt(nlopt::LN_BOBYQA,B.size());
-    opt.set_min_objective(TMultiFit::SquareErrorWrapper,this);
-    opt.set_ftol_rel(1E-5);
-    opt.set_xtol_rel(1E-5);
-    double minf;
-    opt.optimize(b, minf);
-    B = b;
+	TPROFILE("TMultiFit::Reduce");
+	if(N == 0 || M == 0) return false;
+	if(Method == fmSolver)
+	{
+		std::vector<double> b(B);
+		nlopt::opt opt(nlopt::LN_BOBYQA,B.size());
+		opt.set_min_objective(TMultiFit::SquareErrorWrapper,this);
+		opt.set_ftol_rel(1E-5);
+		opt.set_xtol_rel(1E-5);
+		double minf;
+		opt.optimize(b, minf);
+		B = b;
+		return true;
+	}
+	BuildNormalEquations();
+	if(SumW <= 0) return false;
+	if(Method == fmElasticNet)
+	{
+		CoordinateDescent(&G[0], &C[0], SumW, M, Lambda, Alpha, 1E-14 * (YY / SumW + 1E-300), B);
+		return true;
+	}
+	std::vector<double> a(G);
+	std::vector<double> b(C);
+	if(Method == fmRidge)
+	{
+		for(unsigned int j = 0; j < M; j++) a[j * M + j] += Lambda * SumW;
+	}
+	if(!SolveCholesky(a, b, M)) return false;
+	B = b;
+	return true;
+}
+
+/*!
+ * \brief Calculate the elastic-net coefficients for a decreasing sequence of regularization strengths.
+ *
+ * Each fit starts from the coefficients of the previous one (warm start), so near solutions converge
+ * in a few passes, and the whole path is calculated over the same cached normal equations. The current
+ * Alpha is used (Alpha = 0 gives the ridge path). At the end, the coefficients are the last ones of the path.
+ *
+ * \param Lambdas Sequence of regularization strengths; if empty, it's filled with NLambda values
+ *                log-spaced from the smallest value that nulls all coefficients down to MinRatio of it.
+ * \param Path Matrix that will receive the coefficients vector of each Lambda (it'll be cleared first).
+ * \param NLambda Number of values of the automatic sequence.
+ * \param MinRatio Ratio between the last and the first values of the automatic sequence.
+ * \return True if the path was calculated, false if there's no problem set.
+ */
+bool TMultiFit::ReducePath(std::vector<double> &Lambdas, std::vector<std::vector<double> > &Path, unsigned int NLambda, double MinRatio)
+{
+	TPROFILE("TMultiFit::ReducePath");
+	Path.clear();
+	if(N == 0 || M == 0) return false;
+	BuildNormalEquations();
+	if(SumW <= 0) return false;
+	if(Lambdas.empty())
+	{
+		if(NLambda == 0 || !(MinRatio > 0)) return false;
+		double cmax = 0;
+		for(unsigned int j = 0; j < M; j++)
+		{
+			if(std::fabs(C[j]) > cmax) cmax = std::fabs(C[j]);
+		}
+		double lmax = (cmax / SumW) / (Alpha > 1E-3 ? Alpha : 1E-3);
+		for(unsigned int i = 0; i < NLambda; i++)
+		{
+			double t = (NLambda > 1) ? (double)i / (NLambda - 1) : 0.0;
+			Lambdas.push_back(lmax * std::pow(MinRatio, t));
+		}
+	}
+	B.assign(M, 0.0);
+	double tol = 1E-14 * (YY / SumW + 1E-300);
+	for(unsigned int i = 0; i < Lambdas.size(); i++)
+	{
+		CoordinateDescent(&G[0], &C[0], SumW, M, Lambdas[i], Alpha, tol, B);
+		Path.push_back(B);
+	}
+	return true;
 }
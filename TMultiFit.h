@@ -12,14 +12,48 @@
  * all problems. This class uses a non-linear optimization method, so any sort of signals
  * can be regressed. Please note that existing a linear regression doesn't mean it has
  * a good calculation error. The optimization is done using NLOpt.
+ *
+ * Besides the solver, the class can also reduce the error in closed form (weighted least
+ * squares and ridge) or by coordinate descent (Lasso and elastic-net). These methods work
+ * over the cached normal equations (X'WX and X'Wy), so once they are built any number of
+ * fits (for instance, a whole regularization path) costs only m x m operations.
  */
 class TMultiFit
 {
+	friend class TMultiFitCV;
+
+public:
+	enum EFitMethod  /*!< Methods used to reduce the square error. */
+	{
+		fmSolver = 0,    /*!< Non-linear solver (NLOpt BOBYQA), minimizing the (weighted) square error. */
+		fmLeastSquares,  /*!< Weighted least squares, solving the normal equations by Cholesky. */
+		fmRidge,         /*!< Ridge regression (L2 penalty), closed form. */
+		fmElasticNet     /*!< Elastic-net by coordinate descent (Alpha = 1 is the Lasso, Alpha = 0 is the ridge). */
+	};
+
 private:
-	std::vector<std::vector<double> > X;  /*!< Matrix n x m with the values of the dependable variables. */
+	unsigned int N;  /*!< Number of samples (rows of X). */
+	unsigned int M;  /*!< Number of dependable variables (columns of X). */
+	std::vector<double> X;  /*!< Matrix n x m with the values of the dependable variables, stored row by row in contiguous memory. */
 	std::vector<double> Y;  /*!< Vector n x 1 with the values of the undependable variable. */
+	std::vector<double> W;  /*!< Vector n x 1 with the weights of each sample (empty if the problem is unweighted). */
 	std::vector<double> B;  /*!< Vector 1 x m with the resulting regression coefficients. */
 
+	EFitMethod Method;  /*!< Method used by Reduce(). */
+	double Lambda;      /*!< Regularization strength (relative to the mean weighted square error). */
+	double Alpha;       /*!< Elastic-net mixing between L1 (Alpha = 1) and L2 (Alpha = 0) penalties. */
+
+	std::vector<double> G;  /*!< Cached matrix m x m of the normal equations (X'WX). */
+	std::vector<double> C;  /*!< Cached vector m x 1 of the normal equations (X'Wy). */
+	double SumW;            /*!< Cached sum of the weights (n if unweighted). */
+	double YY;              /*!< Cached weighted sum of squares of Y (y'Wy). */
+	bool Cached;            /*!< True if G, C and SumW are up to date with X, Y and W. */
+
+	// support functions
+	void BuildNormalEquations();
+	static bool SolveCholesky(std::vector<double> A, std::vector<double> &b, unsigned int m);
+	static unsigned int CoordinateDescent(const double *G, const double *C, double SumW, unsigned int m, double Lambda, double Alpha, double Tolerance, std::vector<double> &B);
+
 public:
 	// constructors and destructor
 	TMultiFit();
@@ -27,11 +61,14 @@ public:
 
 	// assign functions
 	bool SetValues(const std::vector<std::vector<double> > &Xi, const std::vector<double> &Yi);
+	bool SetWeights(const std::vector<double> &Wi);
+	bool SetMethod(EFitMethod FitMethod, double FitLambda = 0, double FitAlpha = 1);
 	std::vector<double> GetCoefficients();
 
     // calculation functions
 	double SquareError();
-	void Reduce();
+	bool Reduce();
+	bool ReducePath(std::vector<double> &Lambdas, std::vector<std::vector<double> > &Path, unsigned int NLambda = 100, double MinRatio = 1E-3);
 
     /*!<
      * \brief Wrapper function with the evaluation equation of the class, so it can be called in a global scope.
@@ -43,8 +80,7 @@ public:
 	static double SquareErrorWrapper(unsigned int N, const double *B, double*, void *Data)
 	{
         TMultiFit *obj = static_cast<TMultiFit*>(Data);
-		obj->B.clear();
-		for(unsigned int i = 0; i < N; i++) obj->B.push_back(B[i]);
+		obj->B.assign(B, B + N);
         return obj->SquareError();
 	}
 };
@@ -52,5 +88,3 @@ public:
 //---------------------------------------------------------------------------
 
 #endif
-
-
@@ -0,0 +1,427 @@
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <random>
+#include <thread>
+
+#include "TMultiFitCV.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Run a task for each index from 0 to Count-1, distributing the indexes over a pool of threads.
+ * \param Count Number of tasks.
+ * \param Threads Maximum number of threads (1 runs everything in the calling thread).
+ * \param Task Function (or lambda) called with the index of each task.
+ */
+template <class Function> static void ParallelFor(unsigned int Count, unsigned int Threads, Function Task)
+{
+	if(Threads > Count) Threads = Count;
+	if(Threads <= 1)
+	{
+		for(unsigned int i = 0; i < Count; i++) Task(i);
+		return;
+	}
+	std::atomic<unsigned int> next(0);
+	std::vector<std::thread> pool;
+	for(unsigned int t = 0; t < Threads; t++)
+	{
+		pool.push_back(std::thread([&next, Count, &Task]()
+		{
+			unsigned int i;
+			while((i = next++) < Count) Task(i);
+		}));
+	}
+	for(unsigned int t = 0; t < Threads; t++) pool[t].join();
+}
+
+/*!
+ * \brief Split an ordering of the samples in K folds of (almost) the same size.
+ * \param Order Indexes of the samples, in the order they'll be assigned to the folds.
+ * \param K Number of folds.
+ * \param Blocks Matrix that will receive the sorted indexes of the samples of each fold.
+ */
+static void MakeFolds(const std::vector<unsigned int> &Order, unsigned int K, std::vector<std::vector<unsigned int> > &Blocks)
+{
+	unsigned long long n = Order.size();
+	Blocks.assign(K, std::vector<unsigned int>());
+	for(unsigned int f = 0; f < K; f++)
+	{
+		Blocks[f].assign(Order.begin() + (n * f / K), Order.begin() + (n * (f + 1) / K));
+		std::sort(Blocks[f].begin(), Blocks[f].end());  // sequential access to X
+	}
+}
+
+/*!
+ * \brief Estimate how close a symmetric positive definite matrix is to singular, by its Cholesky pivots.
+ * \param A Matrix m x m, stored by rows.
+ * \param m Dimension of the matrix.
+ * \return Smallest ratio of a squared pivot to its diagonal element (about the inverse of the
+ * condition number of the matrix scaled to a unit diagonal), or zero if the factorization fails.
+ */
+static double PivotRatio(std::vector<double> A, unsigned int m)
+{
+	double ratio = 1;
+	for(unsigned int j = 0; j < m; j++)  // L is kept below the diagonal, and the diagonal isn't changed
+	{
+		double *aj = &A[j * m];
+		double d = aj[j];
+		for(unsigned int k = 0; k < j; k++) d -= aj[k] * aj[k];
+		if(!(d > 0) || !(A[j * m + j] > 0)) return 0;
+		ratio = std::min(ratio, d / A[j * m + j]);
+		d = std::sqrt(d);
+		for(unsigned int i = j + 1; i < m; i++)
+		{
+			double *ai = &A[i * m];
+			double s = ai[j];
+			for(unsigned int k = 0; k < j; k++) s -= ai[k] * aj[k];
+			ai[j] = s / d;
+		}
+	}
+	return ratio;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Class constructor.
+ * \param Problem Reference to the problem that will be validated (values, weights and method already set).
+ */
+TMultiFitCV::TMultiFitCV(TMultiFit &Problem)
+{
+	Fit = &Problem;
+	Threads = std::thread::hardware_concurrency();
+	if(Threads == 0) Threads = 1;
+}
+
+/*!
+ * \brief Class destructor, empty because the problem isn't owned by this object.
+ */
+TMultiFitCV::~TMultiFitCV()
+{
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Set the maximum number of threads used to process the folds.
+ * \param NThreads Number of threads (zero is the number of hardware threads).
+ */
+void TMultiFitCV::SetThreads(unsigned int NThreads)
+{
+	Threads = (NThreads == 0) ? std::thread::hardware_concurrency() : NThreads;
+	if(Threads == 0) Threads = 1;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Build the normal equations (X'WX and X'Wy) of a subset of the samples.
+ * \param Index Indexes of the samples.
+ * \param Gb Matrix m x m that will receive X'WX.
+ * \param Cb Vector m x 1 that will receive X'Wy.
+ * \param SumWb Reference that will receive the sum of the weights.
+ * \param YYb Reference that will receive the weighted sum of squares of Y (y'Wy).
+ */
+void TMultiFitCV::BlockNormalEquations(const std::vector<unsigned int> &Index, std::vector<double> &Gb, std::vector<double> &Cb, double &SumWb, double &YYb) const
+{
+	unsigned int m = Fit->M;
+	Gb.assign(m * m, 0.0);
+	Cb.assign(m, 0.0);
+	SumWb = 0;
+	YYb = 0;
+	for(unsigned int s = 0; s < Index.size(); s++)
+	{
+		unsigned int i = Index[s];
+		const double *x = &Fit->X[i * m];
+		double w = Fit->W.empty() ? 1.0 : Fit->W[i];
+		double wy = w * Fit->Y[i];
+		SumWb += w;
+		YYb += wy * Fit->Y[i];
+		for(unsigned int j = 0; j < m; j++)
+		{
+			double wx = w * x[j];
+			double *g = &Gb[j * m];
+			for(unsigned int k = j; k < m; k++) g[k] += wx * x[k];
+			Cb[j] += wy * x[j];
+		}
+	}
+	for(unsigned int j = 0; j < m; j++)
+	{
+		for(unsigned int k = 0; k < j; k++) Gb[j * m + k] = Gb[k * m + j];
+	}
+}
+
+/*!
+ * \brief Solve the training problem of a fold for a subset of the variables, using the method of the problem.
+ * \param Gt Matrix m x m X'WX of the training samples.
+ * \param Ct Vector m x 1 X'Wy of the training samples.
+ * \param SumWt Sum of the weights of the training samples.
+ * \param YYt Weighted sum of squares of Y of the training samples (scale of the elastic-net tolerance).
+ * \param Vars Indexes of the variables (columns of X) used in the fit.
+ * \param Bs Vector that will receive the coefficients of the variables in Vars.
+ * \return True if the fit was solved, false if the training problem is singular.
+ */
+bool TMultiFitCV::SolveSubset(const std::vector<double> &Gt, const std::vector<double> &Ct, double SumWt, double YYt, const std::vector<unsigned int> &Vars, std::vector<double> &Bs) const
+{
+	unsigned int m = Fit->M;
+	unsigned int v = Vars.size();
+	if(SumWt <= 0) return false;
+	std::vector<double> g(v * v), c(v);
+	for(unsigned int a = 0; a < v; a++)
+	{
+		for(unsigned int b = 0; b < v; b++) g[a * v + b] = Gt[Vars[a] * m + Vars[b]];
+		c[a] = Ct[Vars[a]];
+	}
+	if(Fit->Method == TMultiFit::fmElasticNet)
+	{
+		double tol = 1E-14 * (YYt / SumWt + 1E-300);
+		Bs.assign(v, 0.0);
+		TMultiFit::CoordinateDescent(&g[0], &c[0], SumWt, v, Fit->Lambda, Fit->Alpha, tol, Bs);
+		return true;
+	}
+	if(Fit->Method == TMultiFit::fmRidge)
+	{
+		for(unsigned int a = 0; a < v; a++) g[a * v + a] += Fit->Lambda * SumWt;
+	}
+	if(!TMultiFit::SolveCholesky(g, c, v)) return false;
+	Bs = c;
+	return true;
+}
+
+/*!
+ * \brief Calculate the mean (weighted) square error of the fitted coefficients over a subset of the samples.
+ * \param Index Indexes of the samples.
+ * \param Vars Indexes of the variables (columns of X) used in the fit.
+ * \param Bs Coefficients of the variables in Vars.
+ * \return Mean square error, or zero if the samples have no weight.
+ */
+double TMultiFitCV::BlockError(const std::vector<unsigned int> &Index, const std::vector<unsigned int> &Vars, const std::vector<double> &Bs) const
+{
+	unsigned int m = Fit->M;
+	double erro = 0, sw = 0;
+	for(unsigned int s = 0; s < Index.size(); s++)
+	{
+		unsigned int i = Index[s];
+		const double *x = &Fit->X[i * m];
+		double w = Fit->W.empty() ? 1.0 : Fit->W[i];
+		double e = Fit->Y[i];
+		for(unsigned int a = 0; a < Vars.size(); a++) e -= Bs[a] * x[Vars[a]];
+		erro += w * e * e;
+		sw += w;
+	}
+	return (sw > 0) ? erro / sw : 0.0;
+}
+
+/*!
+ * \brief Validate a set of blocks of samples for each subset of variables.
+ *
+ * The normal equations of every block are built in parallel. For a k-fold validation the training
+ * problem of a fold is the whole problem minus its block (or the sum of the other blocks, if the
+ * subtraction would lose too much precision; see the class description); for a rolling-origin
+ * validation (Cumulative) the first block is the initial training set and the training problem of
+ * each following block is the sum of all blocks before it.
+ *
+ * \param Blocks Indexes of the samples of each block.
+ * \param Cumulative True for rolling-origin, false for k-fold.
+ * \param Subsets Subsets of variables to be fitted in each fold.
+ * \param Errors Matrix folds x subsets that will receive the mean square errors (NaN if the fold couldn't be solved).
+ * \return True if every fold was solved, false otherwise.
+ */
+bool TMultiFitCV::Run(const std::vector<std::vector<unsigned int> > &Blocks, bool Cumulative, const std::vector<std::vector<unsigned int> > &Subsets, std::vector<std::vector<double> > &Errors)
+{
+	unsigned int m = Fit->M;
+	unsigned int nblocks = Blocks.size();
+	Fit->BuildNormalEquations();
+	std::vector<std::vector<double> > gb(nblocks), cb(nblocks);
+	std::vector<double> sb(nblocks), yb(nblocks);
+	ParallelFor(nblocks, Threads, [&](unsigned int b)
+	{
+		BlockNormalEquations(Blocks[b], gb[b], cb[b], sb[b], yb[b]);
+	});
+	// training problems
+	unsigned int first = Cumulative ? 1 : 0;
+	std::vector<std::vector<double> > gt(nblocks), ct(nblocks);
+	std::vector<double> st(nblocks, 0.0), yt(nblocks, 0.0);
+	if(Cumulative)
+	{
+		// training of block b is the running sum of blocks 0..b-1 (block 0 is never tested)
+		std::vector<double> g(m * m, 0.0), c(m, 0.0);
+		double s = 0, y = 0;
+		for(unsigned int b = 0; b < nblocks; b++)
+		{
+			if(b > 0)
+			{
+				gt[b] = g;
+				ct[b] = c;
+				st[b] = s;
+				yt[b] = y;
+			}
+			for(unsigned int k = 0; k < m * m; k++) g[k] += gb[b][k];
+			for(unsigned int k = 0; k < m; k++) c[k] += cb[b][k];
+			s += sb[b];
+			y += yb[b];
+		}
+	}
+	else
+	{
+		ParallelFor(nblocks, Threads, [&](unsigned int b)
+		{
+			gt[b].resize(m * m);
+			ct[b].resize(m);
+			for(unsigned int k = 0; k < m * m; k++) gt[b][k] = Fit->G[k] - gb[b][k];
+			for(unsigned int k = 0; k < m; k++) ct[b][k] = Fit->C[k] - cb[b][k];
+			st[b] = Fit->SumW - sb[b];
+			yt[b] = Fit->YY - yb[b];
+			// relative error of the subtraction (cancellation) times the conditioning of the training matrix
+			double cancel = 1;
+			for(unsigned int j = 0; j < m; j++)
+			{
+				double d = gt[b][j * m + j];
+				cancel = (d > 0) ? std::max(cancel, Fit->G[j * m + j] / d) : std::numeric_limits<double>::infinity();
+			}
+			double ratio = PivotRatio(gt[b], m);
+			if(ratio > 0 && cancel * std::numeric_limits<double>::epsilon() < 1E-8 * ratio) return;
+			// too much precision lost (or the difference isn't positive definite): sum the other blocks
+			std::fill(gt[b].begin(), gt[b].end(), 0.0);
+			std::fill(ct[b].begin(), ct[b].end(), 0.0);
+			st[b] = yt[b] = 0;
+			for(unsigned int o = 0; o < nblocks; o++)
+			{
+				if(o == b) continue;
+				for(unsigned int k = 0; k < m * m; k++) gt[b][k] += gb[o][k];
+				for(unsigned int k = 0; k < m; k++) ct[b][k] += cb[o][k];
+				st[b] += sb[o];
+				yt[b] += yb[o];
+			}
+		});
+	}
+	unsigned int nfolds = nblocks - first;
+	Errors.assign(nfolds, std::vector<double>(Subsets.size(), 0.0));
+	std::atomic<bool> ok(true);
+	ParallelFor(nfolds, Threads, [&](unsigned int f)
+	{
+		unsigned int b = f + first;
+		std::vector<double> bs;
+		for(unsigned int s = 0; s < Subsets.size(); s++)
+		{
+			if(SolveSubset(gt[b], ct[b], st[b], yt[b], Subsets[s], bs))
+			{
+				Errors[f][s] = BlockError(Blocks[b], Subsets[s], bs);
+			}
+			else
+			{
+				Errors[f][s] = std::numeric_limits<double>::quiet_NaN();
+				ok = false;
+			}
+		}
+	});
+	return ok;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief K-fold cross-validation of the problem with all its variables.
+ * \param K Number of folds (from 2 to the number of samples).
+ * \param FoldErrors Vector that will receive the mean square error of each fold.
+ * \param Shuffle True to assign the samples randomly to the folds, false to use contiguous folds.
+ * \param Seed Seed of the random generator used when shuffling.
+ * \return True if every fold was solved, false if the parameters are invalid or a fold is singular.
+ */
+bool TMultiFitCV::KFold(unsigned int K, std::vector<double> &FoldErrors, bool Shuffle, unsigned int Seed)
+{
+	FoldErrors.clear();
+	if(K < 2 || K > Fit->N) return false;
+	std::vector<unsigned int> order(Fit->N);
+	for(unsigned int i = 0; i < Fit->N; i++) order[i] = i;
+	if(Shuffle) std::shuffle(order.begin(), order.end(), std::mt19937(Seed));
+	std::vector<std::vector<unsigned int> > blocks;
+	MakeFolds(order, K, blocks);
+	std::vector<std::vector<unsigned int> > subsets(1);
+	for(unsigned int j = 0; j < Fit->M; j++) subsets[0].push_back(j);
+	std::vector<std::vector<double> > e;
+	bool ok = Run(blocks, false, subsets, e);
+	for(unsigned int f = 0; f < e.size(); f++) FoldErrors.push_back(e[f][0]);
+	return ok;
+}
+
+/*!
+ * \brief Rolling-origin (time series) cross-validation of the problem with all its variables.
+ *
+ * The first fold is trained with the samples [0, InitialSize) and tested with the next Horizon
+ * samples; each following fold moves the origin Horizon samples forward, until the end of the data.
+ *
+ * \param InitialSize Number of samples of the first training set.
+ * \param Horizon Number of samples tested after each origin.
+ * \param FoldErrors Vector that will receive the mean square error of each fold.
+ * \return True if every fold was solved, false if the parameters are invalid or a fold is singular.
+ */
+bool TMultiFitCV::RollingOrigin(unsigned int InitialSize, unsigned int Horizon, std::vector<double> &FoldErrors)
+{
+	FoldErrors.clear();
+	if(InitialSize == 0 || Horizon == 0 || InitialSize >= Fit->N) return false;
+	std::vector<std::vector<unsigned int> > blocks;
+	for(unsigned int begin = 0; begin < Fit->N; )
+	{
+		unsigned int size = blocks.empty() ? InitialSize : Horizon;
+		unsigned int end = (Fit->N - begin > size) ? begin + size : Fit->N;
+		std::vector<unsigned int> block;
+		for(unsigned int i = begin; i < end; i++) block.push_back(i);
+		blocks.push_back(block);
+		begin = end;
+	}
+	std::vector<std::vector<unsigned int> > subsets(1);
+	for(unsigned int j = 0; j < Fit->M; j++) subsets[0].push_back(j);
+	std::vector<std::vector<double> > e;
+	bool ok = Run(blocks, true, subsets, e);
+	for(unsigned int f = 0; f < e.size(); f++) FoldErrors.push_back(e[f][0]);
+	return ok;
+}
+
+/*!
+ * \brief Select the subset of variables with the lowest K-fold cross-validation error.
+ *
+ * All the subsets share the same (contiguous) folds and the same fold normal equations, so each
+ * extra subset costs only its small solves and the error evaluation.
+ *
+ * \param Subsets Subsets of variables (indexes of columns of X) to be compared.
+ * \param K Number of folds.
+ * \param SubsetErrors Vector that will receive the mean of the fold errors of each subset.
+ * \param Best Reference that will receive the index of the subset with the lowest error.
+ * \return True if at least one subset was solved in every fold, false otherwise.
+ */
+bool TMultiFitCV::SelectVariables(const std::vector<std::vector<unsigned int> > &Subsets, unsigned int K, std::vector<double> &SubsetErrors, unsigned int &Best)
+{
+	SubsetErrors.clear();
+	if(Subsets.empty() || K < 2 || K > Fit->N) return false;
+	for(unsigned int s = 0; s < Subsets.size(); s++)
+	{
+		if(Subsets[s].empty()) return false;
+		for(unsigned int a = 0; a < Subsets[s].size(); a++)
+		{
+			if(Subsets[s][a] >= Fit->M) return false;
+		}
+	}
+	std::vector<unsigned int> order(Fit->N);
+	for(unsigned int i = 0; i < Fit->N; i++) order[i] = i;
+	std::vector<std::vector<unsigned int> > blocks;
+	MakeFolds(order, K, blocks);
+	std::vector<std::vector<double> > e;
+	Run(blocks, false, Subsets, e);
+	bool found = false;
+	for(unsigned int s = 0; s < Subsets.size(); s++)
+	{
+		double mean = 0;
+		for(unsigned int f = 0; f < K; f++) mean += e[f][s];
+		mean /= K;
+		SubsetErrors.push_back(mean);
+		if(mean == mean && (!found || mean < SubsetErrors[Best]))  // NaN if a fold failed
+		{
+			Best = s;
+			found = true;
+		}
+	}
+	return found;
+}
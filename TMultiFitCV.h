@@ -0,0 +1,55 @@
+#ifndef TMultiFitCVH
+#define TMultiFitCVH
+
+#include <vector>
+
+#include "TMultiFit.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Cross-validation and variable selection over a TMultiFit problem.
+ *
+ * The data isn't copied: the folds are index views over the samples of the TMultiFit
+ * object, which must outlive this one. Instead of refitting each fold from scratch, the
+ * normal equations of the whole problem are built once and the ones of each fold are
+ * subtracted (downdated) from them, so a fold costs a pass over its own samples plus an
+ * m x m solve. Folds run in parallel, and the fitting method (with its Lambda and Alpha)
+ * is the one set in the TMultiFit object; the NLOpt solver is replaced by least squares,
+ * which has the same minimum.
+ *
+ * The subtraction cancels digits when a fold holds most of the weight of a variable (the error
+ * of the training matrix grows with the ratio of the full to the training diagonal), and a badly
+ * conditioned training matrix amplifies it. Each fold checks that product against the pivots of
+ * its Cholesky factor, and when the solution could lose more than about half of its digits, the
+ * training equations are built again by summing the other blocks, as a direct fit would.
+ */
+class TMultiFitCV
+{
+private:
+	TMultiFit *Fit;        /*!< Problem being validated (shared, not copied). */
+	unsigned int Threads;  /*!< Maximum number of worker threads. */
+
+	// support functions
+	void BlockNormalEquations(const std::vector<unsigned int> &Index, std::vector<double> &Gb, std::vector<double> &Cb, double &SumWb, double &YYb) const;
+	bool SolveSubset(const std::vector<double> &Gt, const std::vector<double> &Ct, double SumWt, double YYt, const std::vector<unsigned int> &Vars, std::vector<double> &Bs) const;
+	double BlockError(const std::vector<unsigned int> &Index, const std::vector<unsigned int> &Vars, const std::vector<double> &Bs) const;
+	bool Run(const std::vector<std::vector<unsigned int> > &Blocks, bool Cumulative, const std::vector<std::vector<unsigned int> > &Subsets, std::vector<std::vector<double> > &Errors);
+
+public:
+	// constructors and destructor
+	TMultiFitCV(TMultiFit &Problem);
+	virtual ~TMultiFitCV();
+
+	// assign functions
+	void SetThreads(unsigned int NThreads);
+
+	// validation functions
+	bool KFold(unsigned int K, std::vector<double> &FoldErrors, bool Shuffle = false, unsigned int Seed = 0);
+	bool RollingOrigin(unsigned int InitialSize, unsigned int Horizon, std::vector<double> &FoldErrors);
+	bool SelectVariables(const std::vector<std::vector<unsigned int> > &Subsets, unsigned int K, std::vector<double> &SubsetErrors, unsigned int &Best);
+};
+
+//---------------------------------------------------------------------------
+
+#endif
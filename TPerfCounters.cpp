@@ -0,0 +1,181 @@
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "TPerfCounters.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Constructor of the class, opening the counters of the calling thread.
+ *
+ * The first counter opened is the leader of the group, and the others are added to it. A counter
+ * that can't be opened is skipped, keeping the reason in GetError().
+ *
+ * \param Threads True to also count the threads that the calling thread creates from now on.
+ */
+TPerfCounters::TPerfCounters(bool Threads)
+{
+	Opened = 0;
+	Inherited = Threads;
+	for(unsigned int i = 0; i < pcCounters; i++)
+	{
+		Handles[i] = -1;
+		Order[i] = 0;
+		StartValues.Counts[i] = 0;
+	}
+#if defined(__linux__)
+	static const std::uint64_t configs[pcCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+	for(unsigned int i = 0; i < pcCounters; i++)
+	{
+		struct perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.inherit = Inherited ? 1 : 0;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		int leader = (Opened > 0) ? Handles[Order[0]] : -1;
+		int handle = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC);
+		if(handle < 0 && errno == EINVAL && Inherited && Opened == 0)  // no inherited groups in this kernel
+		{
+			Inherited = false;
+			attr.inherit = 0;
+			handle = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC);
+		}
+		if(handle < 0)
+		{
+			if(!Error.empty()) continue;
+			Error = std::string(GetName((ECounter)i)) + ": " + std::strerror(errno);
+			if(errno == EACCES || errno == EPERM) Error += " (see /proc/sys/kernel/perf_event_paranoid)";
+			else if(errno == ENOENT || errno == EOPNOTSUPP) Error += " (no hardware counters, as in some virtual machines)";
+			continue;
+		}
+		Handles[i] = handle;
+		Order[Opened++] = i;
+	}
+#else
+	Error = "performance counters are only supported on Linux";
+#endif
+}
+
+/*!
+ * \brief Destructor of the class, closing the counters.
+ */
+TPerfCounters::~TPerfCounters()
+{
+#if defined(__linux__)
+	for(unsigned int i = 0; i < pcCounters; i++)
+	{
+		if(Handles[i] >= 0) close(Handles[i]);
+	}
+#endif
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Read the counts since the counters were opened.
+ * \param Values Counts (scaled if the counters were multiplexed, zero for the unavailable ones).
+ * \return False if no counter is available or the read failed.
+ */
+bool TPerfCounters::Read(TValues &Values) const
+{
+	for(unsigned int i = 0; i < pcCounters; i++) Values.Counts[i] = 0;
+#if defined(__linux__)
+	if(Opened == 0) return false;
+	// group format: number of counters, time enabled, time running and the values, in opening order
+	std::uint64_t buffer[3 + pcCounters];
+	ssize_t size = read(Handles[Order[0]], buffer, sizeof(buffer));
+	if(size < (ssize_t)(3 * sizeof(std::uint64_t)) || buffer[0] != Opened) return false;
+	double scale = (buffer[2] > 0) ? (double)buffer[1] / (double)buffer[2] : 0;
+	for(unsigned int k = 0; k < Opened; k++) Values.Counts[Order[k]] = (double)buffer[3 + k] * scale;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*!
+ * \brief Mark the beginning of a region.
+ */
+void TPerfCounters::Start()
+{
+	Read(StartValues);
+}
+
+/*!
+ * \brief Mark the end of a region.
+ * \return Counts since Start() (zero for the unavailable counters).
+ */
+TPerfCounters::TValues TPerfCounters::Stop()
+{
+	TValues values;
+	if(!Read(values)) return values;
+	for(unsigned int i = 0; i < pcCounters; i++) values.Counts[i] -= StartValues.Counts[i];
+	return values;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Check if any counter is available.
+ * \return True if at least one counter was opened.
+ */
+bool TPerfCounters::IsAvailable() const
+{
+	return Opened > 0;
+}
+
+/*!
+ * \brief Check if the counts include the threads created by the calling thread.
+ * \return True if they do, false if only the calling thread is counted.
+ */
+bool TPerfCounters::IsInherited() const
+{
+	return Inherited && Opened > 0;
+}
+
+/*!
+ * \brief Check if a counter is available.
+ * \param Counter Counter.
+ * \return True if it was opened.
+ */
+bool TPerfCounters::IsAvailable(ECounter Counter) const
+{
+	return Counter < pcCounters && Handles[Counter] >= 0;
+}
+
+/*!
+ * \brief Reason of the unavailable counters.
+ * \return Message of the first counter that couldn't be opened (empty if all were).
+ */
+const std::string &TPerfCounters::GetError() const
+{
+	return Error;
+}
+
+/*!
+ * \brief Name of a counter, for reports.
+ * \param Counter Counter.
+ * \return Name of the counter.
+ */
+const char *TPerfCounters::GetName(ECounter Counter)
+{
+	switch(Counter)
+	{
+	case pcCycles: return "cycles";
+	case pcInstructions: return "instructions";
+	case pcCacheMisses: return "cache-misses";
+	case pcBranchMisses: return "branch-misses";
+	default: return "";
+	}
+}
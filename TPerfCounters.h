@@ -0,0 +1,73 @@
+#ifndef TPerfCountersH
+#define TPerfCountersH
+
+#include <cstdint>
+#include <string>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Hardware performance counters of the calling thread, to be read alongside TPrecisionTimer.
+ *
+ * On Linux the counters (cycles, instructions, cache misses and branch misses, in user mode) are
+ * opened with perf_event_open as a single group, so they're scheduled together, and read with
+ * one system call; if the kernel multiplexes them, the counts are scaled by the time they ran.
+ * Counters that can't be opened (no PMU in a virtual machine, perf_event_paranoid restrictions,
+ * other platforms) are simply unavailable: the object still works, IsAvailable() tells which
+ * counters are valid and GetError() why the others aren't.
+ *
+ * Each read is a system call (about a microsecond), so counters suit regions of some
+ * microseconds or longer, or loops of many iterations.
+ *
+ * By default only the calling thread is counted. With Threads (perf "inherit"), the counts also
+ * include the threads it creates after the counters are opened, such as the workers of Moda or
+ * TMultiFitCV; threads that already existed (pools started earlier) are never counted. Kernels
+ * that can't read inherited groups fall back to the calling thread, as told by IsInherited().
+ */
+class TPerfCounters
+{
+public:
+	enum ECounter  /*!< Counters that can be read. */
+	{
+		pcCycles = 0,     /*!< Processor cycles. */
+		pcInstructions,   /*!< Instructions retired. */
+		pcCacheMisses,    /*!< Last level cache misses. */
+		pcBranchMisses,   /*!< Mispredicted branches. */
+		pcCounters        /*!< Number of counters. */
+	};
+
+	struct TValues  /*!< Counts of the counters (zero for the unavailable ones). */
+	{
+		double Counts[pcCounters];  /*!< Count of each counter (see ECounter). */
+	};
+
+private:
+	int Handles[pcCounters];        /*!< Descriptor of each counter (-1 if it's unavailable). */
+	unsigned int Order[pcCounters]; /*!< Counters in the order they're read from the group. */
+	unsigned int Opened;            /*!< Number of counters opened. */
+	std::string Error;              /*!< Reason of the unavailable counters (empty if all are available). */
+	bool Inherited;                 /*!< True if the threads created by the calling thread are counted too. */
+	TValues StartValues;            /*!< Counts at Start(). */
+
+public:
+	TPerfCounters(bool Threads = false);
+	virtual ~TPerfCounters();
+	TPerfCounters(const TPerfCounters&) = delete;
+	TPerfCounters &operator = (const TPerfCounters&) = delete;
+
+	// counting
+	bool Read(TValues &Values) const;
+	void Start();
+	TValues Stop();
+
+	// information
+	bool IsAvailable() const;
+	bool IsAvailable(ECounter Counter) const;
+	bool IsInherited() const;
+	const std::string &GetError() const;
+	static const char *GetName(ECounter Counter);
+};
+
+//---------------------------------------------------------------------------
+
+#endif
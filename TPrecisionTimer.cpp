@@ -1,17 +1,169 @@
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TPRECISIONTIMER_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
 #include "TPrecisionTimer.h"
 
 //---------------------------------------------------------------------------
 
+/*!
+ * \brief Clock actually used for a requested clock.
+ * \param Clock Requested clock.
+ * \return The clock, or the default one of the platform if it isn't available.
+ */
+TPrecisionTimer::EClock TPrecisionTimer::Resolve(EClock Clock)
+{
+#if !defined(_WIN32)
+	if(Clock == ckPerformanceCounter) Clock = ckDefault;
+#endif
+#if !defined(__linux__)
+	if(Clock == ckMonotonicRaw) Clock = ckDefault;
+#endif
+	if(Clock == ckTsc && !HasInvariantTsc()) Clock = ckDefault;
+	if(Clock != ckDefault) return Clock;
+#if defined(_WIN32)
+	return ckPerformanceCounter;
+#elif defined(__linux__)
+	return ckMonotonicRaw;
+#else
+	return ckSteadyClock;
+#endif
+}
+
+/*!
+ * \brief Current count of a clock.
+ * \param Clock Clock to be read (already resolved).
+ * \return Ticks of the clock.
+ */
+std::uint64_t TPrecisionTimer::ReadTicks(EClock Clock)
+{
+	switch(Clock)
+	{
+#if defined(TPRECISIONTIMER_X86)
+	case ckTsc:
+	{
+		// the fences keep the measured code from moving across the read
+		_mm_lfence();
+		std::uint64_t ticks = __rdtsc();
+		_mm_lfence();
+		return ticks;
+	}
+#endif
+#if defined(__linux__)
+	case ckMonotonicRaw:
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+		return (std::uint64_t)now.tv_sec * 1000000000ULL + (std::uint64_t)now.tv_nsec;
+	}
+#endif
+#if defined(_WIN32)
+	case ckPerformanceCounter:
+	{
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		return (std::uint64_t)now.QuadPart;
+	}
+#endif
+	default:
+		return (std::uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+}
+
+/*!
+ * \brief Duration of a tick of a clock.
+ * \param Clock Clock (already resolved).
+ * \return Seconds per tick (the TSC is calibrated at the first call, busy waiting for 20 ms).
+ */
+double TPrecisionTimer::GetTickSeconds(EClock Clock)
+{
+	switch(Clock)
+	{
+	case ckTsc:
+	{
+		static const double seconds = []()
+		{
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now(), end;
+			std::uint64_t first = ReadTicks(ckTsc);
+			do end = std::chrono::steady_clock::now();
+			while(end - begin < std::chrono::milliseconds(20));
+			std::uint64_t last = ReadTicks(ckTsc);
+			return std::chrono::duration<double>(end - begin).count() / (double)(last - first);
+		}();
+		return seconds;
+	}
+	case ckMonotonicRaw:
+		return 1e-9;
+#if defined(_WIN32)
+	case ckPerformanceCounter:
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return 1.0 / (double)frequency.QuadPart;
+	}
+#endif
+	default:
+		return (double)std::chrono::steady_clock::period::num / (double)std::chrono::steady_clock::period::den;
+	}
+}
+
+/*!
+ * \brief Cost of reading a clock twice, as done by a Start()/Stop() pair.
+ * \param Clock Clock (already resolved).
+ * \return Median of 1001 measures, in seconds (measured once per clock).
+ */
+double TPrecisionTimer::MeasureOverhead(EClock Clock)
+{
+	static std::once_flag flags[ckPerformanceCounter + 1];
+	static double overheads[ckPerformanceCounter + 1];
+	std::call_once(flags[Clock], [Clock]()
+	{
+		std::vector<std::uint64_t> samples(1001);
+		for(std::size_t i = 0; i < samples.size(); i++)
+		{
+			std::uint64_t begin = ReadTicks(Clock);
+			samples[i] = ReadTicks(Clock) - begin;
+		}
+		std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+		overheads[Clock] = (double)samples[samples.size() / 2] * GetTickSeconds(Clock);
+	});
+	return overheads[Clock];
+}
+
+//---------------------------------------------------------------------------
+
 /*!
  * \brief Default constructor of the class.
  *
- * Here we'll initializate the frequency counter with the maximum that the
- * hardware can support.
+ * Here we'll choose the clock and get its frequency (the TSC is calibrated, and the
+ * overhead of each clock measured, only the first time).
+ *
+ * \param Requested Clock to be used (the default one of the platform if it isn't available).
  *
  */
-TPrecisionTimer::TPrecisionTimer()
+TPrecisionTimer::TPrecisionTimer(EClock Requested)
 {
-	QueryPerformanceFrequency(&lFreq);
+	Clock = Resolve(Requested);
+	TickSeconds = GetTickSeconds(Clock);
+	Overhead = MeasureOverhead(Clock);
+	lStart = ReadTicks(Clock);
 }
 
 /*!
@@ -32,7 +184,7 @@ TPrecisionTimer::~TPrecisionTimer()
  */
 void TPrecisionTimer::Start()
 {
-	QueryPerformanceCounter(&lStart);
+	lStart = ReadTicks(Clock);
 }
 
 /*!
@@ -42,13 +194,90 @@ void TPrecisionTimer::Start()
  * course it won't stop the timing of clocks, it justs get a new mark so we can
  * calculate the time elapsed.
  *
- * \return  A high precision decimal containing the interval measured, in seconds (the precision takes cares of milliseconds).
+ * \return  A high precision decimal containing the interval measured, in seconds (including GetOverhead()).
  *
  */
 double TPrecisionTimer::Stop()
 {
-	LARGE_INTEGER lEnd;
-	QueryPerformanceCounter(&lEnd);
-	return (double(lEnd.QuadPart - lStart.QuadPart) / lFreq.QuadPart);
+	std::uint64_t lEnd = ReadTicks(Clock);
+	return (double)(lEnd - lStart) * TickSeconds;
 }
 
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Current count of the clock.
+ * \return Ticks of the clock (only differences are meaningful).
+ */
+std::uint64_t TPrecisionTimer::GetTicks() const
+{
+	return ReadTicks(Clock);
+}
+
+/*!
+ * \brief Convert ticks of the clock to seconds.
+ * \param Ticks Difference of two counts returned by GetTicks().
+ * \return Interval in seconds.
+ */
+double TPrecisionTimer::GetSeconds(std::uint64_t Ticks) const
+{
+	return (double)Ticks * TickSeconds;
+}
+
+/*!
+ * \brief Clock in use.
+ * \return Clock (never ckDefault).
+ */
+TPrecisionTimer::EClock TPrecisionTimer::GetClock() const
+{
+	return Clock;
+}
+
+/*!
+ * \brief Name of the clock in use, for reports.
+ * \return Name of the clock.
+ */
+const char *TPrecisionTimer::GetClockName() const
+{
+	switch(Clock)
+	{
+	case ckTsc: return "tsc";
+	case ckMonotonicRaw: return "clock_gettime(CLOCK_MONOTONIC_RAW)";
+	case ckPerformanceCounter: return "QueryPerformanceCounter";
+	default: return "steady_clock";
+	}
+}
+
+/*!
+ * \brief Cost of a Start()/Stop() pair, to be subtracted from very short intervals.
+ * \return Overhead in seconds.
+ */
+double TPrecisionTimer::GetOverhead() const
+{
+	return Overhead;
+}
+
+/*!
+ * \brief Check if the processor has a time-stamp counter that runs at a constant rate in all states.
+ * \return True for x86 processors that report an invariant TSC.
+ */
+bool TPrecisionTimer::HasInvariantTsc()
+{
+#if defined(TPRECISIONTIMER_X86)
+	unsigned int edx;
+#if defined(_MSC_VER)
+	int registers[4];
+	__cpuid(registers, 0x80000000);
+	if((unsigned int)registers[0] < 0x80000007) return false;
+	__cpuid(registers, 0x80000007);
+	edx = (unsigned int)registers[3];
+#else
+	unsigned int eax, ebx, ecx;
+	if(__get_cpuid_max(0x80000000, NULL) < 0x80000007) return false;
+	__cpuid(0x80000007, eax, ebx, ecx, edx);
+#endif
+	return (edx & (1U << 8)) != 0;
+#else
+	return false;
+#endif
+}
@@ -1,6 +1,8 @@
 #ifndef TPrecisionTimerH
 #define TPrecisionTimerH
 
+#include <cstdint>
+
 //---------------------------------------------------------------------------
 
 /*!
@@ -11,22 +13,55 @@
  * it to benchmark some parts of the code. It might slow down things a little bit,
  * so I wouldn't recommend for release versions.
  *
+ * The clock can be chosen: QueryPerformanceCounter (Windows), clock_gettime with
+ * CLOCK_MONOTONIC_RAW (Linux), std::chrono::steady_clock (anywhere) or the processor
+ * time-stamp counter (x86 with an invariant TSC, calibrated once against steady_clock).
+ * A clock that isn't available falls back to the default one of the platform. The cost of
+ * a Start()/Stop() pair is measured once per clock (GetOverhead), so it can be subtracted
+ * from very short intervals.
+ *
  */
 class TPrecisionTimer
 {
+public:
+	enum EClock  /*!< Clocks that can be used. */
+	{
+		ckDefault,             /*!< QueryPerformanceCounter on Windows, CLOCK_MONOTONIC_RAW on Linux, steady_clock elsewhere. */
+		ckSteadyClock,         /*!< std::chrono::steady_clock. */
+		ckMonotonicRaw,        /*!< clock_gettime(CLOCK_MONOTONIC_RAW) (Linux only). */
+		ckTsc,                 /*!< Time-stamp counter (x86 with invariant TSC only). */
+		ckPerformanceCounter   /*!< QueryPerformanceCounter (Windows only). */
+	};
+
 private:
-	LARGE_INTEGER lFreq;   /*!< Clock frequency per second. */
-	LARGE_INTEGER lStart;  /*!< How many clocks counted from the start to stop. */
+	EClock Clock;          /*!< Clock in use (never ckDefault). */
+	double TickSeconds;    /*!< Seconds per tick of the clock. */
+	double Overhead;       /*!< Seconds taken by a Start()/Stop() pair. */
+	std::uint64_t lStart;  /*!< Ticks counted at Start(). */
+
+	// support functions
+	static EClock Resolve(EClock Clock);
+	static std::uint64_t ReadTicks(EClock Clock);
+	static double GetTickSeconds(EClock Clock);
+	static double MeasureOverhead(EClock Clock);
 
 public:
-	TPrecisionTimer();
+	TPrecisionTimer(EClock Requested = ckDefault);
 	virtual ~TPrecisionTimer();
 	void Start();
 	double Stop();
+
+	// raw ticks (for timing many intervals with a single timer)
+	std::uint64_t GetTicks() const;
+	double GetSeconds(std::uint64_t Ticks) const;
+
+	// information
+	EClock GetClock() const;
+	const char *GetClockName() const;
+	double GetOverhead() const;
+	static bool HasInvariantTsc();
 };
 
 //---------------------------------------------------------------------------
 
 #endif
-
-
@@ -0,0 +1,553 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TPROFILER_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "TProfiler.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Global state of the profiler.
+ */
+struct TProfiler::TState
+{
+	std::mutex Mutex;                        /*!< Protects the names, the threads and the retired histograms. */
+	std::vector<std::string> Names;          /*!< Names of the sites, by identifier. */
+	std::vector<TThreadData*> Threads;       /*!< Histograms of the running threads. */
+	std::vector<TTotals> Retired;            /*!< Histograms merged from finished threads, by site. */
+	std::atomic<std::uint64_t> Epoch{0};     /*!< Incremented by Reset(). */
+	std::atomic<bool> Enabled{true};         /*!< False if scopes shouldn't record. */
+	std::atomic<bool> Counting{false};       /*!< True if scopes should read the hardware counters. */
+
+	std::thread Dumper;                  /*!< Thread of the periodic dump. */
+	bool Dumping = false;                /*!< True while the dump thread should run (protected by DumpMutex). */
+	std::mutex DumpMutex;                /*!< Mutex of the dump thread sleep. */
+	std::condition_variable DumpSignal;  /*!< Wakes the dump thread when it's stopped. */
+
+	void StopDumper();
+	~TState();
+};
+
+/*!
+ * \brief Stop the dump thread, waiting for its last dump (nothing happens if it isn't running).
+ */
+void TProfiler::TState::StopDumper()
+{
+	{
+		std::lock_guard<std::mutex> lock(DumpMutex);
+		if(!Dumper.joinable()) return;
+		Dumping = false;
+	}
+	DumpSignal.notify_all();
+	Dumper.join();
+}
+
+/*!
+ * \brief Destructor of the state, at exit: a dump thread still running is stopped (destroying a running std::thread would terminate the program).
+ */
+TProfiler::TState::~TState()
+{
+	StopDumper();
+}
+
+/*!
+ * \brief Read the clock of the profiler.
+ *
+ * The TSC is read directly, without the fences of TPrecisionTimer: scopes are much longer than
+ * the few instructions that may be reordered around the read, and the fences would cost more
+ * than the read itself.
+ *
+ * \param Timer Timer that gives the clock.
+ * \return Ticks of the clock.
+ */
+static inline std::uint64_t ReadClock(const TPrecisionTimer &Timer)
+{
+#if defined(TPROFILER_X86)
+	if(Timer.GetClock() == TPrecisionTimer::ckTsc) return __rdtsc();
+#endif
+	return Timer.GetTicks();
+}
+
+/*!
+ * \brief Bin of an interval.
+ * \param Ticks Interval, in ticks.
+ * \return Bin index, below 2^SubBits for exact small counts, and 2^SubBits per power of two after that.
+ */
+static inline unsigned int BinOf(std::uint64_t Ticks)
+{
+	if(Ticks < (1U << TProfiler::SubBits)) return (unsigned int)Ticks;
+#if defined(__GNUC__)
+	unsigned int msb = 63 - (unsigned int)__builtin_clzll(Ticks);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, Ticks);
+	unsigned int msb = (unsigned int)index;
+#else
+	unsigned int msb = 0;
+	while(Ticks >> (msb + 1)) msb++;
+#endif
+	unsigned int shift = msb - TProfiler::SubBits;
+	return ((shift + 1) << TProfiler::SubBits) + (unsigned int)((Ticks >> shift) & ((1U << TProfiler::SubBits) - 1));
+}
+
+/*!
+ * \brief Lower edge of a bin.
+ * \param Bin Bin index.
+ * \return First tick count of the bin (as a double, since the last bins pass 2^63).
+ */
+static inline double BinLowerTicks(unsigned int Bin)
+{
+	if(Bin < (1U << TProfiler::SubBits)) return (double)Bin;
+	unsigned int shift = (Bin >> TProfiler::SubBits) - 1;
+	return std::ldexp((double)((1U << TProfiler::SubBits) + (Bin & ((1U << TProfiler::SubBits) - 1))), (int)shift);
+}
+
+/*!
+ * \brief Upper edge of a bin.
+ * \param Bin Bin index.
+ * \return Tick count after the last one of the bin.
+ */
+static inline double BinUpperTicks(unsigned int Bin)
+{
+	if(Bin < (1U << TProfiler::SubBits)) return (double)Bin + 1;
+	return BinLowerTicks(Bin) + std::ldexp(1.0, (int)(Bin >> TProfiler::SubBits) - 1);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Constructor of a site histogram, with no intervals.
+ */
+TProfiler::TSiteData::TSiteData()
+{
+	Clear();
+}
+
+/*!
+ * \brief Remove the intervals of a site histogram (only by its owner, or under the state mutex).
+ */
+void TProfiler::TSiteData::Clear()
+{
+	Count.store(0, std::memory_order_relaxed);
+	Sum.store(0, std::memory_order_relaxed);
+	Min.store(UINT64_MAX, std::memory_order_relaxed);
+	Max.store(0, std::memory_order_relaxed);
+	for(unsigned int i = 0; i < Bins; i++) Counts[i].store(0, std::memory_order_relaxed);
+	Counted.store(0, std::memory_order_relaxed);
+	for(unsigned int i = 0; i < TPerfCounters::pcCounters; i++) Events[i].store(0, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Add the intervals of a site histogram to merged ones.
+ * \param Totals Merged histogram.
+ */
+void TProfiler::TSiteData::AddTo(TTotals &Totals) const
+{
+	std::uint64_t count = Count.load(std::memory_order_acquire);
+	if(count == 0) return;
+	if(Totals.Counts.empty()) Totals.Counts.assign(Bins, 0);
+	Totals.Count += count;
+	Totals.Sum += Sum.load(std::memory_order_relaxed);
+	Totals.Min = std::min(Totals.Min, Min.load(std::memory_order_relaxed));
+	Totals.Max = std::max(Totals.Max, Max.load(std::memory_order_relaxed));
+	for(unsigned int i = 0; i < Bins; i++) Totals.Counts[i] += Counts[i].load(std::memory_order_relaxed);
+	Totals.Counted += Counted.load(std::memory_order_relaxed);
+	for(unsigned int i = 0; i < TPerfCounters::pcCounters; i++) Totals.Events[i] += Events[i].load(std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Constructor of a merged histogram, with no intervals.
+ */
+TProfiler::TTotals::TTotals()
+{
+	Count = 0;
+	Sum = 0;
+	Min = UINT64_MAX;
+	Max = 0;
+	Counted = 0;
+	for(unsigned int i = 0; i < TPerfCounters::pcCounters; i++) Events[i] = 0;
+}
+
+/*!
+ * \brief Constructor of the histograms of a thread, registering them.
+ */
+TProfiler::TThreadData::TThreadData()
+{
+	TState &state = GetState();
+	for(unsigned int i = 0; i < MaxSites; i++) Sites[i].store(NULL, std::memory_order_relaxed);
+	Epoch.store(state.Epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	Counters = NULL;
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	state.Threads.push_back(this);
+}
+
+/*!
+ * \brief Destructor of the histograms of a thread: they're merged into the retired ones and unregistered.
+ */
+TProfiler::TThreadData::~TThreadData()
+{
+	TState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	state.Threads.erase(std::find(state.Threads.begin(), state.Threads.end(), this));
+	bool current = Epoch.load(std::memory_order_relaxed) == state.Epoch.load(std::memory_order_relaxed);
+	for(unsigned int i = 0; i < MaxSites; i++)
+	{
+		TSiteData *site = Sites[i].load(std::memory_order_relaxed);
+		if(site == NULL) continue;
+		if(current)
+		{
+			if(state.Retired.size() <= i) state.Retired.resize(i + 1);
+			site->AddTo(state.Retired[i]);
+		}
+		delete site;
+	}
+	delete Counters;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Register a site.
+ * \param Name Name of the site (sites with the same name are reported separately).
+ */
+TProfiler::TSite::TSite(const char *Name)
+{
+	TState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	Id = (state.Names.size() < MaxSites) ? (unsigned int)state.Names.size() : MaxSites;
+	if(Id < MaxSites) state.Names.push_back(Name);
+}
+
+/*!
+ * \brief Start timing a scope.
+ * \param Site Site of the scope.
+ */
+TProfiler::TScope::TScope(const TSite &Site)
+{
+	TState &state = GetState();
+	Id = (state.Enabled.load(std::memory_order_relaxed)) ? Site.Id : MaxSites;
+	Counters = NULL;
+	if(Id < MaxSites && state.Counting.load(std::memory_order_relaxed))
+	{
+		// the counters are read before the clock, so the system call isn't timed
+		TThreadData &thread = GetThreadData();
+		if(thread.Counters == NULL) thread.Counters = new TPerfCounters();
+		if(thread.Counters->Read(StartCounts)) Counters = thread.Counters;
+	}
+	Start = (Id < MaxSites) ? ReadClock(GetTimer()) : 0;
+}
+
+/*!
+ * \brief Stop timing a scope, recording its interval.
+ */
+TProfiler::TScope::~TScope()
+{
+	if(Id >= MaxSites) return;
+	std::uint64_t ticks = ReadClock(GetTimer()) - Start;
+	TPerfCounters::TValues events;
+	if(Counters != NULL && Counters->Read(events))
+	{
+		for(unsigned int i = 0; i < TPerfCounters::pcCounters; i++) events.Counts[i] -= StartCounts.Counts[i];
+		Record(Id, ticks, &events);
+	}
+	else Record(Id, ticks, NULL);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Global state of the profiler (a function static, so sites and threads can use it during static initialization).
+ * \return Reference to the state.
+ */
+TProfiler::TState &TProfiler::GetState()
+{
+	static TState state;
+	return state;
+}
+
+/*!
+ * \brief Timer that gives the clock of the profiler.
+ * \return Reference to the timer (created at the first use).
+ */
+const TPrecisionTimer &TProfiler::GetTimer()
+{
+	static const TPrecisionTimer timer(TPrecisionTimer::ckTsc);
+	return timer;
+}
+
+/*!
+ * \brief Current ticks of the profiler clock (to time intervals recorded elsewhere, in the same unit as the bins).
+ * \return Ticks (only differences are meaningful).
+ */
+std::uint64_t TProfiler::GetTicks()
+{
+	return ReadClock(GetTimer());
+}
+
+/*!
+ * \brief Histograms of the calling thread.
+ * \return Reference to them (created and registered at the first use in the thread).
+ */
+TProfiler::TThreadData &TProfiler::GetThreadData()
+{
+	static thread_local TThreadData data;
+	return data;
+}
+
+/*!
+ * \brief Record an interval in the histogram of the calling thread.
+ *
+ * Only the owner thread writes its histograms, so the counters are updated with plain relaxed
+ * loads and stores (readers may see a snapshot that is a few intervals behind).
+ *
+ * \param Id Site of the interval.
+ * \param Ticks Interval, in ticks.
+ * \param Events Hardware counters of the interval (NULL if they weren't read).
+ */
+void TProfiler::Record(unsigned int Id, std::uint64_t Ticks, const TPerfCounters::TValues *Events)
+{
+	TThreadData &thread = GetThreadData();
+	std::uint64_t epoch = GetState().Epoch.load(std::memory_order_relaxed);
+	if(thread.Epoch.load(std::memory_order_relaxed) != epoch)
+	{
+		for(unsigned int i = 0; i < MaxSites; i++)
+		{
+			TSiteData *site = thread.Sites[i].load(std::memory_order_relaxed);
+			if(site != NULL) site->Clear();
+		}
+		thread.Epoch.store(epoch, std::memory_order_release);
+	}
+	TSiteData *site = thread.Sites[Id].load(std::memory_order_relaxed);
+	if(site == NULL)
+	{
+		site = new TSiteData();
+		thread.Sites[Id].store(site, std::memory_order_release);
+	}
+	unsigned int bin = BinOf(Ticks);
+	site->Counts[bin].store(site->Counts[bin].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	site->Sum.store(site->Sum.load(std::memory_order_relaxed) + Ticks, std::memory_order_relaxed);
+	if(Ticks < site->Min.load(std::memory_order_relaxed)) site->Min.store(Ticks, std::memory_order_relaxed);
+	if(Ticks > site->Max.load(std::memory_order_relaxed)) site->Max.store(Ticks, std::memory_order_relaxed);
+	if(Events != NULL)
+	{
+		for(unsigned int i = 0; i < TPerfCounters::pcCounters; i++)
+		{
+			double count = std::max(Events->Counts[i], 0.0);
+			site->Events[i].store(site->Events[i].load(std::memory_order_relaxed) + (std::uint64_t)(count + 0.5), std::memory_order_relaxed);
+		}
+		site->Counted.store(site->Counted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	site->Count.store(site->Count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Enable or disable the recording of scopes (scopes already started are still recorded).
+ * \param Enabled True to record.
+ */
+void TProfiler::SetEnabled(bool Enabled)
+{
+	GetState().Enabled.store(Enabled, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Check if scopes are recorded.
+ * \return True if they are.
+ */
+bool TProfiler::IsEnabled()
+{
+	return GetState().Enabled.load(std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Make the scopes read the hardware counters of their threads (opened at the first scope of each thread).
+ * \param Enabled True to read them.
+ * \return False if they were enabled but aren't available in the calling thread.
+ */
+bool TProfiler::SetCounters(bool Enabled)
+{
+	GetState().Counting.store(Enabled, std::memory_order_relaxed);
+	if(!Enabled) return true;
+	TThreadData &thread = GetThreadData();
+	if(thread.Counters == NULL) thread.Counters = new TPerfCounters();
+	return thread.Counters->IsAvailable();
+}
+
+/*!
+ * \brief Merge the histograms of all the threads, without stopping them.
+ * \param Stats Statistics of each site with intervals, in the order the sites were created.
+ * \return Number of sites in Stats.
+ */
+std::size_t TProfiler::Snapshot(std::vector<TSiteStats> &Stats)
+{
+	TState &state = GetState();
+	const TPrecisionTimer &timer = GetTimer();
+	Stats.clear();
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	std::uint64_t epoch = state.Epoch.load(std::memory_order_relaxed);
+	for(unsigned int id = 0; id < state.Names.size(); id++)
+	{
+		TTotals totals = (id < state.Retired.size()) ? state.Retired[id] : TTotals();
+		for(std::size_t t = 0; t < state.Threads.size(); t++)
+		{
+			if(state.Threads[t]->Epoch.load(std::memory_order_acquire) != epoch) continue;
+			const TSiteData *site = state.Threads[t]->Sites[id].load(std::memory_order_acquire);
+			if(site != NULL) site->AddTo(totals);
+		}
+		if(totals.Count == 0) continue;
+		const std::vector<std::uint64_t> &counts = totals.Counts;
+
+		TSiteStats stats;
+		stats.Name = state.Names[id];
+		stats.Count = totals.Count;
+		stats.Total = timer.GetSeconds(totals.Sum);
+		stats.Mean = stats.Total / (double)totals.Count;
+		stats.Min = timer.GetSeconds(totals.Min);
+		stats.Max = timer.GetSeconds(totals.Max);
+		// percentiles interpolated inside their bins (the bins may hold a few more intervals than Count, if a thread was recording)
+		std::uint64_t total = 0;
+		for(unsigned int b = 0; b < Bins; b++) total += counts[b];
+		const double p[4] = {0.5, 0.9, 0.99, 0.999};
+		double *values[4] = {&stats.P50, &stats.P90, &stats.P99, &stats.P999};
+		unsigned int b = 0;
+		std::uint64_t below = 0;
+		for(unsigned int k = 0; k < 4; k++)
+		{
+			double target = p[k] * (double)total;
+			while(b + 1 < Bins && (double)(below + counts[b]) < target) below += counts[b++];
+			double fraction = (counts[b] > 0) ? (target - (double)below) / (double)counts[b] : 0;
+			double ticks = BinLowerTicks(b) + fraction * (BinUpperTicks(b) - BinLowerTicks(b));
+			*values[k] = std::min(std::max(ticks, (double)totals.Min), (double)totals.Max) * timer.GetSeconds(1);
+		}
+		double counted = (double)std::max(totals.Counted, (std::uint64_t)1);
+		stats.Cycles = (double)totals.Events[TPerfCounters::pcCycles] / counted;
+		stats.Instructions = (double)totals.Events[TPerfCounters::pcInstructions] / counted;
+		stats.CacheMisses = (double)totals.Events[TPerfCounters::pcCacheMisses] / counted;
+		stats.BranchMisses = (double)totals.Events[TPerfCounters::pcBranchMisses] / counted;
+		stats.Counts = counts;
+		Stats.push_back(stats);
+	}
+	return Stats.size();
+}
+
+/*!
+ * \brief Remove the intervals of all sites (each thread clears its histograms at its next interval).
+ */
+void TProfiler::Reset()
+{
+	TState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.Mutex);
+	state.Epoch.fetch_add(1, std::memory_order_relaxed);
+	state.Retired.clear();
+}
+
+/*!
+ * \brief Lower edge of a bin of TSiteStats::Counts.
+ * \param Bin Bin index.
+ * \return Shortest interval of the bin, in seconds.
+ */
+double TProfiler::GetBinLower(unsigned int Bin)
+{
+	return BinLowerTicks(Bin) * GetTimer().GetSeconds(1);
+}
+
+/*!
+ * \brief Upper edge of a bin of TSiteStats::Counts.
+ * \param Bin Bin index.
+ * \return Interval after the longest one of the bin, in seconds.
+ */
+double TProfiler::GetBinUpper(unsigned int Bin)
+{
+	return BinUpperTicks(Bin) * GetTimer().GetSeconds(1);
+}
+
+/*!
+ * \brief Write a snapshot to a CSV file (one line per site, times in nanoseconds).
+ *
+ * The file is written under a temporary name and renamed, so readers never see it half-written.
+ *
+ * \param FileName File name (may include full pathname).
+ * \return True if the file was written.
+ */
+bool TProfiler::Dump(const char *FileName)
+{
+	std::vector<TSiteStats> stats;
+	Snapshot(stats);
+	std::string temporary = std::string(FileName) + ".tmp";
+	std::fstream file;
+	file.open(temporary.c_str(), std::fstream::out);
+	if(!file.is_open()) return false;
+	file << "site,count,total_s,mean_ns,min_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,cycles,instructions,ipc,cache_misses,branch_misses\n";
+	for(std::size_t i = 0; i < stats.size(); i++)
+	{
+		const TSiteStats &s = stats[i];
+		file << '"' << s.Name << "\"," << s.Count << ',' << s.Total << ',' << s.Mean * 1e9 << ',' << s.Min * 1e9 << ',' << s.P50 * 1e9 << ','
+		     << s.P90 * 1e9 << ',' << s.P99 * 1e9 << ',' << s.P999 * 1e9 << ',' << s.Max * 1e9 << ','
+		     << s.Cycles << ',' << s.Instructions << ',' << ((s.Cycles > 0) ? s.Instructions / s.Cycles : 0) << ',' << s.CacheMisses << ',' << s.BranchMisses << '\n';
+	}
+	file.close();
+	if(file.fail()) return false;
+	std::error_code error;
+	std::filesystem::rename(temporary, FileName, error);
+	return !error;
+}
+
+/*!
+ * \brief Body of the dump thread.
+ * \param FileName File name.
+ * \param Interval Milliseconds between dumps.
+ */
+void TProfiler::DumpLoop(std::string FileName, unsigned int Interval)
+{
+	TState &state = GetState();
+	std::unique_lock<std::mutex> lock(state.DumpMutex);
+	while(state.Dumping)
+	{
+		state.DumpSignal.wait_for(lock, std::chrono::milliseconds(Interval));
+		lock.unlock();
+		Dump(FileName.c_str());
+		lock.lock();
+	}
+}
+
+/*!
+ * \brief Start dumping snapshots to a file periodically, in a background thread (and once more when stopped, or at exit).
+ * \param FileName File name (may include full pathname).
+ * \param Interval Milliseconds between dumps.
+ * \return False if the dump thread was already running.
+ */
+bool TProfiler::StartDump(const char *FileName, unsigned int Interval)
+{
+	TState &state = GetState();
+	std::lock_guard<std::mutex> lock(state.DumpMutex);
+	if(state.Dumper.joinable()) return false;
+	state.Dumping = true;
+	state.Dumper = std::thread(&TProfiler::DumpLoop, std::string(FileName), Interval);
+	return true;
+}
+
+/*!
+ * \brief Stop the dump thread (nothing happens if it isn't running).
+ */
+void TProfiler::StopDump()
+{
+	GetState().StopDumper();
+}
@@ -0,0 +1,164 @@
+#ifndef TProfilerH
+#define TProfilerH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TPerfCounters.h"
+#include "TPrecisionTimer.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Always-on profiler of code scopes, with latency histograms per site.
+ *
+ * A site is a static object with a name and an identifier, created the first time its scope
+ * runs (see the TPROFILE macro), and a TScope reads the clock when it's created and destroyed.
+ * Each thread records its intervals in its own histograms, with 2^SubBits bins per power of two
+ * ticks (HDR-style, relative width of 1/16), so recording takes no locks and no atomic
+ * read-modify-write instructions. Snapshot() merges the histograms of all the threads (including
+ * the ones that already finished) while they keep recording, and a background thread can dump
+ * the snapshot to a file periodically.
+ *
+ * The TPROFILE macro only creates a scope if TPROFILER is defined when compiling, so the library
+ * sources can be instrumented (date parsing, configuration reads and fits) at no cost for builds
+ * that don't profile. The clock is the invariant TSC when the processor has one (the default one
+ * of TPrecisionTimer otherwise).
+ *
+ * SetCounters() makes the scopes also read the hardware counters of their thread (TPerfCounters),
+ * giving the mean cycles, instructions, cache misses and branch misses per interval. Each read is
+ * a system call, so it's meant for investigations of scopes of some microseconds or longer.
+ */
+class TProfiler
+{
+public:
+	static const unsigned int MaxSites = 1024;  /*!< Maximum number of sites (sites created after it are ignored). */
+	static const unsigned int SubBits = 4;      /*!< Bits of each power of two split in sub-bins. */
+	static const unsigned int Bins = (64 - SubBits + 1) << SubBits;  /*!< Bins of each histogram (all the 64-bit tick counts). */
+
+	struct TSite  /*!< Instrumented site (must be static, since it's never unregistered). */
+	{
+		unsigned int Id;   /*!< Identifier of the site (MaxSites if it was ignored). */
+		TSite(const char *Name);
+	};
+
+	class TScope  /*!< Timed scope: records the interval between its construction and destruction. */
+	{
+	private:
+		unsigned int Id;      /*!< Site of the scope (MaxSites if it isn't recorded). */
+		std::uint64_t Start;  /*!< Ticks at construction. */
+		TPerfCounters *Counters;              /*!< Counters of the thread (NULL if they aren't read). */
+		TPerfCounters::TValues StartCounts;   /*!< Counts at construction. */
+
+	public:
+		TScope(const TSite &Site);
+		~TScope();
+		TScope(const TScope&) = delete;
+		TScope &operator = (const TScope&) = delete;
+	};
+
+	struct TSiteStats  /*!< Statistics of a site (times in seconds). */
+	{
+		std::string Name;                    /*!< Name of the site. */
+		std::uint64_t Count;                 /*!< Number of intervals recorded. */
+		double Total;                        /*!< Sum of the intervals. */
+		double Mean;                         /*!< Mean interval. */
+		double Min;                          /*!< Shortest interval. */
+		double Max;                          /*!< Longest interval. */
+		double P50;                          /*!< Median. */
+		double P90;                          /*!< 90th percentile. */
+		double P99;                          /*!< 99th percentile. */
+		double P999;                         /*!< 99.9th percentile. */
+		double Cycles;                       /*!< Mean cycles per interval (zero if not counted). */
+		double Instructions;                 /*!< Mean instructions per interval (zero if not counted). */
+		double CacheMisses;                  /*!< Mean cache misses per interval (zero if not counted). */
+		double BranchMisses;                 /*!< Mean branch misses per interval (zero if not counted). */
+		std::vector<std::uint64_t> Counts;   /*!< Counts of each bin (see GetBinLower). */
+	};
+
+private:
+	struct TTotals  /*!< Merged histogram of a site (plain counters). */
+	{
+		std::uint64_t Count;                /*!< Number of intervals. */
+		std::uint64_t Sum;                  /*!< Sum of the intervals, in ticks. */
+		std::uint64_t Min;                  /*!< Shortest interval, in ticks. */
+		std::uint64_t Max;                  /*!< Longest interval, in ticks. */
+		std::vector<std::uint64_t> Counts;  /*!< Counts of each bin (empty if there are no intervals). */
+		std::uint64_t Counted;              /*!< Number of intervals with hardware counters. */
+		std::uint64_t Events[TPerfCounters::pcCounters];  /*!< Sums of the hardware counters. */
+		TTotals();
+	};
+
+	struct TSiteData  /*!< Histogram of a site in a thread (written only by its thread). */
+	{
+		std::atomic<std::uint64_t> Count;       /*!< Number of intervals. */
+		std::atomic<std::uint64_t> Sum;         /*!< Sum of the intervals, in ticks. */
+		std::atomic<std::uint64_t> Min;         /*!< Shortest interval, in ticks. */
+		std::atomic<std::uint64_t> Max;         /*!< Longest interval, in ticks. */
+		std::atomic<std::uint64_t> Counts[Bins]; /*!< Counts of each bin. */
+		std::atomic<std::uint64_t> Counted;      /*!< Number of intervals with hardware counters. */
+		std::atomic<std::uint64_t> Events[TPerfCounters::pcCounters];  /*!< Sums of the hardware counters. */
+		TSiteData();
+		void Clear();
+		void AddTo(TTotals &Totals) const;
+	};
+
+	struct TThreadData  /*!< Histograms of a thread (registered while the thread runs). */
+	{
+		std::atomic<TSiteData*> Sites[MaxSites];  /*!< Histogram of each site (NULL until the first interval). */
+		std::atomic<std::uint64_t> Epoch;         /*!< Reset() epoch of the histograms. */
+		TPerfCounters *Counters;                  /*!< Hardware counters of the thread (created at the first use). */
+		TThreadData();
+		~TThreadData();
+	};
+
+	struct TState;  /*!< Global state (sites, threads and dump thread). */
+
+	// support functions
+	static TState &GetState();
+	static const TPrecisionTimer &GetTimer();
+	static TThreadData &GetThreadData();
+	static void Record(unsigned int Id, std::uint64_t Ticks, const TPerfCounters::TValues *Events);
+	static void DumpLoop(std::string FileName, unsigned int Interval);
+
+public:
+	// switches
+	static void SetEnabled(bool Enabled);
+	static bool IsEnabled();
+	static bool SetCounters(bool Enabled);
+
+	// results
+	static std::size_t Snapshot(std::vector<TSiteStats> &Stats);
+	static void Reset();
+	static double GetBinLower(unsigned int Bin);
+	static double GetBinUpper(unsigned int Bin);
+	static bool Dump(const char *FileName);
+	static bool StartDump(const char *FileName, unsigned int Interval = 10000);
+	static void StopDump();
+
+	// clock
+	static std::uint64_t GetTicks();
+};
+
+//---------------------------------------------------------------------------
+
+#define TPROFILER_CONCAT2(A, B) A##B
+#define TPROFILER_CONCAT(A, B) TPROFILER_CONCAT2(A, B)
+
+/*!
+ * \brief Profile the rest of the current scope as a site with the given name (only if TPROFILER is defined).
+ */
+#if defined(TPROFILER)
+#define TPROFILE(Name) \
+	static const TProfiler::TSite TPROFILER_CONCAT(ProfilerSite, __LINE__)(Name); \
+	TProfiler::TScope TPROFILER_CONCAT(ProfilerScope, __LINE__)(TPROFILER_CONCAT(ProfilerSite, __LINE__))
+#else
+#define TPROFILE(Name)
+#endif
+
+//---------------------------------------------------------------------------
+
+#endif
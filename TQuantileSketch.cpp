@@ -0,0 +1,215 @@
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "TQuantileSketch.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Class constructor.
+ * \param Accuracy Capacity of the top compactor (higher is more accurate and uses more memory; at least 8).
+ * \param Seed Seed of the generator of the compaction offsets.
+ */
+TQuantileSketch::TQuantileSketch(unsigned int Accuracy, unsigned int Seed) : Random(Seed)
+{
+	K = (Accuracy < 8) ? 8 : Accuracy;
+	Clear();
+}
+
+/*!
+ * \brief Destructor (no pointers here, so nothing to declare).
+ */
+TQuantileSketch::~TQuantileSketch()
+{
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Capacity of a level, which decreases by 2/3 from the top level down (but at least 2).
+ * \param Level Index of the level.
+ * \return Maximum number of samples of the level before it's compacted.
+ */
+std::size_t TQuantileSketch::Capacity(std::size_t Level) const
+{
+	std::size_t depth = Levels.size() - 1 - Level;
+	double c = std::ceil(K * std::pow(2.0 / 3.0, (double)depth));
+	return (c < 2) ? 2 : (std::size_t)c;
+}
+
+/*!
+ * \brief Update the cached sum of the capacities of all levels (it changes only when a level is created).
+ */
+void TQuantileSketch::UpdateCapacity()
+{
+	MaxSize = 0;
+	for(std::size_t h = 0; h < Levels.size(); h++) MaxSize += Capacity(h);
+}
+
+/*!
+ * \brief Compact the lowest full levels until the samples fit in the total capacity.
+ */
+void TQuantileSketch::Compress()
+{
+	while(Size >= MaxSize)
+	{
+		for(std::size_t h = 0; h < Levels.size(); h++)
+		{
+			if(Levels[h].size() < Capacity(h)) continue;
+			if(h + 1 == Levels.size())
+			{
+				Levels.push_back(std::vector<double>());
+				UpdateCapacity();
+			}
+			std::vector<double> &level = Levels[h];
+			std::vector<double> &next = Levels[h + 1];
+			std::sort(level.begin(), level.end());
+			// an odd sample stays in this level, the others are halved to the next one
+			double odd = 0;
+			bool hasodd = (level.size() % 2) != 0;
+			if(hasodd)
+			{
+				odd = level.back();
+				level.pop_back();
+			}
+			std::size_t offset = Random() & 1;
+			std::size_t before = level.size();
+			for(std::size_t i = offset; i < level.size(); i += 2) next.push_back(level[i]);
+			level.clear();
+			if(hasodd) level.push_back(odd);
+			Size -= before - before / 2;
+			break;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Reset the sketch to an empty sequence (the accuracy is kept).
+ */
+void TQuantileSketch::Clear()
+{
+	N = 0;
+	Size = 0;
+	Lower = std::numeric_limits<double>::infinity();
+	Upper = -std::numeric_limits<double>::infinity();
+	Levels.assign(1, std::vector<double>());
+	UpdateCapacity();
+}
+
+/*!
+ * \brief Add a single value to the sketch.
+ * \param Value Value to be added.
+ */
+void TQuantileSketch::Push(double Value)
+{
+	if(Value < Lower) Lower = Value;
+	if(Value > Upper) Upper = Value;
+	Levels[0].push_back(Value);
+	N++;
+	Size++;
+	if(Size >= MaxSize) Compress();
+}
+
+/*!
+ * \brief Add a chunk of values to the sketch.
+ * \param Values Values to be added.
+ */
+void TQuantileSketch::Add(const std::vector<double> &Values)
+{
+	for(std::size_t i = 0; i < Values.size(); i++) Push(Values[i]);
+}
+
+/*!
+ * \brief Merge another sketch (for instance, of other chunk or thread) to this one.
+ * \param Other Sketch to be merged (it should have the same accuracy).
+ */
+void TQuantileSketch::Merge(const TQuantileSketch &Other)
+{
+	if(Other.N == 0) return;
+	while(Levels.size() < Other.Levels.size()) Levels.push_back(std::vector<double>());
+	UpdateCapacity();
+	for(std::size_t h = 0; h < Other.Levels.size(); h++)
+	{
+		Levels[h].insert(Levels[h].end(), Other.Levels[h].begin(), Other.Levels[h].end());
+	}
+	N += Other.N;
+	Size += Other.Size;
+	if(Other.Lower < Lower) Lower = Other.Lower;
+	if(Other.Upper > Upper) Upper = Other.Upper;
+	Compress();
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Get the number of values added to the sketch.
+ * \return Number of values (including the merged ones).
+ */
+unsigned long long TQuantileSketch::GetCount() const
+{
+	return N;
+}
+
+/*!
+ * \brief Get the number of samples actually stored.
+ * \return Number of stored samples (the memory used is proportional to it).
+ */
+std::size_t TQuantileSketch::GetSize() const
+{
+	return Size;
+}
+
+/*!
+ * \brief Estimate a single quantile.
+ * \param P Quantile, from 0.0 to 1.0.
+ * \return Estimated value of the quantile, or zero if the sketch is empty.
+ */
+double TQuantileSketch::Quantile(double P) const
+{
+	std::vector<double> p(1, P), v;
+	Quantiles(p, v);
+	return v[0];
+}
+
+/*!
+ * \brief Estimate many quantiles at once (the stored samples are sorted only once).
+ *
+ * Uses the same rank definition of Percentil: the value at position floor(P*n) of the sorted
+ * sequence; P = 0 and P = 1 return the exact minimum and maximum.
+ *
+ * \param P Quantiles, from 0.0 to 1.0, in any order.
+ * \param Values Vector that will receive the estimated values, in the same order of P.
+ */
+void TQuantileSketch::Quantiles(const std::vector<double> &P, std::vector<double> &Values) const
+{
+	Values.assign(P.size(), 0.0);
+	if(N == 0) return;
+	// weighted samples sorted by value, with cumulative weights
+	std::vector<std::pair<double,unsigned long long> > samples;
+	samples.reserve(Size);
+	for(std::size_t h = 0; h < Levels.size(); h++)
+	{
+		for(std::size_t i = 0; i < Levels[h].size(); i++) samples.push_back(std::make_pair(Levels[h][i], 1ULL << h));
+	}
+	std::sort(samples.begin(), samples.end());
+	std::vector<unsigned long long> cumulative(samples.size());
+	unsigned long long total = 0;
+	for(std::size_t i = 0; i < samples.size(); i++)
+	{
+		total += samples[i].second;
+		cumulative[i] = total;
+	}
+	for(std::size_t q = 0; q < P.size(); q++)
+	{
+		if(!(P[q] > 0)) { Values[q] = Lower; continue; }
+		if(P[q] >= 1) { Values[q] = Upper; continue; }
+		// first sample whose cumulative weight passes the rank
+		unsigned long long rank = (unsigned long long)std::floor(P[q] * total);
+		std::size_t i = std::upper_bound(cumulative.begin(), cumulative.end(), rank) - cumulative.begin();
+		Values[q] = (i < samples.size()) ? samples[i].first : Upper;
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef TQuantileSketchH
+#define TQuantileSketchH
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Streaming quantile sketch (KLL), with bounded memory and mergeable.
+ *
+ * Keeps a hierarchy of compactors: level h holds samples with weight 2^h, and when a level is full
+ * it's sorted and every other sample (with a random offset) is promoted to the next level. The
+ * capacities decrease geometrically for the lower levels, so the memory is O(K) plus a logarithmic
+ * term, and the rank error is around 1.7/K of the number of values with high probability (K = 200
+ * gives about 1%). Sketches built over different chunks (or threads) can be merged.
+ */
+class TQuantileSketch
+{
+private:
+	unsigned int K;                              /*!< Accuracy parameter (capacity of the top level). */
+	unsigned long long N;                        /*!< Number of values pushed (including merged sketches). */
+	double Lower;                                /*!< Minimum value (kept exact). */
+	double Upper;                                /*!< Maximum value (kept exact). */
+	std::vector<std::vector<double> > Levels;    /*!< Compactors; level h stores samples with weight 2^h. */
+	std::size_t Size;                            /*!< Number of samples stored in all levels. */
+	std::size_t MaxSize;                         /*!< Sum of the capacities of all levels (cached). */
+	std::minstd_rand Random;                     /*!< Generator of the compaction offsets. */
+
+	// support functions
+	std::size_t Capacity(std::size_t Level) const;
+	void UpdateCapacity();
+	void Compress();
+
+public:
+	// constructors and destructor
+	TQuantileSketch(unsigned int Accuracy = 200, unsigned int Seed = 1);
+	virtual ~TQuantileSketch();
+
+	// accumulation functions
+	void Clear();
+	void Push(double Value);
+	void Add(const std::vector<double> &Values);
+	void Merge(const TQuantileSketch &Other);
+
+	// output functions
+	unsigned long long GetCount() const;
+	std::size_t GetSize() const;
+	double Quantile(double P) const;
+	void Quantiles(const std::vector<double> &P, std::vector<double> &Values) const;
+};
+
+//---------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,313 @@
+
+#include <cmath>
+#include <functional>
+
+#include "TRollingWindow.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Sliding window reduction by block prefix and suffix scans (van Herk/Gil-Werman).
+ *
+ * The series is divided in blocks of Width values; inside each block the running reduction is
+ * calculated forward (prefix) and backward (suffix). Any window is then the suffix of the block
+ * where it starts combined with the prefix of the block where it ends, so each output costs one
+ * operation regardless of the width, without subtractions (no cancellation in the sums).
+ *
+ * \param Values Input series.
+ * \param Width Width of the window.
+ * \param Output Vector that will receive the reduction of the window ending in each position.
+ * \param Op Associative reduction (sum, minimum or maximum).
+ */
+template <class Operation> static void BlockScan(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output, Operation Op)
+{
+	std::size_t n = Values.size();
+	std::size_t w = (Width == 0) ? 1 : Width;
+	Output.resize(n);
+	if(n == 0) return;
+	std::vector<double> prefix(n), suffix(n);
+	for(std::size_t b = 0; b < n; b += w)
+	{
+		std::size_t e = (n - b < w) ? n : b + w;
+		prefix[b] = Values[b];
+		for(std::size_t i = b + 1; i < e; i++) prefix[i] = Op(prefix[i - 1], Values[i]);
+		suffix[e - 1] = Values[e - 1];
+		for(std::size_t i = e - 1; i-- > b; ) suffix[i] = Op(Values[i], suffix[i + 1]);
+	}
+	std::size_t i = 0;
+	for(; i < n && i + 1 < w; i++) Output[i] = prefix[i];
+	for(; i < n; i++)
+	{
+		std::size_t s = i + 1 - w;
+		Output[i] = (s % w == 0) ? suffix[s] : Op(suffix[s], prefix[i]);
+	}
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Class constructor.
+ * \param WindowWidth Maximum number of values in the window (at least 1).
+ */
+TRollingWindow::TRollingWindow(unsigned int WindowWidth)
+{
+	Width = (WindowWidth == 0) ? 1 : WindowWidth;
+	Clear();
+}
+
+/*!
+ * \brief Destructor (no pointers here, so nothing to declare).
+ */
+TRollingWindow::~TRollingWindow()
+{
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Recalculate the running sums from the values of the window, discarding the accumulated rounding errors.
+ */
+void TRollingWindow::Recalculate()
+{
+	Sum = T = 0;
+	for(unsigned int k = 0; k < Count; k++)
+	{
+		double v = Buffer[(Head + k) % Width];
+		Sum += v;
+		T += k * v;
+	}
+	Mean = (Count > 0) ? Sum / Count : 0.0;
+	M2 = 0;
+	for(unsigned int k = 0; k < Count; k++)
+	{
+		double d = Buffer[(Head + k) % Width] - Mean;
+		M2 += d * d;
+	}
+	Refresh = 0;
+}
+
+/*!
+ * \brief Empty the window (the width is kept).
+ */
+void TRollingWindow::Clear()
+{
+	Buffer.assign(Width, 0.0);
+	Head = Count = Refresh = 0;
+	Index = 0;
+	Sum = Mean = M2 = T = 0;
+	MinQueue.clear();
+	MaxQueue.clear();
+}
+
+/*!
+ * \brief Move the window one value forward (the oldest value leaves when the window is full).
+ * \param Value New value.
+ * \return Mean of the window after the new value, so it can be used as push-one-get-one.
+ */
+double TRollingWindow::Push(double Value)
+{
+	if(Count < Width)
+	{
+		Buffer[(Head + Count) % Width] = Value;
+		T += Count * Value;
+		Count++;
+		double delta = Value - Mean;
+		Mean += delta / Count;
+		M2 += delta * (Value - Mean);
+		Sum += Value;
+	}
+	else
+	{
+		double old = Buffer[Head];
+		Buffer[Head] = Value;
+		Head = (Head + 1 == Width) ? 0 : Head + 1;
+		T += (Width - 1.0) * Value - (Sum - old);  // every remaining value moves one position back
+		Sum += Value - old;
+		double mean = Mean;
+		Mean += (Value - old) / Width;
+		M2 += (Value - old) * (Value - Mean + old - mean);
+		if(M2 < 0) M2 = 0;
+	}
+	// monotonic queues: values that can't be the extreme of any future window are discarded
+	while(!MinQueue.empty() && MinQueue.back().second >= Value) MinQueue.pop_back();
+	MinQueue.push_back(std::make_pair(Index, Value));
+	while(MinQueue.front().first + Width <= Index) MinQueue.pop_front();
+	while(!MaxQueue.empty() && MaxQueue.back().second <= Value) MaxQueue.pop_back();
+	MaxQueue.push_back(std::make_pair(Index, Value));
+	while(MaxQueue.front().first + Width <= Index) MaxQueue.pop_front();
+	Index++;
+	if(++Refresh >= Width) Recalculate();
+	return Mean;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Get the number of values in the window.
+ * \return Number of values (up to the width).
+ */
+unsigned int TRollingWindow::GetCount() const
+{
+	return Count;
+}
+
+/*!
+ * \brief Get the sum of the values of the window.
+ * \return Sum of the window.
+ */
+double TRollingWindow::GetSum() const
+{
+	return Sum;
+}
+
+/*!
+ * \brief Get the mean of the values of the window.
+ * \return Mean of the window, or zero if it's empty.
+ */
+double TRollingWindow::GetMean() const
+{
+	return Mean;
+}
+
+/*!
+ * \brief Get the sample variance (divided by n-1) of the window.
+ * \return Variance of the window, or zero if there are less than two values.
+ */
+double TRollingWindow::GetVariance() const
+{
+	return (Count > 1) ? M2 / (Count - 1.0) : 0.0;
+}
+
+/*!
+ * \brief Get the sample standard deviation of the window.
+ * \return Standard deviation of the window, or zero if there are less than two values.
+ */
+double TRollingWindow::GetStdDev() const
+{
+	return std::sqrt(GetVariance());
+}
+
+/*!
+ * \brief Get the minimum value of the window.
+ * \return Minimum of the window, or zero if it's empty.
+ */
+double TRollingWindow::GetMin() const
+{
+	return MinQueue.empty() ? 0.0 : MinQueue.front().second;
+}
+
+/*!
+ * \brief Get the maximum value of the window.
+ * \return Maximum of the window, or zero if it's empty.
+ */
+double TRollingWindow::GetMax() const
+{
+	return MaxQueue.empty() ? 0.0 : MaxQueue.front().second;
+}
+
+/*!
+ * \brief Get the slope of the least squares line of the window values against their positions.
+ * \return Slope of the linear trend (per position), or zero if there are less than two values.
+ */
+double TRollingWindow::GetSlope() const
+{
+	if(Count < 2) return 0;
+	double c = Count;
+	double sxx = c * (c * c - 1.0) / 12.0;
+	return (T - 0.5 * (c - 1.0) * Sum) / sxx;
+}
+
+/*!
+ * \brief Get the value of the linear trend at the position of the newest value (as TendenciaLinear in Friends).
+ * \return Fitted value at the end of the window, or zero if it's empty.
+ */
+double TRollingWindow::GetTrend() const
+{
+	if(Count == 0) return 0;
+	return Sum / Count + GetSlope() * 0.5 * (Count - 1.0);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Calculate the moving sum of a whole series.
+ * \param Values Input series.
+ * \param Width Width of the window.
+ * \param Output Vector that will receive the sum of the window ending in each position.
+ */
+void TRollingWindow::Sums(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output)
+{
+	BlockScan(Values, Width, Output, std::plus<double>());
+}
+
+/*!
+ * \brief Calculate the moving average of a whole series.
+ * \param Values Input series.
+ * \param Width Width of the window.
+ * \param Output Vector that will receive the mean of the window ending in each position.
+ */
+void TRollingWindow::Means(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output)
+{
+	BlockScan(Values, Width, Output, std::plus<double>());
+	double w = (Width == 0) ? 1 : Width;
+	for(std::size_t i = 0; i < Output.size(); i++)
+	{
+		Output[i] /= (i + 1.0 < w) ? i + 1.0 : w;
+	}
+}
+
+/*!
+ * \brief Calculate the moving minimum of a whole series.
+ * \param Values Input series.
+ * \param Width Width of the window.
+ * \param Output Vector that will receive the minimum of the window ending in each position.
+ */
+void TRollingWindow::Mins(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output)
+{
+	BlockScan(Values, Width, Output, [](double a, double b) { return (b < a) ? b : a; });
+}
+
+/*!
+ * \brief Calculate the moving maximum of a whole series.
+ * \param Values Input series.
+ * \param Width Width of the window.
+ * \param Output Vector that will receive the maximum of the window ending in each position.
+ */
+void TRollingWindow::Maxs(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output)
+{
+	BlockScan(Values, Width, Output, [](double a, double b) { return (b > a) ? b : a; });
+}
+
+/*!
+ * \brief Calculate the moving sample variance of a whole series.
+ * \param Values Input series.
+ * \param Width Width of the window.
+ * \param Output Vector that will receive the variance of the window ending in each position.
+ */
+void TRollingWindow::Variances(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output)
+{
+	TRollingWindow window(Width);
+	Output.resize(Values.size());
+	for(std::size_t i = 0; i < Values.size(); i++)
+	{
+		window.Push(Values[i]);
+		Output[i] = window.GetVariance();
+	}
+}
+
+/*!
+ * \brief Calculate the moving linear trend slope of a whole series.
+ * \param Values Input series.
+ * \param Width Width of the window.
+ * \param Output Vector that will receive the slope of the window ending in each position.
+ */
+void TRollingWindow::Slopes(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output)
+{
+	TRollingWindow window(Width);
+	Output.resize(Values.size());
+	for(std::size_t i = 0; i < Values.size(); i++)
+	{
+		window.Push(Values[i]);
+		Output[i] = window.GetSlope();
+	}
+}
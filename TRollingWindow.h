@@ -0,0 +1,71 @@
+#ifndef TRollingWindowH
+#define TRollingWindowH
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Sliding window statistics, in O(1) per value.
+ *
+ * In the streaming mode, each Push() moves the window one value forward and updates the sum,
+ * mean, variance (Welford with removal), linear trend, minimum and maximum (monotonic queues).
+ * The running sums are recalculated from the window every Width values, so they don't drift, at
+ * an amortized O(1) cost. The static functions produce whole output series at once: sums, means,
+ * minimums and maximums use block prefix/suffix scans (van Herk/Gil-Werman), which are branchless
+ * and don't accumulate rounding error; the other statistics run the streaming engine. In both
+ * modes, the first Width-1 outputs are calculated over the values available so far.
+ */
+class TRollingWindow
+{
+private:
+	unsigned int Width;          /*!< Maximum number of values in the window. */
+	std::vector<double> Buffer;  /*!< Ring buffer with the values of the window. */
+	unsigned int Head;           /*!< Position in the buffer of the oldest value. */
+	unsigned int Count;          /*!< Number of values in the window. */
+	unsigned int Refresh;        /*!< Number of values pushed since the last recalculation. */
+	unsigned long long Index;    /*!< Number of values pushed since the beginning. */
+	double Sum;                  /*!< Sum of the values of the window. */
+	double Mean;                 /*!< Mean of the values of the window. */
+	double M2;                   /*!< Sum of the squared deviations from the mean. */
+	double T;                    /*!< Sum of the values weighted by their position in the window (0 is the oldest). */
+	std::deque<std::pair<unsigned long long,double> > MinQueue;  /*!< Increasing candidates to the minimum. */
+	std::deque<std::pair<unsigned long long,double> > MaxQueue;  /*!< Decreasing candidates to the maximum. */
+
+	// support functions
+	void Recalculate();
+
+public:
+	// constructors and destructor
+	TRollingWindow(unsigned int WindowWidth);
+	virtual ~TRollingWindow();
+
+	// streaming functions
+	void Clear();
+	double Push(double Value);
+
+	// output functions of the current window
+	unsigned int GetCount() const;
+	double GetSum() const;
+	double GetMean() const;
+	double GetVariance() const;
+	double GetStdDev() const;
+	double GetMin() const;
+	double GetMax() const;
+	double GetSlope() const;
+	double GetTrend() const;
+
+	// whole series functions
+	static void Sums(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output);
+	static void Means(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output);
+	static void Mins(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output);
+	static void Maxs(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output);
+	static void Variances(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output);
+	static void Slopes(const std::vector<double> &Values, unsigned int Width, std::vector<double> &Output);
+};
+
+//---------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,313 @@
+
+#include <cmath>
+#include <limits>
+
+#include "TStats.h"
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Default constructor, with an empty sequence.
+ */
+TStats::TStats()
+{
+	Clear();
+}
+
+/*!
+ * \brief Constructor that accumulates a vector of values.
+ * \param Values Values to be accumulated.
+ */
+TStats::TStats(const std::vector<double> &Values)
+{
+	Clear();
+	Add(Values);
+}
+
+/*!
+ * \brief Destructor (no pointers here, so nothing to declare).
+ */
+TStats::~TStats()
+{
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Reset the accumulator to an empty sequence.
+ */
+void TStats::Clear()
+{
+	N = Sum = Comp = Mean = M2 = M3 = M4 = CXY = 0;
+	Lower = std::numeric_limits<double>::infinity();
+	Upper = -std::numeric_limits<double>::infinity();
+}
+
+/*!
+ * \brief Append a single value to the sequence (streaming update).
+ * \param Value Value to be accumulated.
+ */
+void TStats::Push(double Value)
+{
+	double n1 = N;
+	N += 1.0;
+	double delta = Value - Mean;
+	double dn = delta / N;
+	double dn2 = dn * dn;
+	double term = delta * dn * n1;
+	Mean += dn;
+	M4 += term * dn2 * (N * N - 3.0 * N + 3.0) + 6.0 * dn2 * M2 - 4.0 * dn * M3;
+	M3 += term * dn * (N - 2.0) - 3.0 * dn * M2;
+	M2 += term;
+	CXY += 0.5 * delta * n1;  // merge of a single value at position n1 (see Merge)
+	double y = Value - Comp;
+	double t = Sum + y;
+	Comp = (t - Sum) - y;
+	Sum = t;
+	if(Value < Lower) Lower = Value;
+	if(Value > Upper) Upper = Value;
+}
+
+/*!
+ * \brief Accumulate a small block of values (that fits in the L1 cache) and merge it to this object.
+ *
+ * The block is read twice: first for the sum, minimum and maximum, and then for the moments around
+ * the block mean. Both loops use four independent accumulators, without dependencies between the
+ * iterations, so they can be vectorized.
+ *
+ * \param Values Pointer to the values.
+ * \param Count Number of values (at least one).
+ */
+void TStats::AddBlock(const double *Values, std::size_t Count)
+{
+	double s[4] = {0, 0, 0, 0};
+	double lo[4], hi[4];
+	for(int k = 0; k < 4; k++)  // as in Push, NaN values never replace the extremes
+	{
+		lo[k] = std::numeric_limits<double>::infinity();
+		hi[k] = -std::numeric_limits<double>::infinity();
+	}
+	std::size_t i = 0;
+	for(; i + 4 <= Count; i += 4)
+	{
+		for(int k = 0; k < 4; k++)
+		{
+			double v = Values[i + k];
+			s[k] += v;
+			lo[k] = (v < lo[k]) ? v : lo[k];
+			hi[k] = (v > hi[k]) ? v : hi[k];
+		}
+	}
+	for(; i < Count; i++)
+	{
+		s[0] += Values[i];
+		lo[0] = (Values[i] < lo[0]) ? Values[i] : lo[0];
+		hi[0] = (Values[i] > hi[0]) ? Values[i] : hi[0];
+	}
+	TStats b;
+	b.N = (double)Count;
+	b.Sum = (s[0] + s[1]) + (s[2] + s[3]);
+	b.Mean = b.Sum / b.N;
+	b.Lower = lo[0];
+	b.Upper = hi[0];
+	for(int k = 1; k < 4; k++)
+	{
+		if(lo[k] < b.Lower) b.Lower = lo[k];
+		if(hi[k] > b.Upper) b.Upper = hi[k];
+	}
+	// central moments around the block mean, and co-deviation with the position
+	double m2[4] = {0, 0, 0, 0}, m3[4] = {0, 0, 0, 0}, m4[4] = {0, 0, 0, 0}, cxy[4] = {0, 0, 0, 0};
+	double mx = 0.5 * (b.N - 1.0);
+	for(i = 0; i + 4 <= Count; i += 4)
+	{
+		for(int k = 0; k < 4; k++)
+		{
+			double d = Values[i + k] - b.Mean;
+			double d2 = d * d;
+			m2[k] += d2;
+			m3[k] += d2 * d;
+			m4[k] += d2 * d2;
+			cxy[k] += ((double)(i + k) - mx) * d;
+		}
+	}
+	for(; i < Count; i++)
+	{
+		double d = Values[i] - b.Mean;
+		double d2 = d * d;
+		m2[0] += d2;
+		m3[0] += d2 * d;
+		m4[0] += d2 * d2;
+		cxy[0] += ((double)i - mx) * d;
+	}
+	b.M2 = (m2[0] + m2[1]) + (m2[2] + m2[3]);
+	b.M3 = (m3[0] + m3[1]) + (m3[2] + m3[3]);
+	b.M4 = (m4[0] + m4[1]) + (m4[2] + m4[3]);
+	b.CXY = (cxy[0] + cxy[1]) + (cxy[2] + cxy[3]);
+	Merge(b);
+}
+
+/*!
+ * \brief Append an array of values to the sequence.
+ * \param Values Pointer to the values.
+ * \param Count Number of values.
+ */
+void TStats::Add(const double *Values, std::size_t Count)
+{
+	const std::size_t block = 1024;
+	for(std::size_t i = 0; i < Count; i += block)
+	{
+		AddBlock(Values + i, (Count - i < block) ? Count - i : block);
+	}
+}
+
+/*!
+ * \brief Append a vector of values to the sequence.
+ * \param Values Values to be accumulated.
+ */
+void TStats::Add(const std::vector<double> &Values)
+{
+	if(!Values.empty()) Add(&Values[0], Values.size());
+}
+
+/*!
+ * \brief Merge another accumulator to this one, as if its sequence was appended to this one.
+ *
+ * Uses the pairwise formulas of Chan and Pebay for the central moments. Since the positions
+ * are always consecutive, the deviation between the mean positions of both sequences is n/2.
+ *
+ * \param Other Accumulator to be merged.
+ */
+void TStats::Merge(const TStats &Other)
+{
+	if(Other.N == 0) return;
+	if(N == 0)
+	{
+		*this = Other;
+		return;
+	}
+	double na = N, nb = Other.N;
+	double n = na + nb;
+	double delta = Other.Mean - Mean;
+	double d2 = delta * delta;
+	double nab = na * nb;
+	M4 += Other.M4 + d2 * d2 * nab * (na * na - nab + nb * nb) / (n * n * n)
+	    + 6.0 * d2 * (na * na * Other.M2 + nb * nb * M2) / (n * n)
+	    + 4.0 * delta * (na * Other.M3 - nb * M3) / n;
+	M3 += Other.M3 + d2 * delta * nab * (na - nb) / (n * n) + 3.0 * delta * (na * Other.M2 - nb * M2) / n;
+	M2 += Other.M2 + d2 * nab / n;
+	CXY += Other.CXY + 0.5 * delta * nab;
+	Mean += delta * nb / n;
+	N = n;
+	// Kahan sum of the other partial sum (with its own compensation)
+	double y = (Other.Sum - Other.Comp) - Comp;
+	double t = Sum + y;
+	Comp = (t - Sum) - y;
+	Sum = t;
+	if(Other.Lower < Lower) Lower = Other.Lower;
+	if(Other.Upper > Upper) Upper = Other.Upper;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Get the number of values.
+ * \return Number of accumulated values.
+ */
+double TStats::GetCount() const
+{
+	return N;
+}
+
+/*!
+ * \brief Get the (compensated) sum of the values.
+ * \return Sum of the values.
+ */
+double TStats::GetSum() const
+{
+	return Sum - Comp;
+}
+
+/*!
+ * \brief Get the mean of the values.
+ * \return Mean of the values, or zero if there's no value.
+ */
+double TStats::GetMean() const
+{
+	return Mean;
+}
+
+/*!
+ * \brief Get the sample variance (divided by n-1).
+ * \return Sample variance, or zero if there are less than two values.
+ */
+double TStats::GetVariance() const
+{
+	return (N > 1) ? M2 / (N - 1.0) : 0.0;
+}
+
+/*!
+ * \brief Get the sample standard deviation (square root of the sample variance).
+ * \return Standard deviation, or zero if there are less than two values.
+ */
+double TStats::GetStdDev() const
+{
+	return std::sqrt(GetVariance());
+}
+
+/*!
+ * \brief Get the (population) skewness of the values.
+ * \return Skewness, or zero if the values have no dispersion.
+ */
+double TStats::GetSkewness() const
+{
+	if(M2 <= 0) return 0;
+	return std::sqrt(N) * M3 / std::pow(M2, 1.5);
+}
+
+/*!
+ * \brief Get the (population) excess kurtosis of the values.
+ * \return Excess kurtosis (zero for a normal distribution), or zero if the values have no dispersion.
+ */
+double TStats::GetKurtosis() const
+{
+	if(M2 <= 0) return 0;
+	return N * M4 / (M2 * M2) - 3.0;
+}
+
+/*!
+ * \brief Get the minimum value.
+ * \return Minimum value, or +infinity if there's no value.
+ */
+double TStats::GetMin() const
+{
+	return Lower;
+}
+
+/*!
+ * \brief Get the maximum value.
+ * \return Maximum value, or -infinity if there's no value.
+ */
+double TStats::GetMax() const
+{
+	return Upper;
+}
+
+/*!
+ * \brief Get the slope of the least squares line of the values against their positions (0, 1, 2, ...).
+ * \return Slope of the linear trend, or zero if there are less than two values.
+ */
+double TStats::GetSlope() const
+{
+	if(N < 2) return 0;
+	double sxx = N * (N * N - 1.0) / 12.0;  // sum of the squared deviations of 0..n-1
+	return CXY / sxx;
+}
+
+/*!
+ * \brief Get the intercept (value at position zero) of the least squares line of the values.
+ * \return Intercept of the linear trend.
+ */
+double TStats::GetIntercept() const
+{
+	return Mean - GetSlope() * 0.5 * (N - 1.0);
+}
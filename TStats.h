@@ -0,0 +1,65 @@
+#ifndef TStatsH
+#define TStatsH
+
+#include <cstddef>
+#include <vector>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Single pass accumulator of descriptive statistics.
+ *
+ * Keeps count, sum (Kahan compensated), mean, central moments up to the fourth order
+ * (Welford/Terriberry updates), minimum, maximum and the linear trend of the values against
+ * their position in the sequence. Values can be pushed one by one (streaming) or added in
+ * arrays, which are processed in small blocks with independent accumulators so the compiler
+ * can vectorize them. Two accumulators can be merged, so chunks can be processed by different
+ * threads; merging appends the other sequence after this one (it matters only for the trend).
+ */
+class TStats
+{
+private:
+	double N;      /*!< Number of values. */
+	double Sum;    /*!< Sum of the values. */
+	double Comp;   /*!< Kahan compensation of the sum. */
+	double Mean;   /*!< Mean of the values. */
+	double M2;     /*!< Sum of the squared deviations from the mean. */
+	double M3;     /*!< Sum of the cubed deviations from the mean. */
+	double M4;     /*!< Sum of the fourth power of the deviations from the mean. */
+	double CXY;    /*!< Sum of the co-deviations of the positions and the values (for the trend). */
+	double Lower;  /*!< Minimum value. */
+	double Upper;  /*!< Maximum value. */
+
+	// support functions
+	void AddBlock(const double *Values, std::size_t Count);
+
+public:
+	// constructors and destructor
+	TStats();
+	TStats(const std::vector<double> &Values);
+	virtual ~TStats();
+
+	// accumulation functions
+	void Clear();
+	void Push(double Value);
+	void Add(const double *Values, std::size_t Count);
+	void Add(const std::vector<double> &Values);
+	void Merge(const TStats &Other);
+
+	// output functions
+	double GetCount() const;
+	double GetSum() const;
+	double GetMean() const;
+	double GetVariance() const;
+	double GetStdDev() const;
+	double GetSkewness() const;
+	double GetKurtosis() const;
+	double GetMin() const;
+	double GetMax() const;
+	double GetSlope() const;
+	double GetIntercept() const;
+};
+
+//---------------------------------------------------------------------------
+
+#endif
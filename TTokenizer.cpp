@@ -0,0 +1,225 @@
+
+#include <cstring>
+
+#include "TTokenizer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TTOKENIZER_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Index of the lowest bit set of a non-zero mask.
+ * \param Mask Mask with at least one bit set.
+ * \return Index of the lowest bit set.
+ */
+static inline unsigned int LowestBit(unsigned int Mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, Mask);
+	return index;
+#else
+	return __builtin_ctz(Mask);
+#endif
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Constructor with a single delimiter.
+ * \param Source Text to be tokenized (it isn't copied, so it must outlive the tokens).
+ * \param Delimiter Delimiter character.
+ */
+TTokenizer::TTokenizer(std::string_view Source, char Delimiter)
+{
+	Delimiters.assign(1, Delimiter);
+	std::memset(Table, 0, sizeof(Table));
+	Table[(unsigned char)Delimiter] = true;
+	Quote = 0;
+	Reset(Source);
+}
+
+/*!
+ * \brief Constructor with a set of delimiters (any of them ends a token).
+ * \param Source Text to be tokenized (it isn't copied, so it must outlive the tokens).
+ * \param DelimiterSet Delimiter characters.
+ */
+TTokenizer::TTokenizer(std::string_view Source, std::string_view DelimiterSet)
+{
+	Delimiters.assign(DelimiterSet.data(), DelimiterSet.size());
+	std::memset(Table, 0, sizeof(Table));
+	for(std::size_t i = 0; i < Delimiters.size(); i++) Table[(unsigned char)Delimiters[i]] = true;
+	Quote = 0;
+	Reset(Source);
+}
+
+/*!
+ * \brief Destructor (no pointers here, so nothing to declare).
+ */
+TTokenizer::~TTokenizer()
+{
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Enable the quote-aware (CSV) mode.
+ * \param QuoteChar Quote character (zero disables the mode).
+ */
+void TTokenizer::SetQuote(char QuoteChar)
+{
+	Quote = QuoteChar;
+}
+
+/*!
+ * \brief Restart the tokenizer over another text, keeping the delimiters and the mode.
+ * \param Source Text to be tokenized.
+ */
+void TTokenizer::Reset(std::string_view Source)
+{
+	Text = Source;
+	Position = 0;
+	Finished = Text.empty();
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Find the next delimiter.
+ * \param From Position where the search starts.
+ * \return Position of the next delimiter, or the size of the text if there's none.
+ */
+std::size_t TTokenizer::FindDelimiter(std::size_t From) const
+{
+	const char *data = Text.data();
+	std::size_t n = Text.size();
+	if(Delimiters.size() == 1)
+	{
+		const void *p = std::memchr(data + From, Delimiters[0], n - From);
+		return p ? (const char*)p - data : n;
+	}
+	std::size_t i = From;
+#if defined(TTOKENIZER_SSE2)
+	if(!Delimiters.empty() && Delimiters.size() <= 4)
+	{
+		__m128i d[4];
+		for(std::size_t k = 0; k < 4; k++) d[k] = _mm_set1_epi8(Delimiters[k < Delimiters.size() ? k : 0]);
+		for(; i + 16 <= n; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+			__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, d[0]), _mm_cmpeq_epi8(v, d[1])),
+			                         _mm_or_si128(_mm_cmpeq_epi8(v, d[2]), _mm_cmpeq_epi8(v, d[3])));
+			unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+			if(mask != 0) return i + LowestBit(mask);
+		}
+	}
+#endif
+	for(; i < n; i++)
+	{
+		if(Table[(unsigned char)data[i]]) return i;
+	}
+	return n;
+}
+
+/*!
+ * \brief Get the next token.
+ * \param Token Reference that will receive the slice of the text (the content between quotes, in the quote-aware mode).
+ * \return True if there was a token, false if the text is over.
+ */
+bool TTokenizer::Next(std::string_view &Token)
+{
+	if(Finished) return false;
+	std::size_t n = Text.size();
+	std::size_t end;
+	if(Quote != 0 && Position < n && Text[Position] == Quote)
+	{
+		// quoted field: the closing quote is one that isn't doubled
+		std::size_t begin = Position + 1;
+		std::size_t close = begin;
+		while(true)
+		{
+			const void *p = std::memchr(Text.data() + close, Quote, n - close);
+			if(!p)
+			{
+				close = n;  // unterminated field: takes the rest of the text
+				break;
+			}
+			close = (const char*)p - Text.data();
+			if(close + 1 < n && Text[close + 1] == Quote)
+			{
+				close += 2;
+				continue;
+			}
+			break;
+		}
+		Token = Text.substr(begin, close - begin);
+		end = (close < n) ? FindDelimiter(close + 1) : n;  // anything between the quote and the delimiter is discarded
+	}
+	else
+	{
+		end = FindDelimiter(Position);
+		Token = Text.substr(Position, end - Position);
+	}
+	if(end >= n)
+	{
+		Finished = true;
+		Position = n;
+	}
+	else
+	{
+		Position = end + 1;  // a delimiter at the end still gives an empty last token
+	}
+	return true;
+}
+
+/*!
+ * \brief Get all the remaining tokens.
+ * \param Tokens Vector that will receive the tokens (cleared first, but its capacity is reused).
+ * \return Number of tokens.
+ */
+std::size_t TTokenizer::Split(std::vector<std::string_view> &Tokens)
+{
+	Tokens.clear();
+	std::string_view token;
+	while(Next(token)) Tokens.push_back(token);
+	return Tokens.size();
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Split a text by a single delimiter, without copies.
+ * \param Source Text to be split.
+ * \param Delimiter Delimiter character.
+ * \param Tokens Vector that will receive the tokens (cleared first, but its capacity is reused).
+ * \return Number of tokens.
+ */
+std::size_t TTokenizer::Split(std::string_view Source, char Delimiter, std::vector<std::string_view> &Tokens)
+{
+	TTokenizer tokenizer(Source, Delimiter);
+	return tokenizer.Split(Tokens);
+}
+
+/*!
+ * \brief Replace the doubled quotes of a quoted field by single quotes.
+ * \param Field Content of a quoted field, as returned by the quote-aware mode.
+ * \param QuoteChar Quote character.
+ * \param Output String that will receive the unquoted field (its capacity is reused).
+ * \return Reference to Output, for nesting.
+ */
+std::string &TTokenizer::Unquote(std::string_view Field, char QuoteChar, std::string &Output)
+{
+	Output.clear();
+	for(std::size_t i = 0; i < Field.size(); i++)
+	{
+		Output += Field[i];
+		if(Field[i] == QuoteChar && i + 1 < Field.size() && Field[i + 1] == QuoteChar) i++;
+	}
+	return Output;
+}
@@ -0,0 +1,56 @@
+#ifndef TTokenizerH
+#define TTokenizerH
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Zero-copy tokenizer over a text buffer.
+ *
+ * Tokens are string_view slices of the source text (which must outlive them), returned one by
+ * one by Next() or all at once into a reusable vector. A single delimiter is searched with memchr,
+ * and a set of up to four delimiters is matched 16 bytes at a time with SSE2 bitmasks (larger sets
+ * use a byte table). In the quote-aware (CSV) mode, a field that starts with the quote character
+ * ends at the matching closing quote, so it may contain delimiters; the token is the content between
+ * the quotes, where doubled quotes are kept as they are (see Unquote()). A text with n delimiters has
+ * n+1 tokens, and an empty text has none.
+ */
+class TTokenizer
+{
+private:
+	std::string_view Text;  /*!< Text being tokenized. */
+	std::size_t Position;   /*!< Start of the next token. */
+	bool Finished;          /*!< True when all tokens were returned. */
+	std::string Delimiters; /*!< Delimiter characters. */
+	bool Table[256];        /*!< True for the delimiter characters. */
+	char Quote;             /*!< Quote character (zero if the quote-aware mode is disabled). */
+
+	// support functions
+	std::size_t FindDelimiter(std::size_t From) const;
+
+public:
+	// constructors and destructor
+	TTokenizer(std::string_view Source, char Delimiter);
+	TTokenizer(std::string_view Source, std::string_view DelimiterSet);
+	virtual ~TTokenizer();
+
+	// assign functions
+	void SetQuote(char QuoteChar = '"');
+	void Reset(std::string_view Source);
+
+	// tokenizing functions
+	bool Next(std::string_view &Token);
+	std::size_t Split(std::vector<std::string_view> &Tokens);
+
+	// helpers
+	static std::size_t Split(std::string_view Source, char Delimiter, std::vector<std::string_view> &Tokens);
+	static std::string &Unquote(std::string_view Field, char QuoteChar, std::string &Output);
+};
+
+//---------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,547 @@
+
+#include <cstdint>
+
+#include "TUnicode.h"
+
+// vector kernels, selected at compilation (the scalar version is always available)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TUNICODE_SSE2
+#endif
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Read a code point from UTF-16 or UTF-32 units (by the size of the unit type).
+ * \param In Units.
+ * \param Len Number of units.
+ * \param Pos Position of the code point, advanced past it (or past the invalid unit).
+ * \param Code Reference that will receive the code point.
+ * \return True if the code point is valid.
+ */
+template<typename T> static inline bool DecodeWide(const T *In, std::size_t Len, std::size_t &Pos, char32_t &Code)
+{
+	if constexpr(sizeof(T) == 2)
+	{
+		std::uint32_t u = (std::uint16_t)In[Pos++];
+		if(u < 0xD800 || u > 0xDFFF)
+		{
+			Code = u;
+			return true;
+		}
+		if(u <= 0xDBFF && Pos < Len)
+		{
+			std::uint32_t l = (std::uint16_t)In[Pos];
+			if(l >= 0xDC00 && l <= 0xDFFF)
+			{
+				Pos++;
+				Code = 0x10000 + ((u - 0xD800) << 10) + (l - 0xDC00);
+				return true;
+			}
+		}
+		return false;
+	}
+	else
+	{
+		std::uint32_t u = (std::uint32_t)In[Pos++];
+		if(u > 0x10FFFF || (u >= 0xD800 && u <= 0xDFFF)) return false;
+		Code = u;
+		return true;
+	}
+}
+
+/*!
+ * \brief Read a code point from UTF-8 bytes, rejecting overlong forms, surrogates and values above U+10FFFF.
+ * \param In Bytes.
+ * \param Len Number of bytes.
+ * \param Pos Position of the code point, advanced past it (or past the invalid byte).
+ * \param Code Reference that will receive the code point.
+ * \return True if the code point is valid.
+ */
+static inline bool DecodeUtf8(const unsigned char *In, std::size_t Len, std::size_t &Pos, char32_t &Code)
+{
+	unsigned int c = In[Pos];
+	if(c < 0x80)
+	{
+		Code = c;
+		Pos++;
+		return true;
+	}
+	std::size_t n;
+	char32_t v;
+	if(c >= 0xC2 && c <= 0xDF) { n = 1; v = c & 0x1F; }
+	else if((c & 0xF0) == 0xE0) { n = 2; v = c & 0x0F; }
+	else if(c >= 0xF0 && c <= 0xF4) { n = 3; v = c & 0x07; }
+	else
+	{
+		Pos++;
+		return false;
+	}
+	if(Pos + n >= Len)
+	{
+		Pos++;
+		return false;
+	}
+	for(std::size_t k = 1; k <= n; k++)
+	{
+		unsigned int b = In[Pos + k];
+		if((b & 0xC0) != 0x80)
+		{
+			Pos++;
+			return false;
+		}
+		v = (v << 6) | (b & 0x3F);
+	}
+	if((n == 2 && (v < 0x800 || (v >= 0xD800 && v <= 0xDFFF))) || (n == 3 && (v < 0x10000 || v > 0x10FFFF)))
+	{
+		Pos++;
+		return false;
+	}
+	Pos += n + 1;
+	Code = v;
+	return true;
+}
+
+/*!
+ * \brief Number of UTF-8 bytes of a code point.
+ */
+static inline std::size_t Utf8Length(char32_t Code)
+{
+	return (Code < 0x80) ? 1 : (Code < 0x800) ? 2 : (Code < 0x10000) ? 3 : 4;
+}
+
+/*!
+ * \brief Write a code point in UTF-8.
+ * \param Code Code point.
+ * \param Out Buffer that will receive up to 4 bytes.
+ * \return Number of bytes written.
+ */
+static inline std::size_t EncodeUtf8(char32_t Code, char *Out)
+{
+	if(Code < 0x80)
+	{
+		Out[0] = (char)Code;
+		return 1;
+	}
+	if(Code < 0x800)
+	{
+		Out[0] = (char)(0xC0 | (Code >> 6));
+		Out[1] = (char)(0x80 | (Code & 0x3F));
+		return 2;
+	}
+	if(Code < 0x10000)
+	{
+		Out[0] = (char)(0xE0 | (Code >> 12));
+		Out[1] = (char)(0x80 | ((Code >> 6) & 0x3F));
+		Out[2] = (char)(0x80 | (Code & 0x3F));
+		return 3;
+	}
+	Out[0] = (char)(0xF0 | (Code >> 18));
+	Out[1] = (char)(0x80 | ((Code >> 12) & 0x3F));
+	Out[2] = (char)(0x80 | ((Code >> 6) & 0x3F));
+	Out[3] = (char)(0x80 | (Code & 0x3F));
+	return 4;
+}
+
+/*!
+ * \brief Number of bits set in a 16-bit mask.
+ */
+static inline unsigned int CountBits(unsigned int Mask)
+{
+	Mask = Mask - ((Mask >> 1) & 0x5555);
+	Mask = (Mask & 0x3333) + ((Mask >> 2) & 0x3333);
+	Mask = (Mask + (Mask >> 4)) & 0x0F0F;
+	return (Mask + (Mask >> 8)) & 0x1F;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Narrow blocks of 16 ASCII units, stopping at the first block with other characters.
+ * \param In Units.
+ * \param Len Number of units.
+ * \param Out Buffer that will receive the bytes.
+ * \return Number of units converted (a multiple of 16).
+ */
+template<typename T> static inline std::size_t AsciiBlocksToUtf8(const T *In, std::size_t Len, char *Out)
+{
+	std::size_t i = 0;
+#if defined(TUNICODE_SSE2)
+	const __m128i *p = (const __m128i*)In;
+	if constexpr(sizeof(T) == 2)
+	{
+		for(; i + 16 <= Len; i += 16, p += 2)
+		{
+			__m128i a = _mm_loadu_si128(p), b = _mm_loadu_si128(p + 1);
+			__m128i high = _mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16((short)0xFF80));
+			if(_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF) break;
+			_mm_storeu_si128((__m128i*)(Out + i), _mm_packus_epi16(a, b));
+		}
+	}
+	else
+	{
+		for(; i + 16 <= Len; i += 16, p += 4)
+		{
+			__m128i a = _mm_loadu_si128(p), b = _mm_loadu_si128(p + 1), c = _mm_loadu_si128(p + 2), d = _mm_loadu_si128(p + 3);
+			__m128i high = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), _mm_set1_epi32(~0x7F));
+			if(_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) != 0xFFFF) break;
+			_mm_storeu_si128((__m128i*)(Out + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+		}
+	}
+#else
+	(void)In; (void)Len; (void)Out;
+#endif
+	return i;
+}
+
+/*!
+ * \brief Widen blocks of 16 ASCII bytes, stopping at the first block with other characters.
+ * \param In Bytes.
+ * \param Len Number of bytes.
+ * \param Out Buffer that will receive the units.
+ * \return Number of bytes converted (a multiple of 16).
+ */
+template<typename T> static inline std::size_t AsciiBlocksFromUtf8(const unsigned char *In, std::size_t Len, T *Out)
+{
+	std::size_t i = 0;
+#if defined(TUNICODE_SSE2)
+	__m128i zero = _mm_setzero_si128();
+	for(; i + 16 <= Len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(In + i));
+		if(_mm_movemask_epi8(v) != 0) break;
+		__m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+		__m128i *q = (__m128i*)(Out + i);
+		if constexpr(sizeof(T) == 2)
+		{
+			_mm_storeu_si128(q, lo);
+			_mm_storeu_si128(q + 1, hi);
+		}
+		else
+		{
+			_mm_storeu_si128(q, _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128(q + 1, _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128(q + 2, _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128(q + 3, _mm_unpackhi_epi16(hi, zero));
+		}
+	}
+#else
+	(void)In; (void)Len; (void)Out;
+#endif
+	return i;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Size in UTF-8 of UTF-16 or UTF-32 units (invalid units count as U+FFFD).
+ */
+template<typename T> static std::size_t WideUtf8Size(const T *In, std::size_t Len)
+{
+	std::size_t i = 0, n = 0;
+	while(i < Len)
+	{
+		char32_t code;
+		n += DecodeWide(In, Len, i, code) ? Utf8Length(code) : 3;
+	}
+	return n;
+}
+
+/*!
+ * \brief Size in UTF-16 or UTF-32 units of UTF-8 bytes (invalid bytes count as U+FFFD).
+ */
+template<typename T> static std::size_t Utf8WideSize(const char *In, std::size_t Len)
+{
+	const unsigned char *p = (const unsigned char*)In;
+	std::size_t i = 0, n = 0;
+	while(i < Len)
+	{
+		char32_t code;
+		if(!DecodeUtf8(p, Len, i, code)) code = 0xFFFD;
+		n += (sizeof(T) == 2 && code >= 0x10000) ? 2 : 1;
+	}
+	return n;
+}
+
+/*!
+ * \brief Convert UTF-16 or UTF-32 units to UTF-8 (see TUnicode::ToUtf8).
+ */
+template<typename T> static bool WideToUtf8(const T *In, std::size_t Len, char *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace)
+{
+	std::size_t i = 0, o = 0;
+	bool valid = true;
+	ErrorPos = Len;
+	while(i < Len)
+	{
+		if((std::uint32_t)In[i] < 0x80)
+		{
+			std::size_t k = AsciiBlocksToUtf8(In + i, Len - i, Out + o);
+			i += k;
+			o += k;
+			while(i < Len && (std::uint32_t)In[i] < 0x80) Out[o++] = (char)In[i++];
+			continue;
+		}
+		std::size_t start = i;
+		char32_t code;
+		if(!DecodeWide(In, Len, i, code))
+		{
+			if(valid)
+			{
+				ErrorPos = start;
+				valid = false;
+			}
+			if(!Replace) break;
+			code = 0xFFFD;
+		}
+		o += EncodeUtf8(code, Out + o);
+	}
+	Written = o;
+	return valid;
+}
+
+/*!
+ * \brief Convert UTF-8 bytes to UTF-16 or UTF-32 units (see TUnicode::ToUtf16).
+ */
+template<typename T> static bool Utf8ToWide(const char *In, std::size_t Len, T *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace)
+{
+	const unsigned char *p = (const unsigned char*)In;
+	std::size_t i = 0, o = 0;
+	bool valid = true;
+	ErrorPos = Len;
+	while(i < Len)
+	{
+		if(p[i] < 0x80)
+		{
+			std::size_t k = AsciiBlocksFromUtf8(p + i, Len - i, Out + o);
+			i += k;
+			o += k;
+			while(i < Len && p[i] < 0x80) Out[o++] = (T)p[i++];
+			continue;
+		}
+		std::size_t start = i;
+		char32_t code;
+		if(!DecodeUtf8(p, Len, i, code))
+		{
+			if(valid)
+			{
+				ErrorPos = start;
+				valid = false;
+			}
+			if(!Replace) break;
+			code = 0xFFFD;
+		}
+		if(sizeof(T) == 2 && code >= 0x10000)
+		{
+			code -= 0x10000;
+			Out[o++] = (T)(0xD800 + (code >> 10));
+			Out[o++] = (T)(0xDC00 + (code & 0x3FF));
+		}
+		else Out[o++] = (T)code;
+	}
+	Written = o;
+	return valid;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Exact size in UTF-8 of a UTF-16 text.
+ * \param In UTF-16 units.
+ * \param Len Number of units.
+ * \return Number of bytes (invalid units count as the 3 bytes of U+FFFD).
+ */
+std::size_t TUnicode::Utf8Size(const char16_t *In, std::size_t Len)
+{
+	return WideUtf8Size(In, Len);
+}
+
+/*!
+ * \brief Exact size in UTF-8 of a UTF-32 text.
+ * \param In UTF-32 units.
+ * \param Len Number of units.
+ * \return Number of bytes (invalid units count as the 3 bytes of U+FFFD).
+ */
+std::size_t TUnicode::Utf8Size(const char32_t *In, std::size_t Len)
+{
+	return WideUtf8Size(In, Len);
+}
+
+/*!
+ * \brief Exact size in UTF-8 of a wide text.
+ * \param In Wide characters.
+ * \param Len Number of characters.
+ * \return Number of bytes (invalid units count as the 3 bytes of U+FFFD).
+ */
+std::size_t TUnicode::Utf8Size(const wchar_t *In, std::size_t Len)
+{
+	return WideUtf8Size(In, Len);
+}
+
+/*!
+ * \brief Exact size in UTF-16 of a UTF-8 text.
+ * \param In UTF-8 bytes.
+ * \param Len Number of bytes.
+ * \return Number of units (invalid bytes count as one unit of U+FFFD).
+ */
+std::size_t TUnicode::Utf16Size(const char *In, std::size_t Len)
+{
+	return Utf8WideSize<char16_t>(In, Len);
+}
+
+/*!
+ * \brief Exact size in UTF-32 of a UTF-8 text.
+ * \param In UTF-8 bytes.
+ * \param Len Number of bytes.
+ * \return Number of units (invalid bytes count as one unit of U+FFFD).
+ */
+std::size_t TUnicode::Utf32Size(const char *In, std::size_t Len)
+{
+	return Utf8WideSize<char32_t>(In, Len);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Convert a UTF-16 text to UTF-8.
+ * \param In UTF-16 units.
+ * \param Len Number of units.
+ * \param Out Buffer that will receive the bytes, with at least Utf8Size(In, Len) bytes.
+ * \param Written Reference that will receive the number of bytes written.
+ * \param ErrorPos Reference that will receive the position of the first invalid unit (Len if there's none).
+ * \param Replace True if invalid units are replaced by U+FFFD, false if the conversion stops at them.
+ * \return True if the text is valid.
+ */
+bool TUnicode::ToUtf8(const char16_t *In, std::size_t Len, char *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace)
+{
+	return WideToUtf8(In, Len, Out, Written, ErrorPos, Replace);
+}
+
+/*!
+ * \brief Convert a UTF-32 text to UTF-8 (see the UTF-16 version for the parameters).
+ */
+bool TUnicode::ToUtf8(const char32_t *In, std::size_t Len, char *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace)
+{
+	return WideToUtf8(In, Len, Out, Written, ErrorPos, Replace);
+}
+
+/*!
+ * \brief Convert a wide text to UTF-8 (see the UTF-16 version for the parameters).
+ */
+bool TUnicode::ToUtf8(const wchar_t *In, std::size_t Len, char *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace)
+{
+	return WideToUtf8(In, Len, Out, Written, ErrorPos, Replace);
+}
+
+/*!
+ * \brief Convert a UTF-8 text to UTF-16.
+ * \param In UTF-8 bytes.
+ * \param Len Number of bytes.
+ * \param Out Buffer that will receive the units, with at least Utf16Size(In, Len) units.
+ * \param Written Reference that will receive the number of units written.
+ * \param ErrorPos Reference that will receive the position of the first invalid byte (Len if there's none).
+ * \param Replace True if invalid bytes are replaced by U+FFFD, false if the conversion stops at them.
+ * \return True if the text is valid.
+ */
+bool TUnicode::ToUtf16(const char *In, std::size_t Len, char16_t *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace)
+{
+	return Utf8ToWide(In, Len, Out, Written, ErrorPos, Replace);
+}
+
+/*!
+ * \brief Convert a UTF-8 text to UTF-32 (see the UTF-16 version for the parameters, with Utf32Size for the buffer).
+ */
+bool TUnicode::ToUtf32(const char *In, std::size_t Len, char32_t *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace)
+{
+	return Utf8ToWide(In, Len, Out, Written, ErrorPos, Replace);
+}
+
+/*!
+ * \brief Convert a UTF-8 text to wide characters (see the UTF-16 version for the parameters, with the size of wchar_t for the buffer).
+ */
+bool TUnicode::ToWide(const char *In, std::size_t Len, wchar_t *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace)
+{
+	return Utf8ToWide(In, Len, Out, Written, ErrorPos, Replace);
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Convert a wide string to UTF-8, allocating the output once.
+ * \param In Wide string.
+ * \param Out String that will receive the UTF-8 text.
+ * \param Replace True if invalid units are replaced by U+FFFD, false if the conversion stops at them.
+ * \return True if the text is valid.
+ */
+bool TUnicode::ToUtf8(const std::wstring &In, std::string &Out, bool Replace)
+{
+	Out.resize(Utf8Size(In.data(), In.size()));
+	std::size_t written = 0, error;
+	bool valid = ToUtf8(In.data(), In.size(), Out.empty() ? NULL : &Out[0], written, error, Replace);
+	Out.resize(written);
+	return valid;
+}
+
+/*!
+ * \brief Convert a UTF-8 string to a wide string, allocating the output once.
+ * \param In UTF-8 string.
+ * \param Out String that will receive the wide text.
+ * \param Replace True if invalid bytes are replaced by U+FFFD, false if the conversion stops at them.
+ * \return True if the text is valid.
+ */
+bool TUnicode::ToWide(const std::string &In, std::wstring &Out, bool Replace)
+{
+	Out.resize(sizeof(wchar_t) == 2 ? Utf16Size(In.data(), In.size()) : Utf32Size(In.data(), In.size()));
+	std::size_t written = 0, error;
+	bool valid = ToWide(In.data(), In.size(), Out.empty() ? NULL : &Out[0], written, error, Replace);
+	Out.resize(written);
+	return valid;
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Narrow wide characters to their low byte, one byte per character (as the old ctype::narrow based Narrow did).
+ * \param In Wide characters.
+ * \param Len Number of characters.
+ * \param Out Buffer that will receive Len bytes.
+ * \return Number of characters above U+00FF (which don't survive the narrowing).
+ */
+std::size_t TUnicode::NarrowBytes(const wchar_t *In, std::size_t Len, char *Out)
+{
+	std::size_t i = 0, lost = 0;
+#if defined(TUNICODE_SSE2)
+	const __m128i *p = (const __m128i*)In;
+	__m128i zero = _mm_setzero_si128();
+	if constexpr(sizeof(wchar_t) == 2)
+	{
+		__m128i low = _mm_set1_epi16(0x00FF);
+		for(; i + 16 <= Len; i += 16, p += 2)
+		{
+			__m128i a = _mm_loadu_si128(p), b = _mm_loadu_si128(p + 1);
+			__m128i ka = _mm_cmpeq_epi16(_mm_andnot_si128(low, a), zero), kb = _mm_cmpeq_epi16(_mm_andnot_si128(low, b), zero);
+			lost += 16 - CountBits((unsigned int)_mm_movemask_epi8(_mm_packs_epi16(ka, kb)));
+			_mm_storeu_si128((__m128i*)(Out + i), _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low)));
+		}
+	}
+	else
+	{
+		__m128i low = _mm_set1_epi32(0xFF);
+		for(; i + 16 <= Len; i += 16, p += 4)
+		{
+			__m128i a = _mm_loadu_si128(p), b = _mm_loadu_si128(p + 1), c = _mm_loadu_si128(p + 2), d = _mm_loadu_si128(p + 3);
+			__m128i ka = _mm_cmpeq_epi32(_mm_andnot_si128(low, a), zero), kb = _mm_cmpeq_epi32(_mm_andnot_si128(low, b), zero);
+			__m128i kc = _mm_cmpeq_epi32(_mm_andnot_si128(low, c), zero), kd = _mm_cmpeq_epi32(_mm_andnot_si128(low, d), zero);
+			lost += 16 - CountBits((unsigned int)_mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(ka, kb), _mm_packs_epi32(kc, kd))));
+			a = _mm_and_si128(a, low); b = _mm_and_si128(b, low); c = _mm_and_si128(c, low); d = _mm_and_si128(d, low);
+			_mm_storeu_si128((__m128i*)(Out + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+		}
+	}
+#endif
+	for(; i < Len; i++)
+	{
+		std::uint32_t u = (std::uint32_t)In[i];
+		Out[i] = (char)(u & 0xFF);
+		if(u > 0xFF) lost++;
+	}
+	return lost;
+}
@@ -0,0 +1,46 @@
+#ifndef TUnicodeH
+#define TUnicodeH
+
+#include <cstddef>
+#include <string>
+
+//---------------------------------------------------------------------------
+
+/*!
+ * \brief Transcoding between UTF-8 and UTF-16/UTF-32 (and wchar_t, which is UTF-16 on Windows and UTF-32 elsewhere).
+ *
+ * Runs of ASCII characters are converted 16 at a time with SSE2 (selected at compilation), and the
+ * other characters one code point at a time. The size functions give the exact size of the output,
+ * so the conversions write into caller buffers without reallocation. Invalid input (unpaired
+ * surrogates, code points above U+10FFFF, malformed or overlong UTF-8) either stops the conversion,
+ * reporting the position of the error, or is replaced by U+FFFD (one per invalid unit).
+ */
+class TUnicode
+{
+public:
+	// sizes (exact for valid input, or with replacement of the invalid units)
+	static std::size_t Utf8Size(const char16_t *In, std::size_t Len);
+	static std::size_t Utf8Size(const char32_t *In, std::size_t Len);
+	static std::size_t Utf8Size(const wchar_t *In, std::size_t Len);
+	static std::size_t Utf16Size(const char *In, std::size_t Len);
+	static std::size_t Utf32Size(const char *In, std::size_t Len);
+
+	// conversions into caller buffers
+	static bool ToUtf8(const char16_t *In, std::size_t Len, char *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace = false);
+	static bool ToUtf8(const char32_t *In, std::size_t Len, char *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace = false);
+	static bool ToUtf8(const wchar_t *In, std::size_t Len, char *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace = false);
+	static bool ToUtf16(const char *In, std::size_t Len, char16_t *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace = false);
+	static bool ToUtf32(const char *In, std::size_t Len, char32_t *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace = false);
+	static bool ToWide(const char *In, std::size_t Len, wchar_t *Out, std::size_t &Written, std::size_t &ErrorPos, bool Replace = false);
+
+	// conversions of strings
+	static bool ToUtf8(const std::wstring &In, std::string &Out, bool Replace = true);
+	static bool ToWide(const std::string &In, std::wstring &Out, bool Replace = true);
+
+	// byte narrowing (compatible with the old Narrow of Friends)
+	static std::size_t NarrowBytes(const wchar_t *In, std::size_t Len, char *Out);
+};
+
+//---------------------------------------------------------------------------
+
+#endif